@@ -0,0 +1,339 @@
+// Benchmarks for the write-ahead log.
+//
+// Usage: log_bench [--benchmarks=name,...] [--num=N] [--threads=T,...]
+//                  [--record_size=S] [--compression=none|snappy]
+//                  [--read_size=B]
+//
+//   syncwrite       -- N records of --record_size bytes, each synced,
+//                      written through a GroupCommitWriter by each thread
+//                      count in --threads
+//   syncwrite_mutex -- syncwrite with the threads taking turns on a plain
+//                      mutex around log::Writer::AddRecord() and Sync(), as
+//                      a baseline without group commit
+//   write           -- syncwrite without syncs
+//   read            -- write N records from one thread, then read them back
+//                      with a log::Reader reading --read_size bytes at a time
+//
+// Records are JSON documents.  Each line also reports the bytes written to
+// the file per record byte, to measure what --compression saves.
+//
+// Logs are written to files in the test directory; run it on the device
+// under test, since the sync cost dominates.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "env.h"
+#include "group_commit_writer.h"
+#include "log_reader.h"
+#include "log_writer.h"
+#include "mutexlock.h"
+#include "port.h"
+#include "random.h"
+
+namespace {
+
+// Comma-separated list of operations to run
+const char* FLAGS_benchmarks = "syncwrite,syncwrite_mutex,write,read";
+
+// Number of records to write, split evenly across the threads
+int FLAGS_num = 20000;
+
+// Comma-separated list of writer thread counts
+const char* FLAGS_threads = "1,2,4,8,16,32,64";
+
+// Size of each record
+int FLAGS_record_size = 100;
+
+// Compression of the records
+leveldb::CompressionType FLAGS_compression = leveldb::kNoCompression;
+
+// Bytes read from the file at a time by the "read" benchmark
+int FLAGS_read_size = 32768;
+
+}  // namespace
+
+namespace leveldb {
+
+namespace {
+
+bool SnappySupported() {
+	std::string out;
+	const std::string in(100, 'x');
+	return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
+std::vector<int> ParseIntList(const char* list) {
+	std::vector<int> result;
+	while (list != nullptr && *list != '\0') {
+		result.push_back(atoi(list));
+		list = strchr(list, ',');
+		if (list != nullptr) list++;
+	}
+	return result;
+}
+
+// Fill *record with JSON documents up to size bytes
+void MakeRecord(Random* rnd, int size, std::string* record) {
+	static const char* kNames[] = { "alice", "bob", "carol", "dave", "erin" };
+	record->assign("[");
+	char buf[256];
+	while (static_cast<int>(record->size()) < size) {
+		const char* name = kNames[rnd->Uniform(5)];
+		snprintf(buf, sizeof(buf),
+			"{\"id\":%u,\"user\":\"%s%u\",\"email\":\"%s%u@example.com\","
+			"\"active\":%s,\"score\":%u,\"tags\":[\"orders\",\"eu-west\"]},",
+			rnd->Next(), name, rnd->Uniform(10000), name, rnd->Uniform(10000),
+			rnd->OneIn(2) ? "true" : "false", rnd->Uniform(1000));
+		record->append(buf);
+	}
+	record->resize(size);
+}
+
+// Counts the bytes and the Sync() calls reaching the file
+class CountingFile : public WritableFile {
+public:
+	explicit CountingFile(WritableFile* target)
+		: target_(target), bytes_(0), syncs_(0) { }
+	~CountingFile() { delete target_; }
+
+	Status Append(const Slice& data) override {
+		bytes_ += data.size();
+		return target_->Append(data);
+	}
+	Status AppendV(const Slice* data, size_t n) override {
+		for (size_t i = 0; i < n; i++) {
+			bytes_ += data[i].size();
+		}
+		return target_->AppendV(data, n);
+	}
+	Status Close() override { return target_->Close(); }
+	Status Flush() override { return target_->Flush(); }
+	Status Sync() override {
+		syncs_++;
+		return target_->Sync();
+	}
+
+	uint64_t bytes() const { return bytes_; }
+	int syncs() const { return syncs_; }
+
+private:
+	WritableFile* const target_;
+	std::atomic<uint64_t> bytes_;
+	int syncs_;
+};
+
+class Benchmark {
+private:
+	Env* const env_;
+	std::string dir_;
+	std::vector<std::string> records_;
+
+	static const int kNumRecords = 64;  // Distinct records, written in turn
+
+	void Write(const char* name, bool sync, bool group_commit) {
+		std::vector<int> thread_counts = ParseIntList(FLAGS_threads);
+		for (size_t t = 0; t < thread_counts.size(); t++) {
+			const int threads = thread_counts[t];
+			const int per_thread = FLAGS_num / threads;
+			const std::string fname = dir_ + "/log_bench.log";
+			WritableFile* base;
+			Status s = env_->NewWritableFile(fname, &base);
+			if (!s.ok()) {
+				fprintf(stderr, "%s: %s\n", name, s.ToString().c_str());
+				return;
+			}
+			CountingFile file(base);
+			log::Writer writer(&file, 1, false, FLAGS_compression);
+			log::GroupCommitWriter group_writer(&writer, &file);
+			port::Mutex mu;
+
+			std::vector<std::thread> workers;
+			const uint64_t start = env_->NowMicros();
+			for (int id = 0; id < threads; id++) {
+				workers.emplace_back([&, id]() {
+					for (int i = 0; i < per_thread; i++) {
+						const std::string& record = records_[(id + i) % kNumRecords];
+						Status s;
+						if (group_commit) {
+							s = group_writer.AddRecord(record, sync);
+						}
+						else {
+							MutexLock l(&mu);
+							s = writer.AddRecord(record);
+							if (s.ok() && sync) {
+								s = file.Sync();
+							}
+						}
+						if (!s.ok()) {
+							fprintf(stderr, "%s: %s\n", name, s.ToString().c_str());
+							exit(1);
+						}
+					}
+				});
+			}
+			for (size_t i = 0; i < workers.size(); i++) {
+				workers[i].join();
+			}
+			const uint64_t micros = env_->NowMicros() - start;
+			const int num = per_thread * threads;
+			fprintf(stdout, "%-16s : threads=%-3d %11.3f micros/op %10.0f ops/sec %8.1f records/sync %6.3f bytes/byte\n",
+				name, threads, micros / static_cast<double>(num),
+				num / (micros * 1e-6),
+				file.syncs() > 0 ? num / static_cast<double>(file.syncs()) : 0.0,
+				file.bytes() / (static_cast<double>(num) * FLAGS_record_size));
+			fflush(stdout);
+			file.Close();
+			env_->DeleteFile(fname);
+		}
+	}
+
+	void Read() {
+		const std::string fname = dir_ + "/log_bench.log";
+		WritableFile* base;
+		Status s = env_->NewWritableFile(fname, &base);
+		CountingFile file(base);
+		if (s.ok()) {
+			log::Writer writer(&file, 1, false, FLAGS_compression);
+			const uint64_t start = env_->NowMicros();
+			for (int i = 0; i < FLAGS_num && s.ok(); i++) {
+				s = writer.AddRecord(records_[i % kNumRecords]);
+			}
+			if (s.ok()) {
+				s = file.Close();
+			}
+			const uint64_t micros = env_->NowMicros() - start;
+			fprintf(stdout, "%-16s : %11.3f micros/op %8.1f MB/s %6.3f bytes/byte\n",
+				"read(write)", micros / static_cast<double>(FLAGS_num),
+				(static_cast<double>(FLAGS_num) * FLAGS_record_size / 1048576.0) /
+				(micros * 1e-6),
+				file.bytes() / (static_cast<double>(FLAGS_num) * FLAGS_record_size));
+		}
+
+		SequentialFile* source = nullptr;
+		if (s.ok()) {
+			s = env_->NewSequentialFile(fname, &source);
+		}
+		if (s.ok()) {
+			log::Reader reader(source, nullptr, true, 0, 1, FLAGS_read_size);
+			std::string scratch;
+			Slice record;
+			int found = 0;
+			int64_t bytes = 0;
+			const uint64_t start = env_->NowMicros();
+			while (reader.ReadRecord(&record, &scratch)) {
+				found++;
+				bytes += record.size();
+			}
+			const uint64_t micros = env_->NowMicros() - start;
+			if (found != FLAGS_num) {
+				fprintf(stderr, "read: %d of %d records\n", found, FLAGS_num);
+			}
+			fprintf(stdout, "%-16s : read_size=%-8d %11.3f micros/op %8.1f MB/s\n",
+				"read", FLAGS_read_size, micros / static_cast<double>(found),
+				(bytes / 1048576.0) / (micros * 1e-6));
+			delete source;
+		}
+		if (!s.ok()) {
+			fprintf(stderr, "read: %s\n", s.ToString().c_str());
+		}
+		fflush(stdout);
+		env_->DeleteFile(fname);
+	}
+
+public:
+	Benchmark() : env_(Env::Default()) {
+		env_->GetTestDirectory(&dir_);
+		Random rnd(301);
+		records_.resize(kNumRecords);
+		for (int i = 0; i < kNumRecords; i++) {
+			MakeRecord(&rnd, FLAGS_record_size, &records_[i]);
+		}
+	}
+
+	void Run() {
+		fprintf(stdout, "Records:    %d bytes each\n", FLAGS_record_size);
+		fprintf(stdout, "Entries:    %d\n", FLAGS_num);
+		fprintf(stdout, "Compression: %s%s\n",
+			FLAGS_compression == kNoCompression ? "none" : "snappy",
+			FLAGS_compression != kNoCompression && !SnappySupported() ?
+			" (not supported, records are written uncompressed)" : "");
+		fprintf(stdout, "Directory:  %s\n", dir_.c_str());
+		fprintf(stdout, "------------------------------------------------\n");
+
+		const char* benchmarks = FLAGS_benchmarks;
+		while (benchmarks != nullptr) {
+			const char* sep = strchr(benchmarks, ',');
+			Slice name;
+			if (sep == nullptr) {
+				name = benchmarks;
+				benchmarks = nullptr;
+			}
+			else {
+				name = Slice(benchmarks, sep - benchmarks);
+				benchmarks = sep + 1;
+			}
+
+			if (name == Slice("syncwrite")) {
+				Write("syncwrite", true, true);
+			}
+			else if (name == Slice("syncwrite_mutex")) {
+				Write("syncwrite_mutex", true, false);
+			}
+			else if (name == Slice("write")) {
+				Write("write", false, true);
+			}
+			else if (name == Slice("read")) {
+				Read();
+			}
+			else if (!name.empty()) {
+				fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
+			}
+		}
+	}
+};
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		int n;
+		char junk;
+		if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
+			FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
+		}
+		else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
+			FLAGS_num = n;
+		}
+		else if (leveldb::Slice(argv[i]).starts_with("--threads=")) {
+			FLAGS_threads = argv[i] + strlen("--threads=");
+		}
+		else if (sscanf(argv[i], "--record_size=%d%c", &n, &junk) == 1) {
+			FLAGS_record_size = n;
+		}
+		else if (sscanf(argv[i], "--read_size=%d%c", &n, &junk) == 1) {
+			FLAGS_read_size = n;
+		}
+		else if (leveldb::Slice(argv[i]) == leveldb::Slice("--compression=none")) {
+			FLAGS_compression = leveldb::kNoCompression;
+		}
+		else if (leveldb::Slice(argv[i]) == leveldb::Slice("--compression=snappy")) {
+			FLAGS_compression = leveldb::kSnappyCompression;
+		}
+		else {
+			fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	leveldb::Benchmark benchmark;
+	benchmark.Run();
+	return 0;
+}
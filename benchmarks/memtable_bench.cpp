@@ -0,0 +1,543 @@
+// Microbenchmarks for the in-memory write and read paths.
+//
+// Usage: memtable_bench [--benchmarks=name,...] [--num=N] [--threads=T,...]
+//                        [--arena_block_sizes=B,...] [--huge_page_size=H]
+//                        [--memtable_rep=skiplist|hashindex|vector|inline]
+//                        [--batch_sizes=B,...] [--flush_threads=T,...]
+//
+//   fillseq         -- N Add() calls with keys in ascending order
+//   fillbatch       -- fillseq through AddBatch() in batches of 1000
+//   fillrandom      -- N Add() calls with random keys from one thread
+//   bulkload        -- fillrandom followed by one full scan, as a flush
+//                      of the memtable would do
+//   fillconcurrent  -- N AddConcurrent() calls with random keys, split
+//                      evenly across each thread count in --threads
+//   seekrandom      -- N iterator Seek() calls for random keys, present or
+//                      not, in a memtable of N entries
+//   readrandom      -- N Get() calls for keys present in a memtable of N
+//                      entries, once for each size in --arena_block_sizes,
+//                      with blocks backed by huge pages if --huge_page_size
+//                      is non-zero
+//   multiget        -- readrandom through MultiGet(), once for each batch
+//                      size in --batch_sizes.  The default --num makes the
+//                      memtable (about 150MB) larger than the L3 cache
+//   memusage        -- fillrandom, then ApproximateMemoryUsage() divided
+//                      by the number of entries
+//   flush           -- fillrandom, then FlushMemTable() to a table file in
+//                      the test directory, once for each
+//                      Options::table_builder_threads in --flush_threads
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <utility>
+#include <thread>
+#include <vector>
+
+#include "builder.h"
+#include "comparator.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "options.h"
+#include "random.h"
+
+namespace {
+
+// Comma-separated list of operations to run
+const char* FLAGS_benchmarks = "fillseq,fillbatch,fillrandom,bulkload,fillconcurrent,seekrandom,readrandom,multiget,memusage,flush";
+
+// Number of key/values to place in the memtable
+int FLAGS_num = 1000000;
+
+// Comma-separated list of thread counts for the multi-threaded benchmarks
+const char* FLAGS_threads = "1,2,4,8,16,32";
+
+// Comma-separated list of Options::arena_block_size values for readrandom
+const char* FLAGS_arena_block_sizes = "4096,65536,1048576,4194304";
+
+// Options::memtable_huge_page_size for readrandom
+int FLAGS_huge_page_size = 0;
+
+// Comma-separated list of MultiGet() batch sizes for multiget
+const char* FLAGS_batch_sizes = "1,8,32,128";
+
+// Comma-separated list of Options::table_builder_threads values for flush
+const char* FLAGS_flush_threads = "0,1,2,4";
+
+// Options::memtable_rep for every benchmark
+leveldb::MemTableRepType FLAGS_memtable_rep = leveldb::kSkipListRep;
+
+// Size of each key and value
+const int kKeySize = 16;
+const int kValueSize = 100;
+
+}  // namespace
+
+namespace leveldb {
+
+namespace {
+
+std::vector<int> ParseIntList(const char* list) {
+	std::vector<int> result;
+	while (list != nullptr && *list != '\0') {
+		result.push_back(atoi(list));
+		list = strchr(list, ',');
+		if (list != nullptr) list++;
+	}
+	return result;
+}
+
+// Write a random fixed-size key into buf
+void RandomKey(Random* rnd, char* buf) {
+	snprintf(buf, kKeySize + 1, "%08x%08x", rnd->Next(), 0u);
+}
+
+class Benchmark {
+private:
+	InternalKeyComparator icmp_;
+	std::string value_;
+
+	void Report(const char* name, int threads, int num, uint64_t micros) {
+		double seconds = micros * 1e-6;
+		fprintf(stdout, "%-20s : threads=%-3d %11.3f micros/op %12.0f ops/sec\n",
+			name, threads, micros / static_cast<double>(num),
+			num / seconds);
+		fflush(stdout);
+	}
+
+	Options NewOptions() {
+		Options options;
+		options.memtable_rep = FLAGS_memtable_rep;
+		return options;
+	}
+
+	void FillSeq() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		char key[kKeySize + 1];
+		const uint64_t start = Env::Default()->NowMicros();
+		for (int i = 0; i < FLAGS_num; i++) {
+			snprintf(key, sizeof(key), "%016d", i);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+		Report("fillseq", 1, FLAGS_num, Env::Default()->NowMicros() - start);
+		mem->Unref();
+	}
+
+	void FillBatch() {
+		const int kBatchSize = 1000;
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		std::vector<std::string> keys(kBatchSize);
+		std::vector<MemTable::BatchEntry> batch(kBatchSize);
+		char key[kKeySize + 1];
+		const uint64_t start = Env::Default()->NowMicros();
+		for (int i = 0; i < FLAGS_num; i += kBatchSize) {
+			const int n = std::min(kBatchSize, FLAGS_num - i);
+			for (int j = 0; j < n; j++) {
+				snprintf(key, sizeof(key), "%016d", i + j);
+				keys[j].assign(key, kKeySize);
+				batch[j].type = kTypeValue;
+				batch[j].key = keys[j];
+				batch[j].value = value_;
+			}
+			mem->AddBatch(i + 1, batch.data(), n);
+		}
+		Report("fillbatch", 1, FLAGS_num, Env::Default()->NowMicros() - start);
+		mem->Unref();
+	}
+
+	void BulkLoad() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		const uint64_t start = Env::Default()->NowMicros();
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&rnd, key);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+		Iterator* iter = mem->NewIterator();
+		int count = 0;
+		for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+			count++;
+		}
+		delete iter;
+		const uint64_t micros = Env::Default()->NowMicros() - start;
+		if (count != FLAGS_num) {
+			fprintf(stderr, "bulkload: scanned %d of %d entries\n", count, FLAGS_num);
+		}
+		Report("bulkload", 1, FLAGS_num, micros);
+		mem->Unref();
+	}
+
+	void FillRandom() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		const uint64_t start = Env::Default()->NowMicros();
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&rnd, key);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+		Report("fillrandom", 1, FLAGS_num, Env::Default()->NowMicros() - start);
+		mem->Unref();
+	}
+
+	void FillConcurrent() {
+		std::vector<int> thread_counts = ParseIntList(FLAGS_threads);
+		for (size_t t = 0; t < thread_counts.size(); t++) {
+			const int threads = thread_counts[t];
+			const int per_thread = FLAGS_num / threads;
+			Options options = NewOptions();
+			options.allow_concurrent_memtable_write = true;
+			MemTable* mem = new MemTable(icmp_, options);
+			mem->Ref();
+
+			std::vector<std::thread> workers;
+			const uint64_t start = Env::Default()->NowMicros();
+			for (int id = 0; id < threads; id++) {
+				workers.emplace_back([this, mem, id, per_thread]() {
+					Random rnd(301 + id);
+					char key[kKeySize + 1];
+					const SequenceNumber base =
+						static_cast<SequenceNumber>(id) * per_thread + 1;
+					for (int i = 0; i < per_thread; i++) {
+						RandomKey(&rnd, key);
+						mem->AddConcurrent(base + i, kTypeValue,
+							Slice(key, kKeySize), value_);
+					}
+				});
+			}
+			for (size_t i = 0; i < workers.size(); i++) {
+				workers[i].join();
+			}
+			Report("fillconcurrent", threads, per_thread * threads,
+				Env::Default()->NowMicros() - start);
+			mem->Unref();
+		}
+	}
+
+	void SeekRandom() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&rnd, key);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+
+		Iterator* iter = mem->NewIterator();
+		Random seek_rnd(1000);
+		int found = 0;
+		const uint64_t start = Env::Default()->NowMicros();
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&seek_rnd, key);
+			LookupKey lkey(Slice(key, kKeySize), kMaxSequenceNumber);
+			iter->Seek(lkey.internal_key());
+			if (iter->Valid()) {
+				found++;
+			}
+		}
+		const uint64_t micros = Env::Default()->NowMicros() - start;
+		if (found == 0) {
+			fprintf(stderr, "seekrandom: no seek found an entry\n");
+		}
+		Report("seekrandom", 1, FLAGS_num, micros);
+		delete iter;
+		mem->Unref();
+	}
+
+	void ReadRandom() {
+		std::vector<int> block_sizes = ParseIntList(FLAGS_arena_block_sizes);
+		for (size_t b = 0; b < block_sizes.size(); b++) {
+			Options options = NewOptions();
+			options.arena_block_size = block_sizes[b];
+			options.memtable_huge_page_size = FLAGS_huge_page_size;
+			MemTable* mem = new MemTable(icmp_, options);
+			mem->Ref();
+			Random rnd(301);
+			char key[kKeySize + 1];
+			for (int i = 0; i < FLAGS_num; i++) {
+				RandomKey(&rnd, key);
+				mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+			}
+
+			// Look the keys up in a different order than they were added
+			Random read_rnd(301);
+			std::vector<uint32_t> seeds(FLAGS_num);
+			for (int i = 0; i < FLAGS_num; i++) {
+				seeds[i] = read_rnd.Next();
+			}
+			for (int i = FLAGS_num - 1; i > 0; i--) {
+				std::swap(seeds[i], seeds[rnd.Uniform(i + 1)]);
+			}
+
+			std::string value;
+			int found = 0;
+			const uint64_t start = Env::Default()->NowMicros();
+			for (int i = 0; i < FLAGS_num; i++) {
+				snprintf(key, sizeof(key), "%08x%08x", seeds[i], 0u);
+				LookupKey lkey(Slice(key, kKeySize), kMaxSequenceNumber);
+				Status s;
+				if (mem->Get(lkey, &value, &s) && s.ok()) {
+					found++;
+				}
+			}
+			const uint64_t micros = Env::Default()->NowMicros() - start;
+			if (found != FLAGS_num) {
+				fprintf(stderr, "readrandom: found %d of %d keys\n", found, FLAGS_num);
+			}
+			char name[64];
+			snprintf(name, sizeof(name), "readrandom/%d", block_sizes[b]);
+			Report(name, 1, FLAGS_num, micros);
+			mem->Unref();
+		}
+	}
+
+	void MultiGet() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		std::vector<uint32_t> seeds(FLAGS_num);
+		for (int i = 0; i < FLAGS_num; i++) {
+			seeds[i] = rnd.Next();
+			snprintf(key, sizeof(key), "%08x%08x", seeds[i], 0u);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+		for (int i = FLAGS_num - 1; i > 0; i--) {
+			std::swap(seeds[i], seeds[rnd.Uniform(i + 1)]);
+		}
+
+		std::vector<int> batch_sizes = ParseIntList(FLAGS_batch_sizes);
+		for (size_t b = 0; b < batch_sizes.size(); b++) {
+			const int batch_size = std::max(1, batch_sizes[b]);
+			std::vector<std::string> values(batch_size);
+			std::vector<Status> statuses(batch_size);
+			std::unique_ptr<bool[]> found(new bool[batch_size]);
+			std::vector<LookupKey*> keys(batch_size);
+			int hits = 0;
+			const uint64_t start = Env::Default()->NowMicros();
+			for (int i = 0; i < FLAGS_num; i += batch_size) {
+				const int n = std::min(batch_size, FLAGS_num - i);
+				for (int j = 0; j < n; j++) {
+					snprintf(key, sizeof(key), "%08x%08x", seeds[i + j], 0u);
+					keys[j] = new LookupKey(Slice(key, kKeySize), kMaxSequenceNumber);
+				}
+				mem->MultiGet(keys.data(), n, values.data(), statuses.data(),
+					found.get());
+				for (int j = 0; j < n; j++) {
+					if (found[j]) {
+						hits++;
+					}
+					delete keys[j];
+				}
+			}
+			const uint64_t micros = Env::Default()->NowMicros() - start;
+			if (hits != FLAGS_num) {
+				fprintf(stderr, "multiget: found %d of %d keys\n", hits, FLAGS_num);
+			}
+			char name[64];
+			snprintf(name, sizeof(name), "multiget/%d", batch_size);
+			Report(name, 1, FLAGS_num, micros);
+		}
+		mem->Unref();
+	}
+
+	void MemUsage() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&rnd, key);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+		const size_t usage = mem->ApproximateMemoryUsage();
+		// Key, tag and value, with their length prefixes
+		const int payload = 1 + kKeySize + 8 + 1 + kValueSize;
+		fprintf(stdout, "%-20s : %11.1f bytes/entry (entry %d bytes, %.1f overhead)\n",
+			"memusage", usage / static_cast<double>(FLAGS_num), payload,
+			usage / static_cast<double>(FLAGS_num) - payload);
+		fflush(stdout);
+		mem->Unref();
+	}
+
+	void Flush() {
+		Options options = NewOptions();
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		Random rnd(301);
+		char key[kKeySize + 1];
+		for (int i = 0; i < FLAGS_num; i++) {
+			RandomKey(&rnd, key);
+			mem->Add(i + 1, kTypeValue, Slice(key, kKeySize), value_);
+		}
+
+		Env* env = Env::Default();
+		std::string dbname;
+		env->GetTestDirectory(&dbname);
+		dbname += "/memtable_bench";
+		env->CreateDir(dbname);
+		options.comparator = &icmp_;
+		std::vector<int> thread_counts = ParseIntList(FLAGS_flush_threads);
+		for (size_t t = 0; t < thread_counts.size(); t++) {
+			options.table_builder_threads = thread_counts[t];
+			uint64_t file_size = 0;
+			const uint64_t start = env->NowMicros();
+			Status s = FlushMemTable(dbname, env, options, nullptr, mem, 1,
+				&file_size);
+			const uint64_t micros = env->NowMicros() - start;
+			if (!s.ok()) {
+				fprintf(stderr, "flush: %s\n", s.ToString().c_str());
+				break;
+			}
+			char name[32];
+			snprintf(name, sizeof(name), "flush/%d", thread_counts[t]);
+			fprintf(stdout, "%-20s : %11.3f micros/op %9.1f MB/s (%.1f MB written)\n",
+				name, micros / static_cast<double>(FLAGS_num),
+				file_size / 1048576.0 / (micros * 1e-6), file_size / 1048576.0);
+			fflush(stdout);
+			env->DeleteFile(TableFileName(dbname, 1));
+		}
+		mem->Unref();
+	}
+
+public:
+	Benchmark() : icmp_(BytewiseComparator()), value_(kValueSize, 'x') { }
+
+	void Run() {
+		fprintf(stdout, "Keys:       %d bytes each\n", kKeySize);
+		fprintf(stdout, "Values:     %d bytes each\n", kValueSize);
+		fprintf(stdout, "Entries:    %d\n", FLAGS_num);
+		fprintf(stdout, "Huge pages: %d bytes\n", FLAGS_huge_page_size);
+		const char* rep = "skiplist";
+		if (FLAGS_memtable_rep == kHashIndexRep) {
+			rep = "hashindex";
+		}
+		else if (FLAGS_memtable_rep == kVectorRep) {
+			rep = "vector";
+		}
+		else if (FLAGS_memtable_rep == kInlineSkipListRep) {
+			rep = "inline";
+		}
+		fprintf(stdout, "Rep:        %s\n", rep);
+		fprintf(stdout, "------------------------------------------------\n");
+
+		const char* benchmarks = FLAGS_benchmarks;
+		while (benchmarks != nullptr) {
+			const char* sep = strchr(benchmarks, ',');
+			Slice name;
+			if (sep == nullptr) {
+				name = benchmarks;
+				benchmarks = nullptr;
+			}
+			else {
+				name = Slice(benchmarks, sep - benchmarks);
+				benchmarks = sep + 1;
+			}
+
+			if (name == Slice("fillseq")) {
+				FillSeq();
+			}
+			else if (name == Slice("fillbatch")) {
+				FillBatch();
+			}
+			else if (name == Slice("fillrandom")) {
+				FillRandom();
+			}
+			else if (name == Slice("bulkload")) {
+				BulkLoad();
+			}
+			else if (name == Slice("fillconcurrent")) {
+				FillConcurrent();
+			}
+			else if (name == Slice("seekrandom")) {
+				SeekRandom();
+			}
+			else if (name == Slice("readrandom")) {
+				ReadRandom();
+			}
+			else if (name == Slice("multiget")) {
+				MultiGet();
+			}
+			else if (name == Slice("memusage")) {
+				MemUsage();
+			}
+			else if (name == Slice("flush")) {
+				Flush();
+			}
+			else if (!name.empty()) {
+				fprintf(stderr, "unknown benchmark '%s'\n", name.ToString().c_str());
+			}
+		}
+	}
+};
+
+}  // namespace
+
+}  // namespace leveldb
+
+int main(int argc, char** argv) {
+	for (int i = 1; i < argc; i++) {
+		int n;
+		char junk;
+		if (leveldb::Slice(argv[i]).starts_with("--benchmarks=")) {
+			FLAGS_benchmarks = argv[i] + strlen("--benchmarks=");
+		}
+		else if (sscanf(argv[i], "--num=%d%c", &n, &junk) == 1) {
+			FLAGS_num = n;
+		}
+		else if (leveldb::Slice(argv[i]).starts_with("--flush_threads=")) {
+			FLAGS_flush_threads = argv[i] + strlen("--flush_threads=");
+		}
+		else if (leveldb::Slice(argv[i]).starts_with("--threads=")) {
+			FLAGS_threads = argv[i] + strlen("--threads=");
+		}
+		else if (leveldb::Slice(argv[i]).starts_with("--arena_block_sizes=")) {
+			FLAGS_arena_block_sizes = argv[i] + strlen("--arena_block_sizes=");
+		}
+		else if (leveldb::Slice(argv[i]).starts_with("--batch_sizes=")) {
+			FLAGS_batch_sizes = argv[i] + strlen("--batch_sizes=");
+		}
+		else if (sscanf(argv[i], "--huge_page_size=%d%c", &n, &junk) == 1) {
+			FLAGS_huge_page_size = n;
+		}
+		else if (strcmp(argv[i], "--memtable_rep=skiplist") == 0) {
+			FLAGS_memtable_rep = leveldb::kSkipListRep;
+		}
+		else if (strcmp(argv[i], "--memtable_rep=hashindex") == 0) {
+			FLAGS_memtable_rep = leveldb::kHashIndexRep;
+		}
+		else if (strcmp(argv[i], "--memtable_rep=vector") == 0) {
+			FLAGS_memtable_rep = leveldb::kVectorRep;
+		}
+		else if (strcmp(argv[i], "--memtable_rep=inline") == 0) {
+			FLAGS_memtable_rep = leveldb::kInlineSkipListRep;
+		}
+		else {
+			fprintf(stderr, "Invalid flag '%s'\n", argv[i]);
+			exit(1);
+		}
+	}
+
+	leveldb::Benchmark benchmark;
+	benchmark.Run();
+	return 0;
+}
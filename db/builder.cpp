@@ -0,0 +1,111 @@
+#include "builder.h"
+
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "options.h"
+#include "table_builder.h"
+#include "table_cache.h"
+
+namespace leveldb {
+
+Status BuildTable(const std::string& dbname,
+	Env* env,
+	const Options& options,
+	TableCache* table_cache,
+	Iterator* iter,
+	Iterator* range_del_iter,
+	uint64_t number,
+	uint64_t* file_size) {
+	Status s;
+	*file_size = 0;
+	iter->SeekToFirst();
+	if (range_del_iter != NULL) {
+		range_del_iter->SeekToFirst();
+	}
+	const bool has_range_dels = range_del_iter != NULL && range_del_iter->Valid();
+
+	std::string fname = TableFileName(dbname, number);
+	if (iter->Valid() || has_range_dels) {
+		WritableFile* file;
+		s = options.use_direct_writes ? env->NewDirectWritableFile(fname, &file)
+			: env->NewWritableFile(fname, &file);
+		if (!s.ok()) {
+			return s;
+		}
+
+		// 数据块的压缩和写入可以在TableBuilder的后台线程中进行，
+		// 这里只负责遍历并切分data block
+		TableBuilder* builder = new TableBuilder(options, file);
+		for (; iter->Valid(); iter->Next()) {
+			builder->Add(iter->key(), iter->value());
+		}
+		if (has_range_dels) {
+			for (; range_del_iter->Valid(); range_del_iter->Next()) {
+				builder->AddTombstone(range_del_iter->key(), range_del_iter->value());
+			}
+		}
+
+		// Finish and check for builder errors
+		s = builder->Finish();
+		if (s.ok()) {
+			*file_size = builder->FileSize();
+		}
+		delete builder;
+
+		// Finish and check for file errors
+		if (s.ok()) {
+			s = file->Sync();
+		}
+		if (s.ok()) {
+			s = file->Close();
+		}
+		delete file;
+		file = NULL;
+
+		if (s.ok() && table_cache != NULL) {
+			// Verify that the table is usable
+			Iterator* it = table_cache->NewIterator(ReadOptions(), number,
+				*file_size);
+			s = it->status();
+			delete it;
+		}
+	}
+
+	// Check for input iterator errors
+	if (!iter->status().ok()) {
+		s = iter->status();
+	}
+	if (s.ok() && range_del_iter != NULL && !range_del_iter->status().ok()) {
+		s = range_del_iter->status();
+	}
+
+	if (s.ok() && *file_size > 0) {
+		// Keep it
+	}
+	else {
+		env->DeleteFile(fname);
+		*file_size = 0;
+	}
+	return s;
+}
+
+Status FlushMemTable(const std::string& dbname,
+	Env* env,
+	const Options& options,
+	TableCache* table_cache,
+	MemTable* mem,
+	uint64_t number,
+	uint64_t* file_size) {
+	Iterator* iter = mem->NewIterator();
+	Iterator* range_del_iter = mem->NewRangeTombstoneIterator();
+	Status s = BuildTable(dbname, env, options, table_cache, iter,
+		range_del_iter, number, file_size);
+	delete range_del_iter;
+	delete iter;
+	return s;
+}
+
+}  // namespace leveldb
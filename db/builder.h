@@ -0,0 +1,50 @@
+#ifndef STORAGE_LEVELDB_DB_BUILDER_H_
+#define STORAGE_LEVELDB_DB_BUILDER_H_
+
+#include <stdint.h>
+#include <string>
+#include "status.h"
+
+namespace leveldb {
+
+struct Options;
+
+class Env;
+class Iterator;
+class MemTable;
+class TableCache;
+
+// Build a Table file from the contents of *iter, followed by the range
+// tombstones yielded by *range_del_iter (may be NULL).  The generated
+// file will be named TableFileName(dbname, number).  On success,
+// *file_size is set to the size of the generated file.  If neither
+// iterator yields anything, *file_size is set to zero, and no Table file
+// will be produced.  If table_cache is non-NULL, the new table is opened
+// through it to check that it is usable.
+//
+// options.comparator must order the internal keys yielded by the
+// iterators.  With options.table_builder_threads > 0 the data blocks are
+// compressed and written by background threads while *iter is drained.
+extern Status BuildTable(const std::string& dbname,
+	Env* env,
+	const Options& options,
+	TableCache* table_cache,
+	Iterator* iter,
+	Iterator* range_del_iter,
+	uint64_t number,
+	uint64_t* file_size);
+
+// Flush job of a memtable: write all of its entries and range tombstones
+// to table file "number" with BuildTable().
+// REQUIRES: mem is no longer being written to.
+extern Status FlushMemTable(const std::string& dbname,
+	Env* env,
+	const Options& options,
+	TableCache* table_cache,
+	MemTable* mem,
+	uint64_t number,
+	uint64_t* file_size);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_BUILDER_H_
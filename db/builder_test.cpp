@@ -0,0 +1,238 @@
+#include "builder.h"
+
+#include "cache.h"
+#include "dbformat.h"
+#include "env.h"
+#include "filename.h"
+#include "filter_policy.h"
+#include "iterator.h"
+#include "memtable.h"
+#include "options.h"
+#include "random.h"
+#include "table_cache.h"
+#include "testharness.h"
+#include "testutil.h"
+
+namespace leveldb {
+
+class BuilderTest {
+public:
+	InternalKeyComparator icmp_;
+	InternalFilterPolicy ifilter_;
+	const FilterPolicy* bloom_;
+	Options options_;
+	MemTable* mem_;
+	Env* env_;
+	std::string dbname_;
+
+	BuilderTest()
+		: icmp_(BytewiseComparator()),
+		ifilter_(bloom_ = NewBloomFilterPolicy(10)),
+		env_(Env::Default()) {
+		mem_ = new MemTable(icmp_, options_);
+		mem_->Ref();
+		options_.comparator = &icmp_;
+		options_.filter_policy = &ifilter_;
+		ASSERT_OK(env_->GetTestDirectory(&dbname_));
+		dbname_ += "/builder_test";
+		env_->CreateDir(dbname_);
+	}
+
+	~BuilderTest() {
+		mem_->Unref();
+		delete bloom_;
+	}
+
+	// Fill the memtable with n entries and a few range tombstones
+	void Fill(int n) {
+		Random rnd(301);
+		std::string value;
+		SequenceNumber seq = 1;
+		for (int i = 0; i < n; i++) {
+			char key[16];
+			snprintf(key, sizeof(key), "%08d", i);
+			test::CompressibleString(&rnd, 0.5, 100 + rnd.Uniform(200), &value);
+			mem_->Add(seq++, kTypeValue, key, value);
+			if (i % 10 == 0) {
+				mem_->Add(seq++, kTypeDeletion, key, Slice());
+			}
+		}
+		mem_->Add(seq++, kTypeRangeDeletion, "00000100", "00000200");
+		mem_->Add(seq++, kTypeRangeDeletion, "00000150", "00000300");
+	}
+
+	std::string Flush(int threads, uint64_t number, uint64_t* file_size,
+		bool direct = false) {
+		Options options = options_;
+		options.table_builder_threads = threads;
+		options.use_direct_writes = direct;
+		ASSERT_OK(FlushMemTable(dbname_, env_, options, NULL, mem_, number,
+			file_size));
+		std::string contents;
+		if (*file_size > 0) {
+			ASSERT_OK(ReadFileToString(env_, TableFileName(dbname_, number),
+				&contents));
+			ASSERT_EQ(*file_size, contents.size());
+		}
+		return contents;
+	}
+};
+
+TEST(BuilderTest, FlushEmptyMemTable) {
+	uint64_t file_size = 1;
+	Flush(0, 1, &file_size);
+	ASSERT_EQ(0, file_size);
+	ASSERT_TRUE(!env_->FileExists(TableFileName(dbname_, 1)));
+	Flush(2, 2, &file_size);
+	ASSERT_EQ(0, file_size);
+	ASSERT_TRUE(!env_->FileExists(TableFileName(dbname_, 2)));
+}
+
+TEST(BuilderTest, ParallelMatchesSerial) {
+	Fill(20000);
+	uint64_t serial_size, parallel_size;
+	const std::string serial = Flush(0, 3, &serial_size);
+	ASSERT_GT(serial_size, 0);
+	for (int threads = 1; threads <= 4; threads++) {
+		const std::string parallel = Flush(threads, 4, &parallel_size);
+		ASSERT_EQ(serial_size, parallel_size);
+		ASSERT_TRUE(serial == parallel);
+	}
+
+	// The table holds the memtable contents and its tombstones
+	TableCache table_cache(dbname_, &options_, 10);
+	Table* table = NULL;
+	Iterator* table_iter = table_cache.NewIterator(ReadOptions(), 4,
+		parallel_size, &table);
+	ASSERT_OK(table_iter->status());
+	Iterator* mem_iter = mem_->NewIterator();
+	int count = 0;
+	table_iter->SeekToFirst();
+	for (mem_iter->SeekToFirst(); mem_iter->Valid(); mem_iter->Next()) {
+		ASSERT_TRUE(table_iter->Valid());
+		ASSERT_EQ(mem_iter->key().ToString(), table_iter->key().ToString());
+		ASSERT_EQ(mem_iter->value().ToString(), table_iter->value().ToString());
+		table_iter->Next();
+		count++;
+	}
+	ASSERT_TRUE(!table_iter->Valid());
+	ASSERT_EQ(22000, count);
+	delete mem_iter;
+
+	Iterator* range_del_iter = table->NewRangeTombstoneIterator(ReadOptions());
+	count = 0;
+	for (range_del_iter->SeekToFirst(); range_del_iter->Valid();
+		range_del_iter->Next()) {
+		count++;
+	}
+	ASSERT_EQ(2, count);
+	delete range_del_iter;
+	delete table_iter;
+
+	env_->DeleteFile(TableFileName(dbname_, 3));
+	env_->DeleteFile(TableFileName(dbname_, 4));
+}
+
+TEST(BuilderTest, DirectWritesAndReads) {
+	Fill(5000);
+	uint64_t buffered_size, direct_size;
+	const std::string buffered = Flush(0, 5, &buffered_size);
+	const std::string direct = Flush(0, 6, &direct_size, true);
+	ASSERT_EQ(buffered_size, direct_size);
+	ASSERT_TRUE(buffered == direct);
+
+	// Blocks read with direct I/O go through aligned buffers
+	options_.use_direct_reads = true;
+	TableCache table_cache(dbname_, &options_, 10);
+	Iterator* table_iter = table_cache.NewIterator(ReadOptions(), 6,
+		direct_size);
+	ASSERT_OK(table_iter->status());
+	Iterator* mem_iter = mem_->NewIterator();
+	table_iter->SeekToFirst();
+	for (mem_iter->SeekToFirst(); mem_iter->Valid(); mem_iter->Next()) {
+		ASSERT_TRUE(table_iter->Valid());
+		ASSERT_EQ(mem_iter->key().ToString(), table_iter->key().ToString());
+		ASSERT_EQ(mem_iter->value().ToString(), table_iter->value().ToString());
+		table_iter->Next();
+	}
+	ASSERT_TRUE(!table_iter->Valid());
+	delete mem_iter;
+	delete table_iter;
+
+	env_->DeleteFile(TableFileName(dbname_, 5));
+	env_->DeleteFile(TableFileName(dbname_, 6));
+}
+
+namespace {
+
+struct MultiGetResults {
+	std::vector<std::string> keys;
+	std::vector<std::string> values;
+};
+
+void SaveMultiGetResult(void* arg, size_t i, const Slice& k, const Slice& v) {
+	MultiGetResults* results = reinterpret_cast<MultiGetResults*>(arg);
+	results->keys[i] = k.ToString();
+	results->values[i] = v.ToString();
+}
+
+void SaveGetResult(void* arg, const Slice& k, const Slice& v) {
+	std::pair<std::string, std::string>* result =
+		reinterpret_cast<std::pair<std::string, std::string>*>(arg);
+	result->first = k.ToString();
+	result->second = v.ToString();
+}
+
+}  // namespace
+
+TEST(BuilderTest, TableMultiGet) {
+	Fill(5000);
+	uint64_t file_size;
+	Flush(0, 7, &file_size);
+
+	// Keys in no particular order, several of them in the same block, some
+	// missing from the table and some past its end
+	std::vector<InternalKey> lookups;
+	Random rnd(17);
+	for (int i = 0; i < 300; i++) {
+		char key[16];
+		snprintf(key, sizeof(key), "%08d", static_cast<int>(rnd.Uniform(5200)));
+		lookups.push_back(InternalKey(i % 5 == 0 ? std::string(key) + "x" : key,
+			kMaxSequenceNumber, kValueTypeForSeek));
+	}
+	std::vector<Slice> keys;
+	for (size_t i = 0; i < lookups.size(); i++) {
+		keys.push_back(lookups[i].Encode());
+	}
+
+	Cache* block_cache = NewLRUCache(1 << 20);
+	for (int round = 0; round < 4; round++) {
+		// Without and with a block cache, then warm; and with direct reads
+		Options options = options_;
+		options.block_cache = (round == 1 || round == 2) ? block_cache : NULL;
+		options.use_direct_reads = (round == 3);
+		TableCache table_cache(dbname_, &options, 10);
+		MultiGetResults results;
+		results.keys.resize(keys.size());
+		results.values.resize(keys.size());
+		std::vector<Status> statuses(keys.size());
+		table_cache.MultiGet(ReadOptions(), 7, file_size, keys.data(), keys.size(),
+			statuses.data(), &results, &SaveMultiGetResult);
+		int found = 0;
+		for (size_t i = 0; i < keys.size(); i++) {
+			ASSERT_OK(statuses[i]);
+			found += results.keys[i].empty() ? 0 : 1;
+			std::pair<std::string, std::string> expected;
+			ASSERT_OK(table_cache.Get(ReadOptions(), 7, file_size, keys[i],
+				&expected, &SaveGetResult));
+			ASSERT_EQ(expected.first, results.keys[i]);
+			ASSERT_EQ(expected.second, results.values[i]);
+		}
+		ASSERT_GT(found, 200);
+	}
+	delete block_cache;
+
+	env_->DeleteFile(TableFileName(dbname_, 7));
+}
+
+}  // namespace leveldb
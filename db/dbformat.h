@@ -50,9 +50,15 @@ class InternalKey;
 // 所以，每次put，db中就会新加入一份KV数据，即使该key已经存在；
 // 而delete等同于put空的value。为了区分真实kv数据和删除操作的mock数
 // 据，使用ValueType来标识
+// kTypeRangeDeletion删除[user key, value)范围内的所有key，value为范围的上界
+// 这类entry不和普通数据存放在一起，MemTable中单独存放
+// kTypeMerge的value是一个merge operand，读取时由Options::merge_operator
+// 和更早的value合并
 enum ValueType {
 	kTypeDeletion = 0x0,
-	kTypeValue = 0x1
+	kTypeValue = 0x1,
+	kTypeRangeDeletion = 0x2,
+	kTypeMerge = 0x3
 };
 // kValueTypeForSeek defines the ValueType that should be passed when
 // constructing a ParsedInternalKey object for seeking to a particular
@@ -60,7 +66,7 @@ enum ValueType {
 // and the value type is embedded as the low 8 bits in the sequence
 // number in internal keys, we need to use the highest-numbered
 // ValueType, not the lowest).
-static const ValueType kValueTypeForSeek = kTypeValue;
+static const ValueType kValueTypeForSeek = kTypeMerge;
 
 typedef uint64_t SequenceNumber;
 
@@ -185,7 +191,7 @@ inline bool ParseInternalKey(const Slice& internal_key,
 	result->sequence = num >> 8;
 	result->type = static_cast<ValueType>(c);
 	result->user_key = Slice(internal_key.data(), n - 8);
-	return (c <= static_cast<unsigned char>(kTypeValue));
+	return (c <= static_cast<unsigned char>(kValueTypeForSeek));
 }
 
 // A helper class useful for DBImpl::Get()
@@ -0,0 +1,97 @@
+#include "group_commit_writer.h"
+
+#include <vector>
+#include "env.h"
+#include "log_writer.h"
+#include "mutexlock.h"
+
+namespace leveldb {
+namespace log {
+
+// 一个等待写入的调用者，在自己的栈上分配
+struct GroupCommitWriter::Waiter {
+	explicit Waiter(port::Mutex* mu) : cv(mu) { }
+
+	const Slice* record;
+	bool sync;
+	bool done;  // 已经由leader写入，status为结果
+	Status status;
+	port::CondVar cv;
+};
+
+GroupCommitWriter::GroupCommitWriter(Writer* writer, WritableFile* dest)
+	: writer_(writer),
+	dest_(dest) {
+}
+
+GroupCommitWriter::~GroupCommitWriter() {
+	assert(waiters_.empty());
+}
+
+Status GroupCommitWriter::AddRecord(const Slice& record, bool sync) {
+	Waiter w(&mu_);
+	w.record = &record;
+	w.sync = sync;
+	w.done = false;
+
+	MutexLock l(&mu_);
+	waiters_.push_back(&w);
+	while (!w.done && &w != waiters_.front()) {
+		w.cv.Wait();
+	}
+	if (w.done) {
+		return w.status;
+	}
+
+	// 成为leader，把排在后面的record一起写入
+	// follower都在等待，它们的record在写入期间一直有效
+	Waiter* last_writer = &w;
+	std::vector<Slice> records;
+	bool need_sync = false;
+	size_t size = 0;
+	for (std::deque<Waiter*>::iterator iter = waiters_.begin();
+		iter != waiters_.end(); ++iter) {
+		Waiter* waiter = *iter;
+		if (waiter != &w && size + waiter->record->size() > kMaxGroupBytes) {
+			break;
+		}
+		records.push_back(*waiter->record);
+		size += waiter->record->size();
+		need_sync = need_sync || waiter->sync;
+		last_writer = waiter;
+	}
+
+	Status s = error_;
+	if (s.ok()) {
+		// 写入时释放锁，新的调用者可以继续排队，组成下一组
+		mu_.Unlock();
+		s = writer_->AddRecords(records.data(), records.size());
+		if (s.ok() && need_sync) {
+			s = dest_->Sync();
+		}
+		mu_.Lock();
+		if (!s.ok()) {
+			error_ = s;
+		}
+	}
+
+	while (true) {
+		Waiter* ready = waiters_.front();
+		waiters_.pop_front();
+		if (ready != &w) {
+			ready->status = s;
+			ready->done = true;
+			ready->cv.Signal();
+		}
+		if (ready == last_writer) break;
+	}
+
+	// Notify new head of write queue
+	if (!waiters_.empty()) {
+		waiters_.front()->cv.Signal();
+	}
+	return s;
+}
+
+}  // namespace log
+}  // namespace leveldb
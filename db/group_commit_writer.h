@@ -0,0 +1,61 @@
+#ifndef STORAGE_LEVELDB_DB_GROUP_COMMIT_WRITER_H_
+#define STORAGE_LEVELDB_DB_GROUP_COMMIT_WRITER_H_
+
+#include <deque>
+#include "port.h"
+#include "slice.h"
+#include "status.h"
+#include "thread_annotations.h"
+
+namespace leveldb {
+
+class WritableFile;
+
+namespace log {
+
+class Writer;
+
+// Thread-safe front-end of a log::Writer that commits the records of
+// concurrent callers together.  Callers queue up; the first one in the
+// queue becomes the leader, appends its own record and those queued
+// behind it as one contiguous run of records, issues a single Flush()
+// (and Sync(), if any of them asked for one) and wakes the others with
+// the outcome.  Under contention the cost of one fsync is thus shared
+// by a whole group of writes.
+class GroupCommitWriter {
+public:
+	// Records are written through "*writer", whose file is "*dest".  Both
+	// must remain live while this GroupCommitWriter is in use, and must
+	// not be used directly meanwhile.
+	GroupCommitWriter(Writer* writer, WritableFile* dest);
+	~GroupCommitWriter();
+
+	// Append "record" to the log.  If "sync" is true, the log is synced
+	// before this returns.  May be called by several threads at once.
+	// After a failed write or sync the state of the log is unknown, so
+	// every later call fails with the same error.
+	Status AddRecord(const Slice& record, bool sync);
+
+private:
+	struct Waiter;
+
+	// A leader stops adding records to its group past this many bytes, so
+	// that a small write is not held up by a long run of large ones.
+	static const size_t kMaxGroupBytes = 1 << 20;
+
+	Writer* const writer_;
+	WritableFile* const dest_;
+
+	port::Mutex mu_;
+	std::deque<Waiter*> waiters_ GUARDED_BY(mu_);  // Front is the leader
+	Status error_ GUARDED_BY(mu_);
+
+	// No copying allowed
+	GroupCommitWriter(const GroupCommitWriter&);
+	void operator=(const GroupCommitWriter&);
+};
+
+}  // namespace log
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_GROUP_COMMIT_WRITER_H_
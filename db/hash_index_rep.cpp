@@ -0,0 +1,142 @@
+#include <atomic>
+#include <new>
+
+#include "coding.h"
+#include "comparator.h"
+#include "hash.h"
+#include "memtablerep.h"
+
+namespace leveldb {
+
+namespace {
+
+class HashIndexRep : public MemTableRep {
+public:
+	HashIndexRep(const KeyComparator& cmp, Allocator* allocator,
+		size_t bucket_count)
+		: list_(NewSkipListRep(cmp, allocator)),
+		allocator_(allocator),
+		bucket_count_(bucket_count),
+		buckets_(nullptr) {
+		assert(bucket_count_ > 0);
+		char* mem = allocator_->AllocateAligned(sizeof(Bucket) * bucket_count_);
+		buckets_ = reinterpret_cast<Bucket*>(mem);
+		for (size_t i = 0; i < bucket_count_; i++) {
+			new (&buckets_[i]) Bucket(nullptr);
+		}
+	}
+
+	~HashIndexRep() override {
+		delete list_;
+	}
+
+	void Insert(const char* entry) override {
+		list_->Insert(entry);
+		AddToIndex(entry);
+	}
+
+	void InsertBatch(const char* const* entries, size_t n) override {
+		list_->InsertBatch(entries, n);
+		for (size_t i = 0; i < n; i++) {
+			AddToIndex(entries[i]);
+		}
+	}
+
+	void InsertConcurrently(const char* entry) override {
+		list_->InsertConcurrently(entry);
+		Node* n = NewNode(entry);
+		Bucket* bucket = BucketFor(UserKey(entry));
+		Node* head = bucket->load(std::memory_order_relaxed);
+		do {
+			n->next = head;
+		} while (!bucket->compare_exchange_weak(head, n,
+			std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	const char* Get(const char* key) const override {
+		const Slice user_key = UserKey(key);
+		const uint64_t tag = Tag(key);
+		// The first entry at or after key is the one for user_key with
+		// the largest tag not above the lookup tag
+		const char* result = nullptr;
+		uint64_t result_tag = 0;
+		for (Node* n = BucketFor(user_key)->load(std::memory_order_acquire);
+			n != nullptr; n = n->next) {
+			if (UserKey(n->entry) == user_key) {
+				const uint64_t entry_tag = Tag(n->entry);
+				if (entry_tag <= tag && (result == nullptr || entry_tag > result_tag)) {
+					result = n->entry;
+					result_tag = entry_tag;
+				}
+			}
+		}
+		return result;
+	}
+
+	size_t ApproximateMemoryUsage() const override {
+		return list_->ApproximateMemoryUsage();
+	}
+
+	MemTableRep::Iterator* NewIterator() override {
+		return list_->NewIterator();
+	}
+
+private:
+	// 每个entry在哈希桶中对应一个节点，同一个桶中的节点通过next串联
+	// 节点一旦发布就不再修改，读者无需加锁
+	struct Node {
+		const char* entry;
+		Node* next;
+	};
+	typedef std::atomic<Node*> Bucket;
+
+	static Slice UserKey(const char* entry) {
+		uint32_t internal_key_size;
+		const char* p = GetVarint32Ptr(entry, entry + 5, &internal_key_size);
+		return Slice(p, internal_key_size - 8);
+	}
+
+	static uint64_t Tag(const char* entry) {
+		Slice user_key = UserKey(entry);
+		return DecodeFixed64(user_key.data() + user_key.size());
+	}
+
+	Bucket* BucketFor(const Slice& user_key) const {
+		return &buckets_[Hash(user_key.data(), user_key.size(), 0) % bucket_count_];
+	}
+
+	// REQUIRES: external synchronization, as for Insert()
+	void AddToIndex(const char* entry) {
+		Node* n = NewNode(entry);
+		Bucket* bucket = BucketFor(UserKey(entry));
+		n->next = bucket->load(std::memory_order_relaxed);
+		// Release-store so that readers see a fully initialized node
+		bucket->store(n, std::memory_order_release);
+	}
+
+	Node* NewNode(const char* entry) {
+		char* mem = allocator_->AllocateAligned(sizeof(Node));
+		Node* n = reinterpret_cast<Node*>(mem);
+		n->entry = entry;
+		n->next = nullptr;
+		return n;
+	}
+
+	MemTableRep* const list_;
+	Allocator* const allocator_;
+	const size_t bucket_count_;
+	Bucket* buckets_;
+};
+
+}  // namespace
+
+MemTableRep* NewHashIndexRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, size_t bucket_count) {
+	// 哈希索引按字节比较user key，其他比较器下相等的key可能字节不同
+	if (cmp.comparator.user_comparator() != BytewiseComparator()) {
+		return NewSkipListRep(cmp, allocator);
+	}
+	return new HashIndexRep(cmp, allocator, bucket_count);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,167 @@
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <vector>
+
+#include "coding.h"
+#include "hash.h"
+#include "memtablerep.h"
+
+namespace leveldb {
+
+namespace {
+
+class HashSkipListRep : public MemTableRep {
+public:
+	HashSkipListRep(const KeyComparator& cmp, Allocator* allocator,
+		const SliceTransform* prefix_extractor, size_t bucket_count)
+		: cmp_(cmp),
+		allocator_(allocator),
+		prefix_extractor_(prefix_extractor),
+		bucket_count_(bucket_count),
+		buckets_(nullptr) {
+		assert(bucket_count_ > 0);
+		char* mem = allocator_->AllocateAligned(sizeof(Bucket) * bucket_count_);
+		buckets_ = reinterpret_cast<Bucket*>(mem);
+		for (size_t i = 0; i < bucket_count_; i++) {
+			new (&buckets_[i]) Bucket(nullptr);
+		}
+	}
+
+	~HashSkipListRep() override {
+		for (size_t i = 0; i < bucket_count_; i++) {
+			delete buckets_[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	void Insert(const char* entry) override {
+		Bucket* bucket = BucketFor(entry);
+		MemTableRep* list = bucket->load(std::memory_order_relaxed);
+		if (list == nullptr) {
+			list = NewSkipListRep(cmp_, allocator_);
+			// Release-store so that readers see a fully initialized list
+			bucket->store(list, std::memory_order_release);
+		}
+		list->Insert(entry);
+	}
+
+	void InsertConcurrently(const char* entry) override {
+		Bucket* bucket = BucketFor(entry);
+		MemTableRep* list = bucket->load(std::memory_order_acquire);
+		if (list == nullptr) {
+			MemTableRep* fresh = NewSkipListRep(cmp_, allocator_);
+			if (bucket->compare_exchange_strong(list, fresh,
+				std::memory_order_acq_rel, std::memory_order_acquire)) {
+				list = fresh;
+			}
+			else {
+				// Another writer created the list first; list now points to it
+				delete fresh;
+			}
+		}
+		list->InsertConcurrently(entry);
+	}
+
+	const char* Get(const char* key) const override {
+		MemTableRep* list = BucketFor(key)->load(std::memory_order_acquire);
+		return list != nullptr ? list->Get(key) : nullptr;
+	}
+
+	// Copies and sorts every entry, so only suitable for full scans
+	// such as flushing the memtable.
+	MemTableRep::Iterator* NewIterator() override {
+		std::vector<const char*>* entries = new std::vector<const char*>;
+		for (size_t i = 0; i < bucket_count_; i++) {
+			MemTableRep* list = buckets_[i].load(std::memory_order_acquire);
+			if (list == nullptr) {
+				continue;
+			}
+			MemTableRep::Iterator* iter = list->NewIterator();
+			for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+				entries->push_back(iter->key());
+			}
+			delete iter;
+		}
+		const KeyComparator& cmp = cmp_;
+		std::sort(entries->begin(), entries->end(),
+			[&cmp](const char* a, const char* b) { return cmp(a, b) < 0; });
+		return NewSortedVectorIterator(cmp_, entries, true);
+	}
+
+	MemTableRep::Iterator* NewPrefixIterator() override {
+		return new PrefixIterator(this);
+	}
+
+private:
+	typedef std::atomic<MemTableRep*> Bucket;
+
+	// Iterates over the list of the bucket holding the last Seek() target
+	class PrefixIterator : public MemTableRep::Iterator {
+	public:
+		explicit PrefixIterator(const HashSkipListRep* rep)
+			: rep_(rep), iter_(nullptr) {
+		}
+
+		~PrefixIterator() override { delete iter_; }
+
+		bool Valid() const override {
+			return iter_ != nullptr && iter_->Valid();
+		}
+		const char* key() const override { return iter_->key(); }
+		void Next() override { iter_->Next(); }
+		void Prev() override { iter_->Prev(); }
+
+		void Seek(const char* target) override {
+			delete iter_;
+			iter_ = nullptr;
+			MemTableRep* list = rep_->BucketFor(target)->load(std::memory_order_acquire);
+			if (list != nullptr) {
+				iter_ = list->NewIterator();
+				iter_->Seek(target);
+			}
+		}
+
+		void SeekToFirst() override {
+			if (iter_ != nullptr) {
+				iter_->SeekToFirst();
+			}
+		}
+
+		void SeekToLast() override {
+			if (iter_ != nullptr) {
+				iter_->SeekToLast();
+			}
+		}
+
+	private:
+		const HashSkipListRep* const rep_;
+		MemTableRep::Iterator* iter_;
+	};
+
+	// "key" is an entry or a memtable key
+	Bucket* BucketFor(const char* key) const {
+		uint32_t internal_key_size;
+		const char* p = GetVarint32Ptr(key, key + 5, &internal_key_size);
+		Slice prefix(p, internal_key_size - 8);
+		if (prefix_extractor_->InDomain(prefix)) {
+			prefix = prefix_extractor_->Transform(prefix);
+		}
+		return &buckets_[Hash(prefix.data(), prefix.size(), 0) % bucket_count_];
+	}
+
+	const KeyComparator cmp_;
+	Allocator* const allocator_;
+	const SliceTransform* const prefix_extractor_;
+	const size_t bucket_count_;
+	Bucket* buckets_;
+};
+
+}  // namespace
+
+MemTableRep* NewHashSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, const SliceTransform* prefix_extractor,
+	size_t bucket_count) {
+	return new HashSkipListRep(cmp, allocator, prefix_extractor, bucket_count);
+}
+
+}  // namespace leveldb
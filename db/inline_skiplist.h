@@ -0,0 +1,524 @@
+#ifndef STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
+#define STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
+
+// InlineSkipList is a SkipList of variable-length keys that live inside
+// the nodes themselves.  A node is laid out as
+//
+//    next_[height-1] ... next_[1]  next_[0]  key bytes
+//                                  ^ Node*
+//
+// so it needs neither a separate allocation for the key nor a pointer to
+// it, and a search step reads a link and the start of the key from the
+// same cache line.  Towers of tall nodes, which nearly every search walks
+// through, start on a cache line of their own.  The maximum height is
+// chosen by the owner from the number of keys it expects.
+//
+// The caller obtains the memory for a key from AllocateKey(), encodes the
+// key there and passes the same pointer to Insert() or
+// InsertConcurrently().  Keys are compared as "const char*" by
+// Comparator.
+//
+// Thread safety and invariants are the same as for SkipList: Insert()
+// requires external synchronization, InsertConcurrently() may be called
+// by several threads at once, and reads need no locking.
+
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#include "allocator.h"
+#include "random.h"
+
+namespace leveldb {
+
+template <class Comparator>
+class InlineSkipList {
+private:
+	struct Node;
+
+public:
+	// Upper bound for the max_height passed to the constructor
+	enum { kMaxPossibleHeight = 32 };
+
+	// Create a list whose nodes are at most "max_height" levels tall,
+	// allocated from "*allocator", which must outlive the list.
+	// REQUIRES: 1 <= max_height <= kMaxPossibleHeight
+	InlineSkipList(Comparator cmp, Allocator* allocator, int max_height);
+
+	InlineSkipList(const InlineSkipList&) = delete;
+	InlineSkipList& operator=(const InlineSkipList&) = delete;
+
+	// A max_height for a list expected to hold about "expected_entries"
+	// keys: enough levels that the top one still has a handful of nodes.
+	static int MaxHeightFor(size_t expected_entries);
+
+	// Allocate a node for a key of "key_size" bytes and return where the
+	// key goes.  The node belongs to the list but is not part of it until
+	// the returned pointer is passed to Insert() or InsertConcurrently().
+	// Thread-safe if the allocator is.
+	char* AllocateKey(size_t key_size);
+
+	// Insert key, as returned by AllocateKey() and filled in since.
+	// REQUIRES: nothing that compares equal to key is currently in the list.
+	void Insert(const char* key);
+
+	// Like Insert(), but may be called by several threads at once.
+	// REQUIRES: nothing that compares equal to key is currently in the list.
+	// REQUIRES: the allocator supports concurrent allocation.
+	void InsertConcurrently(const char* key);
+
+	// Returns true iff an entry that compares equal to key is in the list.
+	bool Contains(const char* key) const;
+
+	// Iteration over the contents of a list
+	class Iterator {
+	public:
+		// Initialize an iterator over the specified list.
+		// The returned iterator is not valid.
+		explicit Iterator(const InlineSkipList* list);
+
+		// Returns true iff the iterator is positioned at a valid node.
+		bool Valid() const;
+
+		// Returns the key at the current position.
+		// REQUIRES: Valid()
+		const char* key() const;
+
+		// Advances to the next position.
+		// REQUIRES: Valid()
+		void Next();
+
+		// Advances to the previous position.
+		// REQUIRES: Valid()
+		void Prev();
+
+		// Advance to the first entry with a key >= target
+		void Seek(const char* target);
+
+		// Position at the first entry in list.
+		// Final state of iterator is Valid() iff list is not empty.
+		void SeekToFirst();
+
+		// Position at the last entry in list.
+		// Final state of iterator is Valid() iff list is not empty.
+		void SeekToLast();
+
+	private:
+		const InlineSkipList* list_;
+		Node* node_;
+		// Intentionally copyable
+	};
+
+private:
+	// Nodes at least this tall have their tower start on a cache line
+	enum { kMinAlignedHeight = 3 };
+	enum { kCacheLineSize = 64 };
+
+	inline int GetMaxHeight() const {
+		return max_height_.load(std::memory_order_relaxed);
+	}
+
+	Node* NewNode(size_t key_size, int height);
+	int RandomHeight();
+	static Random* ThreadLocalRandom();
+
+	bool Equal(const char* a, const char* b) const { return (compare_(a, b) == 0); }
+
+	// Return true if key is greater than the data stored in "n"
+	bool KeyIsAfterNode(const char* key, Node* n) const;
+
+	// Return the earliest node that comes at or after key.
+	// Return nullptr if there is no such node.
+	//
+	// If prev is non-null, fills prev[level] with pointer to previous
+	// node at "level" for every level in [0..max_height_-1].
+	Node* FindGreaterOrEqual(const char* key, Node** prev) const;
+
+	// Return the latest node with a key < key.
+	// Return head_ if there is no such node.
+	Node* FindLessThan(const char* key) const;
+
+	// Return the last node in the list.
+	// Return head_ if list is empty.
+	Node* FindLast() const;
+
+	// Starting at "before", which must sort before key, walk "level" and
+	// store in *out_prev and *out_next the pair of adjacent nodes that key
+	// would be spliced between.
+	void FindSpliceForLevel(const char* key, Node* before, int level,
+		Node** out_prev, Node** out_next) const;
+
+	// Immutable after construction
+	Comparator const compare_;
+	Allocator* const allocator_;
+	const int kMaxHeight_;
+
+	Node* const head_;
+
+	// Modified only by Insert() and InsertConcurrently().  Read racily by
+	// readers, but stale values are ok.
+	std::atomic<int> max_height_;  // Height of the entire list
+};
+
+// Implementation details follow
+template <class Comparator>
+struct InlineSkipList<Comparator>::Node {
+	// The key stored in this node, right after next_[0]
+	const char* Key() const { return reinterpret_cast<const char*>(&next_[1]); }
+
+	// Between AllocateKey() and Insert() the links are unused, so the
+	// node's height is kept in the storage of next_[0]
+	void StashHeight(int height) {
+		static_assert(sizeof(int) <= sizeof(next_[0]), "height must fit");
+		memcpy(static_cast<void*>(&next_[0]), &height, sizeof(int));
+	}
+	int UnstashHeight() const {
+		int height;
+		memcpy(&height, static_cast<const void*>(&next_[0]), sizeof(int));
+		return height;
+	}
+
+	// Accessors/mutators for links.  Level n is stored n slots below
+	// next_[0].
+	Node* Next(int n) {
+		assert(n >= 0);
+		// Use an 'acquire load' so that we observe a fully initialized
+		// version of the returned Node.
+		return (&next_[0] - n)->load(std::memory_order_acquire);
+	}
+
+	void SetNext(int n, Node* x) {
+		assert(n >= 0);
+		// Use a 'release store' so that anybody who reads through this
+		// pointer observes a fully initialized version of the inserted node.
+		(&next_[0] - n)->store(x, std::memory_order_release);
+	}
+
+	// No-barrier variants that can be safely used in a few locations.
+	Node* NoBarrier_Next(int n) {
+		assert(n >= 0);
+		return (&next_[0] - n)->load(std::memory_order_relaxed);
+	}
+	void NoBarrier_SetNext(int n, Node* x) {
+		assert(n >= 0);
+		(&next_[0] - n)->store(x, std::memory_order_relaxed);
+	}
+
+	// Atomically replace the link at level n with x if it still equals
+	// expected.  Used by InsertConcurrently() to publish x.
+	bool CASNext(int n, Node* expected, Node* x) {
+		assert(n >= 0);
+		return (&next_[0] - n)->compare_exchange_strong(expected, x);
+	}
+
+private:
+	// The lowest level link; the key follows it
+	std::atomic<Node*> next_[1];
+};
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::NewNode(size_t key_size, int height) {
+	const size_t prefix = sizeof(std::atomic<Node*>) * (height - 1);
+	const size_t bytes = prefix + sizeof(Node) + key_size;
+	char* raw;
+	if (height >= kMinAlignedHeight) {
+		// Over-allocate so that the tower can start on a cache line
+		raw = allocator_->AllocateAligned(bytes + kCacheLineSize - 8);
+		const uintptr_t mod = reinterpret_cast<uintptr_t>(raw) & (kCacheLineSize - 1);
+		if (mod != 0) {
+			raw += kCacheLineSize - mod;
+		}
+	}
+	else {
+		raw = allocator_->AllocateAligned(bytes);
+	}
+	Node* x = reinterpret_cast<Node*>(raw + prefix);
+	x->StashHeight(height);
+	return x;
+}
+
+template <class Comparator>
+int InlineSkipList<Comparator>::MaxHeightFor(size_t expected_entries) {
+	// With a branching factor of 4, level h holds about n / 4^(h-1) nodes
+	int height = 1;
+	size_t capacity = 4;
+	while (height < kMaxPossibleHeight && capacity < expected_entries) {
+		height++;
+		capacity *= 4;
+	}
+	return height;
+}
+
+template <class Comparator>
+char* InlineSkipList<Comparator>::AllocateKey(size_t key_size) {
+	return const_cast<char*>(NewNode(key_size, RandomHeight())->Key());
+}
+
+template <class Comparator>
+inline InlineSkipList<Comparator>::Iterator::Iterator(const InlineSkipList* list) {
+	list_ = list;
+	node_ = nullptr;
+}
+
+template <class Comparator>
+inline bool InlineSkipList<Comparator>::Iterator::Valid() const {
+	return node_ != nullptr;
+}
+
+template <class Comparator>
+inline const char* InlineSkipList<Comparator>::Iterator::key() const {
+	assert(Valid());
+	return node_->Key();
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Next() {
+	assert(Valid());
+	node_ = node_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Prev() {
+	// Instead of using explicit "prev" links, we just search for the
+	// last node that falls before key
+	assert(Valid());
+	node_ = list_->FindLessThan(node_->Key());
+	if (node_ == list_->head_) {
+		node_ = nullptr;
+	}
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::Seek(const char* target) {
+	node_ = list_->FindGreaterOrEqual(target, nullptr);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToFirst() {
+	node_ = list_->head_->Next(0);
+}
+
+template <class Comparator>
+inline void InlineSkipList<Comparator>::Iterator::SeekToLast() {
+	node_ = list_->FindLast();
+	if (node_ == list_->head_) {
+		node_ = nullptr;
+	}
+}
+
+template <class Comparator>
+int InlineSkipList<Comparator>::RandomHeight() {
+	// Increase height with probability 1 in kBranching
+	static const unsigned int kBranching = 4;
+	Random* rnd = ThreadLocalRandom();
+	int height = 1;
+	while (height < kMaxHeight_ && ((rnd->Next() % kBranching) == 0)) {
+		height++;
+	}
+	assert(height > 0);
+	assert(height <= kMaxHeight_);
+	return height;
+}
+
+template <class Comparator>
+Random* InlineSkipList<Comparator>::ThreadLocalRandom() {
+	// Seed must stay within [1, 2^31-2], see Random
+	static thread_local Random rnd(static_cast<uint32_t>(
+		std::hash<std::thread::id>()(std::this_thread::get_id()) % 0x7ffffffeu) + 1);
+	return &rnd;
+}
+
+template <class Comparator>
+bool InlineSkipList<Comparator>::KeyIsAfterNode(const char* key, Node* n) const {
+	// null n is considered infinite
+	return (n != nullptr) && (compare_(n->Key(), key) < 0);
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindGreaterOrEqual(const char* key,
+	Node** prev) const {
+	Node* x = head_;
+	int level = GetMaxHeight() - 1;
+	while (true) {
+		Node* next = x->Next(level);
+		if (KeyIsAfterNode(key, next)) {
+			// Keep searching in this list
+			x = next;
+		}
+		else {
+			if (prev != nullptr) prev[level] = x;
+			if (level == 0) {
+				return next;
+			}
+			else {
+				// Switch to next list
+				level--;
+			}
+		}
+	}
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLessThan(const char* key) const {
+	Node* x = head_;
+	int level = GetMaxHeight() - 1;
+	while (true) {
+		assert(x == head_ || compare_(x->Key(), key) < 0);
+		Node* next = x->Next(level);
+		if (next == nullptr || compare_(next->Key(), key) >= 0) {
+			if (level == 0) {
+				return x;
+			}
+			else {
+				// Switch to next list
+				level--;
+			}
+		}
+		else {
+			x = next;
+		}
+	}
+}
+
+template <class Comparator>
+typename InlineSkipList<Comparator>::Node*
+InlineSkipList<Comparator>::FindLast() const {
+	Node* x = head_;
+	int level = GetMaxHeight() - 1;
+	while (true) {
+		Node* next = x->Next(level);
+		if (next == nullptr) {
+			if (level == 0) {
+				return x;
+			}
+			else {
+				// Switch to next list
+				level--;
+			}
+		}
+		else {
+			x = next;
+		}
+	}
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::FindSpliceForLevel(const char* key,
+	Node* before, int level, Node** out_prev, Node** out_next) const {
+	while (true) {
+		Node* next = before->Next(level);
+		if (KeyIsAfterNode(key, next)) {
+			before = next;
+		}
+		else {
+			*out_prev = before;
+			*out_next = next;
+			return;
+		}
+	}
+}
+
+template <class Comparator>
+InlineSkipList<Comparator>::InlineSkipList(Comparator cmp, Allocator* allocator,
+	int max_height)
+	: compare_(cmp),
+	allocator_(allocator),
+	kMaxHeight_(max_height),
+	head_(NewNode(0 /* the head has no key */, max_height)),
+	max_height_(1) {
+	assert(max_height >= 1 && max_height <= kMaxPossibleHeight);
+	for (int i = 0; i < kMaxHeight_; i++) {
+		head_->SetNext(i, nullptr);
+	}
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::Insert(const char* key) {
+	Node* x = reinterpret_cast<Node*>(const_cast<char*>(key)) - 1;
+	const int height = x->UnstashHeight();
+	assert(height >= 1 && height <= kMaxHeight_);
+
+	Node* prev[kMaxPossibleHeight];
+	Node* next = FindGreaterOrEqual(key, prev);
+
+	// Our data structure does not allow duplicate insertion
+	assert(next == nullptr || !Equal(key, next->Key()));
+	(void)next;
+
+	if (height > GetMaxHeight()) {
+		for (int i = GetMaxHeight(); i < height; i++) {
+			prev[i] = head_;
+		}
+		// Readers that see the new height before the links below simply
+		// drop down a level, see SkipList::Insert().
+		max_height_.store(height, std::memory_order_relaxed);
+	}
+
+	for (int i = 0; i < height; i++) {
+		// NoBarrier_SetNext() suffices since we will add a barrier when
+		// we publish a pointer to "x" in prev[i].
+		x->NoBarrier_SetNext(i, prev[i]->NoBarrier_Next(i));
+		prev[i]->SetNext(i, x);
+	}
+}
+
+template <class Comparator>
+void InlineSkipList<Comparator>::InsertConcurrently(const char* key) {
+	Node* x = reinterpret_cast<Node*>(const_cast<char*>(key)) - 1;
+	const int height = x->UnstashHeight();
+	assert(height >= 1 && height <= kMaxHeight_);
+
+	int max_height = GetMaxHeight();
+	while (height > max_height) {
+		if (max_height_.compare_exchange_weak(max_height, height)) {
+			max_height = height;
+			break;
+		}
+	}
+
+	// Compute the splice for every level, top-down, so that each level's
+	// search starts from the node found on the level above.
+	Node* prev[kMaxPossibleHeight];
+	Node* next[kMaxPossibleHeight];
+	Node* before = head_;
+	for (int i = max_height - 1; i >= 0; i--) {
+		FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+		before = prev[i];
+	}
+
+	// Our data structure does not allow duplicate insertion
+	assert(next[0] == nullptr || !Equal(key, next[0]->Key()));
+
+	// Link x in from the bottom up, redoing the splice of a level whose
+	// CAS lost to a concurrent insert, as in SkipList::InsertConcurrently().
+	for (int i = 0; i < height; i++) {
+		while (true) {
+			x->NoBarrier_SetNext(i, next[i]);
+			if (prev[i]->CASNext(i, next[i], x)) {
+				break;
+			}
+			FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+		}
+	}
+}
+
+template <class Comparator>
+bool InlineSkipList<Comparator>::Contains(const char* key) const {
+	Node* x = FindGreaterOrEqual(key, nullptr);
+	if (x != nullptr && Equal(key, x->Key())) {
+		return true;
+	}
+	else {
+		return false;
+	}
+}
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_INLINE_SKIPLIST_H_
@@ -0,0 +1,70 @@
+#include "memtablerep.h"
+
+#include "inline_skiplist.h"
+
+namespace leveldb {
+
+namespace {
+
+// 节点和entry在同一块内存中，entry紧跟在next指针之后
+// 相比SkipListRep，每个entry省去了键指针和前缀，也省去了一次单独的内存分配
+class InlineSkipListRep : public MemTableRep {
+private:
+	typedef InlineSkipList<KeyComparator> Table;
+
+public:
+	InlineSkipListRep(const KeyComparator& cmp, Allocator* allocator,
+		size_t expected_entries)
+		: table_(cmp, allocator, Table::MaxHeightFor(expected_entries)) {
+	}
+
+	char* AllocateEntry(size_t len, Allocator* /*allocator*/) override {
+		return table_.AllocateKey(len);
+	}
+
+	void Insert(const char* entry) override {
+		table_.Insert(entry);
+	}
+
+	void InsertConcurrently(const char* entry) override {
+		table_.InsertConcurrently(entry);
+	}
+
+	const char* Get(const char* key) const override {
+		Table::Iterator iter(&table_);
+		iter.Seek(key);
+		return iter.Valid() ? iter.key() : nullptr;
+	}
+
+	class Iterator : public MemTableRep::Iterator {
+	public:
+		explicit Iterator(const Table* table) : iter_(table) { }
+
+		bool Valid() const override { return iter_.Valid(); }
+		const char* key() const override { return iter_.key(); }
+		void Next() override { iter_.Next(); }
+		void Prev() override { iter_.Prev(); }
+		void Seek(const char* target) override { iter_.Seek(target); }
+		void SeekToFirst() override { iter_.SeekToFirst(); }
+		void SeekToLast() override { iter_.SeekToLast(); }
+
+	private:
+		Table::Iterator iter_;
+	};
+
+	MemTableRep::Iterator* NewIterator() override {
+		return new Iterator(&table_);
+	}
+
+private:
+	Table table_;
+};
+
+}  // namespace
+
+MemTableRep* NewInlineSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, size_t expected_entries) {
+	return new InlineSkipListRep(cmp, allocator, expected_entries);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,191 @@
+#include "inline_skiplist.h"
+
+#include <set>
+
+#include "arena.h"
+#include "coding.h"
+#include "concurrent_arena.h"
+#include "env.h"
+#include "mutexlock.h"
+#include "port.h"
+#include "random.h"
+#include "testharness.h"
+
+namespace leveldb {
+
+// Keys are fixed64 integers stored in the nodes
+struct InlineTestComparator {
+	int operator()(const char* a, const char* b) const {
+		const uint64_t x = DecodeFixed64(a);
+		const uint64_t y = DecodeFixed64(b);
+		if (x < y) {
+			return -1;
+		}
+		else if (x > y) {
+			return +1;
+		}
+		else {
+			return 0;
+		}
+	}
+};
+
+typedef InlineSkipList<InlineTestComparator> TestInlineList;
+
+static const char* AddKey(TestInlineList* list, uint64_t key, bool concurrently) {
+	char* buf = list->AllocateKey(8);
+	EncodeFixed64(buf, key);
+	if (concurrently) {
+		list->InsertConcurrently(buf);
+	}
+	else {
+		list->Insert(buf);
+	}
+	return buf;
+}
+
+static uint64_t KeyOf(const TestInlineList::Iterator& iter) {
+	return DecodeFixed64(iter.key());
+}
+
+class InlineSkipTest {};
+
+TEST(InlineSkipTest, MaxHeightFor) {
+	ASSERT_EQ(1, TestInlineList::MaxHeightFor(0));
+	ASSERT_EQ(1, TestInlineList::MaxHeightFor(4));
+	ASSERT_EQ(2, TestInlineList::MaxHeightFor(5));
+	ASSERT_EQ(9, TestInlineList::MaxHeightFor(1 << 18));
+	ASSERT_EQ(TestInlineList::kMaxPossibleHeight,
+		TestInlineList::MaxHeightFor(~static_cast<size_t>(0)));
+}
+
+TEST(InlineSkipTest, InlineEmptyList) {
+	Arena arena;
+	TestInlineList list(InlineTestComparator(), &arena, 12);
+	char key[8];
+	EncodeFixed64(key, 10);
+	ASSERT_TRUE(!list.Contains(key));
+
+	TestInlineList::Iterator iter(&list);
+	ASSERT_TRUE(!iter.Valid());
+	iter.SeekToFirst();
+	ASSERT_TRUE(!iter.Valid());
+	iter.Seek(key);
+	ASSERT_TRUE(!iter.Valid());
+	iter.SeekToLast();
+	ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(InlineSkipTest, InlineInsertAndLookup) {
+	const int N = 2000;
+	const int R = 5000;
+	Random rnd(1000);
+	std::set<uint64_t> keys;
+	Arena arena;
+	// Sized for far fewer keys than inserted, so searches get longer but
+	// must stay correct
+	TestInlineList list(InlineTestComparator(), &arena,
+		TestInlineList::MaxHeightFor(N / 100));
+	for (int i = 0; i < N; i++) {
+		uint64_t key = rnd.Next() % R;
+		if (keys.insert(key).second) {
+			const char* stored = AddKey(&list, key, false);
+			ASSERT_EQ(key, DecodeFixed64(stored));
+		}
+	}
+
+	char target[8];
+	for (int i = 0; i < R; i++) {
+		EncodeFixed64(target, i);
+		ASSERT_EQ(keys.count(i), list.Contains(target) ? 1 : 0);
+	}
+
+	// Forward iteration
+	for (int i = 0; i < R; i += 7) {
+		TestInlineList::Iterator iter(&list);
+		EncodeFixed64(target, i);
+		iter.Seek(target);
+		std::set<uint64_t>::iterator model_iter = keys.lower_bound(i);
+		for (int j = 0; j < 3; j++) {
+			if (model_iter == keys.end()) {
+				ASSERT_TRUE(!iter.Valid());
+				break;
+			}
+			ASSERT_TRUE(iter.Valid());
+			ASSERT_EQ(*model_iter, KeyOf(iter));
+			++model_iter;
+			iter.Next();
+		}
+	}
+
+	// Backward iteration
+	TestInlineList::Iterator iter(&list);
+	iter.SeekToLast();
+	for (std::set<uint64_t>::reverse_iterator model_iter = keys.rbegin();
+		model_iter != keys.rend(); ++model_iter) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(*model_iter, KeyOf(iter));
+		iter.Prev();
+	}
+	ASSERT_TRUE(!iter.Valid());
+}
+
+namespace {
+
+struct InlineInsertState {
+	TestInlineList* list;
+	int base;  // Keys base, base + kThreads, base + 2 * kThreads, ...
+	port::Mutex* mu;
+	port::CondVar* cv;
+	int* done;
+};
+
+const int kInlineThreads = 4;
+const int kInlineKeysPerThread = 5000;
+
+void InlineInsertThread(void* arg) {
+	InlineInsertState* state = reinterpret_cast<InlineInsertState*>(arg);
+	for (int i = 0; i < kInlineKeysPerThread; i++) {
+		AddKey(state->list, state->base + i * kInlineThreads, true);
+	}
+	MutexLock l(state->mu);
+	(*state->done)++;
+	state->cv->SignalAll();
+}
+
+}  // namespace
+
+TEST(InlineSkipTest, InlineInsertConcurrently) {
+	ConcurrentArena arena;
+	TestInlineList list(InlineTestComparator(), &arena,
+		TestInlineList::MaxHeightFor(kInlineThreads * kInlineKeysPerThread));
+	port::Mutex mu;
+	port::CondVar cv(&mu);
+	int done = 0;
+	InlineInsertState states[kInlineThreads];
+	for (int t = 0; t < kInlineThreads; t++) {
+		states[t].list = &list;
+		states[t].base = t;
+		states[t].mu = &mu;
+		states[t].cv = &cv;
+		states[t].done = &done;
+		Env::Default()->StartThread(InlineInsertThread, &states[t]);
+	}
+	{
+		MutexLock l(&mu);
+		while (done < kInlineThreads) {
+			cv.Wait();
+		}
+	}
+
+	TestInlineList::Iterator iter(&list);
+	iter.SeekToFirst();
+	for (uint64_t i = 0; i < kInlineThreads * kInlineKeysPerThread; i++) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(i, KeyOf(iter));
+		iter.Next();
+	}
+	ASSERT_TRUE(!iter.Valid());
+}
+
+}  // namespace leveldb
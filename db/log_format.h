@@ -15,15 +15,36 @@ enum RecordType {
 	// For fragments
 	kFirstType = 2,
 	kMiddleType = 3,
-	kLastType = 4
+	kLastType = 4,
+
+	// Same as the above, for logs written into recycled files: the header
+	// also holds the number of the log, so that the records left over from
+	// the file's previous use can be told apart from the current ones
+	kRecyclableFullType = 5,
+	kRecyclableFirstType = 6,
+	kRecyclableMiddleType = 7,
+	kRecyclableLastType = 8,
+
+	// Same as kFullType and kFirstType (and their recyclable forms), for a
+	// record whose payload is compressed as a whole before fragmenting.
+	// Its kMiddleType and kLastType fragments are unchanged.
+	kCompressedFullType = 9,
+	kCompressedFirstType = 10,
+	kRecyclableCompressedFullType = 11,
+	kRecyclableCompressedFirstType = 12
 };
-static const int kMaxRecordType = kLastType;
+static const int kMaxRecordType = kRecyclableCompressedFirstType;
 
 static const int kBlockSize = 32768;
 
 // Header is checksum (4 bytes), length (2 bytes), type (1 byte).
 static const int kHeaderSize = 4 + 2 + 1;
 
+// Header of the recyclable types is checksum (4 bytes), length (2 bytes),
+// type (1 byte), log number (4 bytes).  The checksum covers the type, the
+// log number and the payload.
+static const int kRecyclableHeaderSize = 4 + 2 + 1 + 4;
+
 }  // namesapce log
 }  // namespace leveldb
 
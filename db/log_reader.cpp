@@ -4,6 +4,7 @@
 #include "env.h"
 #include "coding.h"
 #include "crc32c.h"
+#include "port.h"
 
 namespace leveldb {
 namespace log {
@@ -11,18 +12,27 @@ namespace log {
 Reader::Reporter::~Reporter() {
 }
 
+static size_t RoundUpToBlock(size_t n) {
+	return n <= kBlockSize ? kBlockSize :
+		(n + kBlockSize - 1) / kBlockSize * kBlockSize;
+}
+
 Reader::Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-	uint64_t initial_offset)
+	uint64_t initial_offset, uint64_t log_number, size_t read_size)
 	: file_(file),
 	reporter_(reporter),
 	checksum_(checksum),
-	backing_store_(new char[kBlockSize]),
+	read_size_(RoundUpToBlock(read_size)),
+	backing_store_(new char[RoundUpToBlock(read_size)]),
 	buffer_(),
+	unparsed_(),
 	eof_(false),
 	last_record_offset_(0),
 	end_of_buffer_offset_(0),
 	initial_offset_(initial_offset),
-	resyncing_(initial_offset > 0) {
+	resyncing_(initial_offset > 0),
+	log_number_(static_cast<uint32_t>(log_number)),
+	recycled_(false) {
 }
 
 Reader::~Reader() {
@@ -71,6 +81,8 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 	record->clear();
 	// 上条记录是否为完整记录
 	bool in_fragmented_record = false;
+	// 正在读取的分段记录是否被压缩
+	bool compressed_record = false;
 	// Record offset of the logical record that we're reading
 	// 0 is a dummy value to make compilers happy
 	// 当前读取记录的偏移量
@@ -78,14 +90,15 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 
 	Slice fragment;
 	while (true) {
-		const unsigned int record_type = ReadPhysicalRecord(&fragment);
+		int header_size = kHeaderSize;
+		const unsigned int record_type = ReadPhysicalRecord(&fragment, &header_size);
 
 		// ReadPhysicalRecord may have only had an empty trailer remaining in its
 		// internal buffer. Calculate the offset of the next physical record now
 		// that it has returned, properly accounting for its header size.
 		// 当前记录的起始地址
 		uint64_t physical_record_offset =
-			end_of_buffer_offset_ - buffer_.size() - kHeaderSize - fragment.size();
+			end_of_buffer_offset_ - buffer_.size() - header_size - fragment.size();
 
 		// resync模式，这种情况下似乎是要跳到一个record的开头
 		// 所以遇到middle的时候继续跳过，遇到last的时候也跳过
@@ -126,7 +139,26 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 			last_record_offset_ = prospective_record_offset;
 			return true;
 
+		case kCompressedFullType:
+			if (in_fragmented_record) {
+				if (scratch->empty()) {
+					in_fragmented_record = false;
+				}
+				else {
+					ReportCorruption(scratch->size(), "partial record without end(1)");
+				}
+			}
+			prospective_record_offset = physical_record_offset;
+			scratch->clear();
+			in_fragmented_record = false;
+			if (Uncompress(fragment, record)) {
+				last_record_offset_ = prospective_record_offset;
+				return true;
+			}
+			break;
+
 		case kFirstType:
+		case kCompressedFirstType:
 			if (in_fragmented_record) {
 				// Handle bug in earlier versions of log::Writer where
 				// it could emit an empty kFirstType record at the tail end
@@ -142,6 +174,7 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 			prospective_record_offset = physical_record_offset;
 			scratch->assign(fragment.data(), fragment.size());
 			in_fragmented_record = true;
+			compressed_record = (record_type == kCompressedFirstType);
 			break;
 
 		case kMiddleType:
@@ -161,13 +194,21 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 			}
 			else {
 				scratch->append(fragment.data(), fragment.size());
-				*record = Slice(*scratch);
+				if (!compressed_record) {
+					*record = Slice(*scratch);
+				}
+				else if (!Uncompress(*scratch, record)) {
+					in_fragmented_record = false;
+					scratch->clear();
+					break;
+				}
 				last_record_offset_ = prospective_record_offset;
 				return true;
 			}
 			break;
 
 		case kEof:
+		case kOldRecord:
 			if (in_fragmented_record) {
 				// This can be caused by the writer dying immediately after
 				// writing a physical record but before completing the next; don't
@@ -198,6 +239,23 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch) {
 	return false;
 }
 
+bool Reader::Uncompress(const Slice& payload, Slice* record) {
+	size_t length;
+	if (!port::Snappy_GetUncompressedLength(payload.data(), payload.size(),
+		&length)) {
+		ReportCorruption(payload.size(), "corrupted compressed record");
+		return false;
+	}
+	uncompressed_.resize(length);
+	if (!port::Snappy_Uncompress(payload.data(), payload.size(),
+		&uncompressed_[0])) {
+		ReportCorruption(payload.size(), "corrupted compressed record");
+		return false;
+	}
+	*record = Slice(uncompressed_);
+	return true;
+}
+
 uint64_t Reader::LastRecordOffset() {
 	return last_record_offset_;
 }
@@ -213,27 +271,32 @@ void Reader::ReportDrop(uint64_t bytes, const Status& reason) {
 	}
 }
 
-unsigned int Reader::ReadPhysicalRecord(Slice* result) {
+unsigned int Reader::ReadPhysicalRecord(Slice* result, int* header_size) {
 	while (true) {
 		if (buffer_.size() < kHeaderSize) {
 			// 因为不是结尾，说明上次读取的是一整个块，现在这个块只剩下补充的0，跳过即可
 			if (!eof_) {
 				// Last read was a full read, so this is a trailer to skip
 				buffer_.clear();
-				// 尽可能多的read一个block size(如果余下的数据够的话)
-				// 把read出来的内容放到buffer_里面
-				Status status = file_->Read(kBlockSize, &buffer_, backing_store_);
-				// end_of_buffer_offset_指向buffer之后的第一个位置
-				end_of_buffer_offset_ += buffer_.size();
-				if (!status.ok()) {
-					buffer_.clear();
-					ReportDrop(kBlockSize, status);
-					eof_ = true;
-					return kEof;
+				if (unparsed_.empty()) {
+					// 一次read read_size_个bytes(如果余下的数据够的话)，放到unparsed_里面
+					Status status = file_->Read(read_size_, &unparsed_, backing_store_);
+					if (!status.ok()) {
+						unparsed_.clear();
+						ReportDrop(kBlockSize, status);
+						eof_ = true;
+						return kEof;
+					}
 				}
-				else if (buffer_.size() < kBlockSize) {
-					// 当前成功read了之后，如果当前能read的size小于一个block size
-					// 则说明已经file已经被read完了
+				// 从unparsed_中取出下一个block
+				const size_t n = unparsed_.size() < kBlockSize ?
+					unparsed_.size() : kBlockSize;
+				buffer_ = Slice(unparsed_.data(), n);
+				unparsed_.remove_prefix(n);
+				// end_of_buffer_offset_指向buffer之后的第一个位置
+				end_of_buffer_offset_ += n;
+				if (n < kBlockSize) {
+					// 不足一个block，说明file已经被read完了
 					eof_ = true;
 				}
 				continue;
@@ -252,12 +315,30 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
 		const char* header = buffer_.data();
 		const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
 		const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
-		const unsigned int type = header[6];
+		unsigned int type = static_cast<unsigned char>(header[6]);
 		const uint32_t length = a | (b << 8);
-		if (kHeaderSize + length > buffer_.size()) {
+		const bool recyclable = (type >= kRecyclableFullType &&
+			type <= kRecyclableLastType) ||
+			type == kRecyclableCompressedFullType ||
+			type == kRecyclableCompressedFirstType;
+		*header_size = recyclable ? kRecyclableHeaderSize : kHeaderSize;
+		if (recyclable && buffer_.size() < kRecyclableHeaderSize) {
+			// 剩余的数据放不下recyclable header，只可能是文件结尾的不完整header
+			// 或者是旧的数据
+			buffer_.clear();
+			if (!eof_ && !recycled_) {
+				ReportCorruption(kRecyclableHeaderSize, "bad record length");
+				return kBadRecord;
+			}
+			return recycled_ ? kOldRecord : kEof;
+		}
+		if (*header_size + length > buffer_.size()) {
 			// 当前record的长度，包括header的长度+数据的长度大于buffer的size
 			size_t drop_size = buffer_.size();
 			buffer_.clear();
+			if (recycled_) {
+				return kOldRecord;
+			}
 			if (!eof_) {
 				ReportCorruption(drop_size, "bad record length");
 				return kBadRecord;
@@ -276,11 +357,22 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
 			return kBadRecord;
 		}
 
+		// 使用recyclable record的log中出现旧格式的record，说明是文件上一次使用留下的
+		if (recycled_ && !recyclable) {
+			buffer_.clear();
+			return kOldRecord;
+		}
+
 		// Check crc
 		if (checksum_) {
 			uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
-			uint32_t actual_crc = crc32c::Value(header + 6, 1 + length);
+			uint32_t actual_crc = crc32c::Value(header + 6,
+				*header_size - 6 + length);
 			if (actual_crc != expected_crc) {
+				if (recycled_) {
+					buffer_.clear();
+					return kOldRecord;
+				}
 				// Drop the rest of the buffer since "length" itself may have
 				// been corrupted and if we trust it, we could find some 
 				// fragment of a real log record that just happens to look
@@ -292,19 +384,34 @@ unsigned int Reader::ReadPhysicalRecord(Slice* result) {
 			}
 		}
 
+		if (recyclable) {
+			// 其他log的record，说明已经读到了本log的结尾
+			if (DecodeFixed32(header + kHeaderSize) != log_number_) {
+				buffer_.clear();
+				return kOldRecord;
+			}
+			recycled_ = true;
+			if (type <= kRecyclableLastType) {
+				type -= kRecyclableFullType - kFullType;
+			}
+			else {
+				type -= kRecyclableCompressedFullType - kCompressedFullType;
+			}
+		}
+
 		// buffer是一块儿长度，当读取结束一条记录时
-		// buffer指向内容的指针向前移动kHeaderSize + length，即下一条记录的起始地址
-		buffer_.remove_prefix(kHeaderSize + length);
+		// buffer指向内容的指针向前移动header_size + length，即下一条记录的起始地址
+		buffer_.remove_prefix(*header_size + length);
 
 		// Skip physical record that started before initial_offset_
-		if (end_of_buffer_offset_ - buffer_.size() - kHeaderSize - length <
+		if (end_of_buffer_offset_ - buffer_.size() - *header_size - length <
 			initial_offset_) {
 			result->clear();
 			return kBadRecord;
 		}
 
 
-		*result = Slice(header + kHeaderSize, length);
+		*result = Slice(header + *header_size, length);
 		return type;
 	}
 }
@@ -2,6 +2,7 @@
 #define STORAGE_LEVELDB_DB_LOG_READER_H_
 
 #include <stdint.h>
+#include <string>
 
 #include "log_format.h"
 #include "status.h"
@@ -37,14 +38,27 @@ public:
 	//
 	// The Reader will start reading at the first record located at physical
 	// position >= initial_offset within the file.
+	//
+	// "log_number" is the number of the log in the file.  It is only
+	// needed for logs written with recyclable records: the log ends at the
+	// first record with another number, which is left over from a previous
+	// use of the file.  Past the first recyclable record, a damaged record
+	// also ends the log instead of being reported, since it may be a stale
+	// record partly overwritten by the current log.
+	//
+	// The file is read "read_size" bytes at a time, rounded up to a
+	// multiple of kBlockSize.  Reads of several megabytes keep fast
+	// devices busy when a large log is scanned, at the cost of a buffer
+	// of that size.
 	Reader(SequentialFile* file, Reporter* reporter, bool checksum,
-		uint64_t initial_offset);
+		uint64_t initial_offset, uint64_t log_number = 0,
+		size_t read_size = kBlockSize);
 
 	~Reader();
 
-	// Read the next record into *record.  Returns true if read
-	// successfully, false if we hit end of the input.  May use
-	// "*scratch" as temporary storage.  The contents filled in *record
+	// Read the next record into *record, decompressed if it was written
+	// compressed.  Returns true if read successfully, false if we hit end
+	// of the input.  May use "*scratch" as temporary storage.  The contents filled in *record
 	// will only be valid until the next mutating operation on this
 	// reader or the next mutation to *scratch.
 	bool ReadRecord(Slice* record, std::string* scratch);
@@ -58,9 +72,11 @@ private:
 	SequentialFile* const file_;
 	Reporter* const reporter_;
 	bool const checksum_;
+	size_t const read_size_;  // A multiple of kBlockSize
 	char* const backing_store_;
-	Slice buffer_;
-	bool eof_;   // Last Read() indicated EOF by returning < kBlockSize
+	Slice buffer_;     // The rest of the current block
+	Slice unparsed_;   // Blocks read after the current one
+	bool eof_;   // The current block is the last one: it has < kBlockSize bytes
 
 	// Offset of the last record returned by ReadRecord.
 	// 被ReadRecord返回的上一个record的offset
@@ -77,6 +93,15 @@ private:
 	// skipped in this mode
 	bool resyncing_;
 
+	// Number of the log, checked against the recyclable records
+	uint32_t const log_number_;
+
+	// True once a recyclable record has been read
+	bool recycled_;
+
+	// Holds the last record returned if it was compressed
+	std::string uncompressed_;
+
 	// Extend record types with the following special values
 	enum {
 		kEof = kMaxRecordType + 1,
@@ -85,7 +110,11 @@ private:
 		// * The record has an invalid CRC (ReadPhysicalRecord reports a drop)
 		// * The record is a 0-length record (No drop is reported)
 		// * The record is below constructor's initial_offset (No drop is reported)
-		kBadRecord = kMaxRecordType + 2
+		kBadRecord = kMaxRecordType + 2,
+		// Returned when we find a record left over from a previous use of a
+		// recycled log file, which marks the end of the log.  (No drop is
+		// reported)
+		kOldRecord = kMaxRecordType + 3
 	};
 
 	// Skips all blocks that are completely before "initial_offset_".
@@ -93,8 +122,15 @@ private:
 	// Returns true on success. Handles reporting.
 	bool SkipToInitialBlock();
 
-	// Return type, or one of the preceding special values
-	unsigned int ReadPhysicalRecord(Slice* result);
+	// Return type, or one of the preceding special values.  Recyclable
+	// types are returned as the corresponding plain types.  Stores the
+	// size of the record's header in *header_size.
+	unsigned int ReadPhysicalRecord(Slice* result, int* header_size);
+
+	// Decompress the payload of a compressed record into uncompressed_
+	// and point *record at it.  Returns false, reporting the drop, if it
+	// is corrupted.
+	bool Uncompress(const Slice& payload, Slice* record);
 
 	// Reports dropped bytes to the reporter.
 	// buffer_ must be updated to remove the dropped bytes prior to invocation.
@@ -0,0 +1,52 @@
+#include "log_recycler.h"
+
+#include "env.h"
+#include "filename.h"
+#include "options.h"
+
+namespace leveldb {
+
+LogFileRecycler::LogFileRecycler(const std::string& dbname,
+	const Options& options)
+	: env_(options.env),
+	dbname_(dbname),
+	recycle_log_file_num_(options.recycle_log_file_num),
+	log_preallocate_size_(options.log_preallocate_size),
+	use_direct_writes_(options.use_direct_writes) {
+}
+
+LogFileRecycler::~LogFileRecycler() {
+}
+
+Status LogFileRecycler::NewLogFile(uint64_t number, WritableFile** result) {
+	const std::string fname = LogFileName(dbname_, number);
+	if (!recyclable_.empty()) {
+		// 复用最旧的文件，它的大小和已分配的块都保留下来，旧的record由log number区分
+		const uint64_t old_number = recyclable_.front();
+		recyclable_.pop_front();
+		return env_->ReuseWritableFile(fname, LogFileName(dbname_, old_number),
+			result);
+	}
+
+	Status s = use_direct_writes_ ? env_->NewDirectWritableFile(fname, result)
+		: env_->NewWritableFile(fname, result);
+	if (s.ok() && log_preallocate_size_ > 0) {
+		s = (*result)->Allocate(0, log_preallocate_size_);
+		if (!s.ok()) {
+			delete *result;
+			*result = NULL;
+			env_->DeleteFile(fname);
+		}
+	}
+	return s;
+}
+
+Status LogFileRecycler::ReleaseLogFile(uint64_t number) {
+	if (recyclable_.size() < recycle_log_file_num_) {
+		recyclable_.push_back(number);
+		return Status::OK();
+	}
+	return env_->DeleteFile(LogFileName(dbname_, number));
+}
+
+}  // namespace leveldb
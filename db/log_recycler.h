@@ -0,0 +1,60 @@
+#ifndef STORAGE_LEVELDB_DB_LOG_RECYCLER_H_
+#define STORAGE_LEVELDB_DB_LOG_RECYCLER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include "status.h"
+
+namespace leveldb {
+
+struct Options;
+
+class Env;
+class WritableFile;
+
+// Hands out the files of the logs of a DB.  A new log reuses the file of
+// an obsolete log if one was kept (see Options::recycle_log_file_num), or
+// gets a new file with space reserved (see Options::log_preallocate_size)
+// that is written with direct I/O if Options::use_direct_writes is set.
+//
+// Not thread-safe: the caller provides external synchronization.
+class LogFileRecycler {
+public:
+	LogFileRecycler(const std::string& dbname, const Options& options);
+	~LogFileRecycler();
+
+	// Whether logs must be written with recyclable records, i.e. by a
+	// log::Writer created with recycle_log_files set to this.  The number
+	// of the log must then be passed to the log::Reader that reads it.
+	bool recycle_log_files() const { return recycle_log_file_num_ > 0; }
+
+	// Number of obsolete log files kept for reuse.
+	size_t num_recyclable() const { return recyclable_.size(); }
+
+	// Open the file of log "number", LogFileName(dbname, number), for
+	// writing.  On success stores it in *result; the caller must delete it.
+	Status NewLogFile(uint64_t number, WritableFile** result);
+
+	// Log "number" is no longer needed.  Its file is kept for reuse if
+	// fewer than recycle_log_file_num are kept, deleted otherwise.
+	// REQUIRES: the file is closed.
+	Status ReleaseLogFile(uint64_t number);
+
+private:
+	Env* const env_;
+	const std::string dbname_;
+	const size_t recycle_log_file_num_;
+	const size_t log_preallocate_size_;
+	const bool use_direct_writes_;
+	std::deque<uint64_t> recyclable_;  // Oldest first
+
+	// No copying allowed
+	LogFileRecycler(const LogFileRecycler&);
+	void operator=(const LogFileRecycler&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_RECYCLER_H_
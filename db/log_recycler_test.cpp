@@ -0,0 +1,95 @@
+#include "log_recycler.h"
+
+#include "env.h"
+#include "filename.h"
+#include "log_reader.h"
+#include "log_writer.h"
+#include "options.h"
+#include "testharness.h"
+
+namespace leveldb {
+
+class LogRecyclerTest {
+public:
+	Env* env_;
+	std::string dbname_;
+	Options options_;
+
+	LogRecyclerTest() : env_(Env::Default()) {
+		ASSERT_OK(env_->GetTestDirectory(&dbname_));
+		dbname_ += "/log_recycler_test";
+		env_->CreateDir(dbname_);
+		options_.recycle_log_file_num = 1;
+		options_.log_preallocate_size = 64 * 1024;
+	}
+
+	void WriteLog(LogFileRecycler* recycler, uint64_t number,
+		const std::string& record, int n) {
+		WritableFile* file;
+		ASSERT_OK(recycler->NewLogFile(number, &file));
+		log::Writer writer(file, number, recycler->recycle_log_files());
+		for (int i = 0; i < n; i++) {
+			ASSERT_OK(writer.AddRecord(record));
+		}
+		ASSERT_OK(file->Close());
+		delete file;
+	}
+
+	int CountRecords(uint64_t number, const std::string& expected) {
+		SequentialFile* file;
+		ASSERT_OK(env_->NewSequentialFile(LogFileName(dbname_, number), &file));
+		log::Reader reader(file, NULL, true/*checksum*/, 0/*initial_offset*/,
+			number);
+		std::string scratch;
+		Slice record;
+		int count = 0;
+		while (reader.ReadRecord(&record, &scratch)) {
+			ASSERT_EQ(expected, record.ToString());
+			count++;
+		}
+		delete file;
+		return count;
+	}
+};
+
+TEST(LogRecyclerTest, ReuseObsoleteLog) {
+	LogFileRecycler recycler(dbname_, options_);
+	ASSERT_TRUE(recycler.recycle_log_files());
+	WriteLog(&recycler, 1, std::string(1000, 'a'), 100);
+	uint64_t old_size;
+	ASSERT_OK(env_->GetFileSize(LogFileName(dbname_, 1), &old_size));
+	ASSERT_OK(recycler.ReleaseLogFile(1));
+	ASSERT_EQ(1, recycler.num_recyclable());
+	ASSERT_TRUE(env_->FileExists(LogFileName(dbname_, 1)));
+
+	// Log 2 takes over the file of log 1 and keeps its size
+	WriteLog(&recycler, 2, "new", 3);
+	ASSERT_EQ(0, recycler.num_recyclable());
+	ASSERT_TRUE(!env_->FileExists(LogFileName(dbname_, 1)));
+	uint64_t size;
+	ASSERT_OK(env_->GetFileSize(LogFileName(dbname_, 2), &size));
+	ASSERT_EQ(old_size, size);
+	ASSERT_EQ(3, CountRecords(2, "new"));
+
+	// Only one obsolete file is kept
+	WriteLog(&recycler, 3, "x", 1);
+	ASSERT_OK(recycler.ReleaseLogFile(2));
+	ASSERT_OK(recycler.ReleaseLogFile(3));
+	ASSERT_EQ(1, recycler.num_recyclable());
+	ASSERT_TRUE(env_->FileExists(LogFileName(dbname_, 2)));
+	ASSERT_TRUE(!env_->FileExists(LogFileName(dbname_, 3)));
+	ASSERT_OK(env_->DeleteFile(LogFileName(dbname_, 2)));
+}
+
+TEST(LogRecyclerTest, NoRecycling) {
+	options_.recycle_log_file_num = 0;
+	LogFileRecycler recycler(dbname_, options_);
+	ASSERT_TRUE(!recycler.recycle_log_files());
+	WriteLog(&recycler, 7, "plain", 10);
+	ASSERT_EQ(10, CountRecords(7, "plain"));
+	ASSERT_OK(recycler.ReleaseLogFile(7));
+	ASSERT_EQ(0, recycler.num_recyclable());
+	ASSERT_TRUE(!env_->FileExists(LogFileName(dbname_, 7)));
+}
+
+}  // namespace leveldb
@@ -0,0 +1,315 @@
+#include "log_replay.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+#include "env.h"
+#include "memtable.h"
+#include "mutexlock.h"
+#include "options.h"
+#include "port.h"
+#include "write_batch.h"
+#include "write_batch_internal.h"
+
+namespace leveldb {
+
+namespace {
+
+// 把一个record解析成batch，entries指向batch中的数据
+Status DecodeRecord(const Slice& record, WriteBatch* batch,
+	std::vector<MemTable::BatchEntry>* entries) {
+	if (record.size() < WriteBatchInternal::kHeader) {
+		return Status::Corruption("log record too small");
+	}
+	WriteBatchInternal::SetContents(batch, record);
+	return WriteBatchInternal::GetEntries(batch, entries);
+}
+
+void ApplyBatch(MemTable* mem, SequenceNumber sequence,
+	const MemTable::BatchEntry* entries, size_t n,
+	SequenceNumber* max_sequence) {
+	if (n == 0) {
+		return;
+	}
+	mem->AddBatch(sequence, entries, n);
+	const SequenceNumber last_sequence = sequence + n - 1;
+	if (last_sequence > *max_sequence) {
+		*max_sequence = last_sequence;
+	}
+}
+
+// 串行回放时使用，paranoid_checks下记住第一个错误以结束回放
+class SerialReporter : public log::Reader::Reporter {
+public:
+	log::Reader::Reporter* target_;
+	bool paranoid_;
+	Status status_;
+
+	void Corruption(size_t bytes, const Status& s) override {
+		if (target_ != NULL) {
+			target_->Corruption(bytes, s);
+		}
+		if (paranoid_ && status_.ok()) {
+			status_ = s;
+		}
+	}
+};
+
+Status ReplaySerial(const Options& options, const std::string& fname,
+	uint64_t log_number, MemTable* mem, log::Reader::Reporter* reporter,
+	SequenceNumber* max_sequence) {
+	SequentialFile* file;
+	Status s = options.env->NewSequentialFile(fname, &file);
+	if (!s.ok()) {
+		return s;
+	}
+	SerialReporter serial_reporter;
+	serial_reporter.target_ = reporter;
+	serial_reporter.paranoid_ = options.paranoid_checks;
+	log::Reader reader(file, &serial_reporter, true/*checksum*/,
+		0/*initial_offset*/, log_number, options.log_read_size);
+	std::string scratch;
+	Slice record;
+	WriteBatch batch;
+	std::vector<MemTable::BatchEntry> entries;
+	while (reader.ReadRecord(&record, &scratch) && serial_reporter.status_.ok()) {
+		entries.clear();
+		Status decode = DecodeRecord(record, &batch, &entries);
+		if (decode.ok()) {
+			ApplyBatch(mem, WriteBatchInternal::Sequence(&batch), entries.data(),
+				entries.size(), max_sequence);
+		}
+		else {
+			serial_reporter.Corruption(record.size(), decode);
+		}
+	}
+	delete file;
+	return serial_reporter.status_;
+}
+
+// 一个解码后的batch，entries在Partition::entries中
+struct DecodedBatch {
+	SequenceNumber sequence;
+	size_t first_entry;
+	size_t num_entries;
+};
+
+// 在第batch_index个batch之前发生的数据丢弃
+struct Drop {
+	size_t batch_index;
+	size_t bytes;
+	Status status;
+};
+
+// log中的一段，包含所有起始位置在[start, end)中的record，由一个工作线程读取和解码
+struct Partition {
+	uint64_t start;
+	uint64_t end;
+	std::deque<WriteBatch> contents;  // deque在push_back时不会移动已有的元素
+	std::vector<MemTable::BatchEntry> entries;
+	std::vector<DecodedBatch> batches;
+	std::vector<Drop> drops;
+	// reader在读到end之前就结束了，说明log在这一段中结束，后面的段都要丢弃
+	bool log_ended;
+	bool done;
+	Status status;  // 打开文件失败时的错误，回放以这个错误结束
+};
+
+class PartitionReporter : public log::Reader::Reporter {
+public:
+	Partition* partition_;
+
+	void Corruption(size_t bytes, const Status& s) override {
+		Drop drop;
+		drop.batch_index = partition_->batches.size();
+		drop.bytes = bytes;
+		drop.status = s;
+		partition_->drops.push_back(drop);
+	}
+};
+
+struct ReplayState {
+	Env* env;
+	const std::string* fname;
+	uint64_t log_number;
+	size_t read_size;
+	std::vector<Partition> partitions;
+
+	port::Mutex mu;
+	port::CondVar cv;
+	size_t next_to_read;   // 下一个要读取的段
+	size_t applied;        // 已经应用到memtable的段数
+	size_t max_in_flight;  // 读取的段最多领先applied这么多
+	bool stop;
+	int running_threads;
+
+	ReplayState() : cv(&mu) { }
+};
+
+void ReadPartition(ReplayState* state, Partition* p) {
+	PartitionReporter reporter;
+	reporter.partition_ = p;
+	p->log_ended = true;
+	SequentialFile* file;
+	Status s = state->env->NewSequentialFile(*state->fname, &file);
+	if (!s.ok()) {
+		p->status = s;
+		return;
+	}
+	// reader从第一个起始于start之后的record开始读，跳过前一段中record的剩余部分
+	log::Reader reader(file, &reporter, true/*checksum*/, p->start,
+		state->log_number, state->read_size);
+	std::string scratch;
+	Slice record;
+	while (reader.ReadRecord(&record, &scratch)) {
+		if (reader.LastRecordOffset() >= p->end) {
+			// 属于下一段的record
+			p->log_ended = false;
+			break;
+		}
+		p->contents.push_back(WriteBatch());
+		WriteBatch* batch = &p->contents.back();
+		DecodedBatch decoded;
+		decoded.first_entry = p->entries.size();
+		s = DecodeRecord(record, batch, &p->entries);
+		if (s.ok()) {
+			decoded.sequence = WriteBatchInternal::Sequence(batch);
+			decoded.num_entries = p->entries.size() - decoded.first_entry;
+			p->batches.push_back(decoded);
+		}
+		else {
+			reporter.Corruption(record.size(), s);
+			p->contents.pop_back();
+		}
+	}
+	delete file;
+}
+
+void ReplayWorker(void* arg) {
+	ReplayState* state = reinterpret_cast<ReplayState*>(arg);
+	MutexLock l(&state->mu);
+	while (true) {
+		while (!state->stop && state->next_to_read < state->partitions.size() &&
+			state->next_to_read >= state->applied + state->max_in_flight) {
+			state->cv.Wait();
+		}
+		if (state->stop || state->next_to_read >= state->partitions.size()) {
+			break;
+		}
+		Partition* p = &state->partitions[state->next_to_read++];
+		state->mu.Unlock();
+		ReadPartition(state, p);
+		state->mu.Lock();
+		p->done = true;
+		state->cv.SignalAll();
+	}
+	state->running_threads--;
+	state->cv.SignalAll();
+}
+
+}  // namespace
+
+Status ReplayLog(const Options& options, const std::string& fname,
+	uint64_t log_number, MemTable* mem, log::Reader::Reporter* reporter,
+	SequenceNumber* max_sequence, uint64_t partition_size) {
+	uint64_t file_size = 0;
+	Status s = options.env->GetFileSize(fname, &file_size);
+	if (!s.ok()) {
+		return s;
+	}
+	// 段的边界要与block对齐，reader才能从段的起点开始重新同步
+	partition_size = (partition_size + log::kBlockSize - 1) / log::kBlockSize *
+		log::kBlockSize;
+	if (partition_size == 0) {
+		partition_size = log::kBlockSize;
+	}
+	const uint64_t num_partitions = (file_size + partition_size - 1) /
+		partition_size;
+	if (options.wal_recovery_threads <= 0 || num_partitions <= 1) {
+		return ReplaySerial(options, fname, log_number, mem, reporter,
+			max_sequence);
+	}
+
+	ReplayState state;
+	state.env = options.env;
+	state.fname = &fname;
+	state.log_number = log_number;
+	// 读取超出段尾的部分只用来找到下一段的第一个record，没有必要读得比段更大
+	state.read_size = static_cast<size_t>(std::min<uint64_t>(
+		options.log_read_size, partition_size));
+	state.partitions.resize(num_partitions);
+	for (uint64_t i = 0; i < num_partitions; i++) {
+		Partition* p = &state.partitions[i];
+		p->start = i * partition_size;
+		p->end = (i + 1 == num_partitions) ? ~static_cast<uint64_t>(0) :
+			(i + 1) * partition_size;
+		p->log_ended = false;
+		p->done = false;
+	}
+	const int num_threads = static_cast<int>(std::min<uint64_t>(
+		options.wal_recovery_threads, num_partitions));
+	state.next_to_read = 0;
+	state.applied = 0;
+	state.max_in_flight = 2 * num_threads;
+	state.stop = false;
+	state.running_threads = num_threads;
+	for (int i = 0; i < num_threads; i++) {
+		options.env->StartThread(&ReplayWorker, &state);
+	}
+
+	// 按顺序应用每一段，同时工作线程读取后面的段
+	for (size_t i = 0; i < state.partitions.size() && s.ok(); i++) {
+		Partition* p = &state.partitions[i];
+		{
+			MutexLock l(&state.mu);
+			while (!p->done) {
+				state.cv.Wait();
+			}
+		}
+		if (!p->status.ok()) {
+			// 与串行回放一样返回I/O错误，而不是当作log在这里结束
+			s = p->status;
+			break;
+		}
+
+		size_t next_drop = 0;
+		for (size_t b = 0; b <= p->batches.size() && s.ok(); b++) {
+			for (; next_drop < p->drops.size() &&
+				p->drops[next_drop].batch_index == b; next_drop++) {
+				const Drop& drop = p->drops[next_drop];
+				if (reporter != NULL) {
+					reporter->Corruption(drop.bytes, drop.status);
+				}
+				if (options.paranoid_checks) {
+					s = drop.status;
+					break;
+				}
+			}
+			if (s.ok() && b < p->batches.size()) {
+				const DecodedBatch& batch = p->batches[b];
+				ApplyBatch(mem, batch.sequence, &p->entries[batch.first_entry],
+					batch.num_entries, max_sequence);
+			}
+		}
+		const bool log_ended = p->log_ended;
+		std::deque<WriteBatch>().swap(p->contents);
+		std::vector<MemTable::BatchEntry>().swap(p->entries);
+
+		MutexLock l(&state.mu);
+		state.applied++;
+		if (log_ended) {
+			break;
+		}
+		state.cv.SignalAll();
+	}
+
+	MutexLock l(&state.mu);
+	state.stop = true;
+	state.cv.SignalAll();
+	while (state.running_threads > 0) {
+		state.cv.Wait();
+	}
+	return s;
+}
+
+}  // namespace leveldb
@@ -0,0 +1,46 @@
+#ifndef STORAGE_LEVELDB_DB_LOG_REPLAY_H_
+#define STORAGE_LEVELDB_DB_LOG_REPLAY_H_
+
+#include <stdint.h>
+#include <string>
+#include "dbformat.h"
+#include "log_format.h"
+#include "log_reader.h"
+#include "status.h"
+
+namespace leveldb {
+
+struct Options;
+
+class MemTable;
+
+// Size of the pieces a log is split into by a parallel ReplayLog()
+static const uint64_t kDefaultLogReplayPartitionSize = 128 * log::kBlockSize;
+
+// Apply the write batches of log "log_number", stored in file "fname",
+// to "*mem" in the order they were written, and store the largest
+// sequence number applied in *max_sequence (left unchanged if none).
+//
+// With options.wal_recovery_threads > 0, the log is split into pieces of
+// "partition_size" bytes, rounded up to a multiple of log::kBlockSize.
+// That many threads read, verify and decode the pieces at once, each
+// starting at the first record that begins in its piece, while the
+// calling thread applies the decoded pieces in order.  At most twice as
+// many pieces as threads are held in memory.  The records applied are
+// the same as with a single log::Reader over the whole file.
+//
+// Dropped data is reported to "*reporter" if non-NULL, from the calling
+// thread.  A corruption close to the end of a piece may be reported
+// twice.  A batch that fails to decode is reported and skipped, or ends
+// the replay with a Corruption error if options.paranoid_checks is set.
+// An error opening the file ends the replay with that error either way.
+//
+// REQUIRES: no concurrent writes to *mem.
+Status ReplayLog(const Options& options, const std::string& fname,
+	uint64_t log_number, MemTable* mem, log::Reader::Reporter* reporter,
+	SequenceNumber* max_sequence,
+	uint64_t partition_size = kDefaultLogReplayPartitionSize);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_REPLAY_H_
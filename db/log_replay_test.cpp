@@ -0,0 +1,226 @@
+#include "log_replay.h"
+
+#include "comparator.h"
+#include "dbformat.h"
+#include "env.h"
+#include "iterator.h"
+#include "log_writer.h"
+#include "memtable.h"
+#include "mutexlock.h"
+#include "options.h"
+#include "random.h"
+#include "testharness.h"
+#include "testutil.h"
+#include "write_batch.h"
+#include "write_batch_internal.h"
+
+namespace leveldb {
+
+class LogReplayTest {
+public:
+	Env* env_;
+	InternalKeyComparator icmp_;
+	Options options_;
+	std::string fname_;
+
+	class CountingReporter : public log::Reader::Reporter {
+	public:
+		size_t dropped_bytes_;
+		int drops_;
+
+		CountingReporter() : dropped_bytes_(0), drops_(0) { }
+		void Corruption(size_t bytes, const Status& status) override {
+			dropped_bytes_ += bytes;
+			drops_++;
+		}
+	};
+
+	LogReplayTest() : env_(Env::Default()), icmp_(BytewiseComparator()) {
+		std::string dir;
+		ASSERT_OK(env_->GetTestDirectory(&dir));
+		fname_ = dir + "/log_replay_test.log";
+	}
+
+	~LogReplayTest() {
+		env_->DeleteFile(fname_);
+	}
+
+	// Write n batches of up to a few entries, some spanning several
+	// blocks, to log "log_number", overwriting the file if "reuse".
+	// Returns the last sequence number written.
+	SequenceNumber WriteLog(uint64_t log_number, int n, int seed, bool reuse) {
+		WritableFile* file;
+		if (reuse) {
+			ASSERT_OK(env_->ReuseWritableFile(fname_, fname_, &file));
+		}
+		else {
+			ASSERT_OK(env_->NewWritableFile(fname_, &file));
+		}
+		log::Writer writer(file, log_number, reuse);
+		Random rnd(seed);
+		SequenceNumber seq = 1;
+		std::string value;
+		for (int i = 0; i < n; i++) {
+			WriteBatch batch;
+			const int entries = 1 + rnd.Uniform(4);
+			for (int e = 0; e < entries; e++) {
+				char key[32];
+				snprintf(key, sizeof(key), "key%06d", rnd.Uniform(5000));
+				const int size = rnd.OneIn(50) ? 40000 + rnd.Uniform(40000) :
+					rnd.Uniform(500);
+				test::RandomString(&rnd, size, &value);
+				if (rnd.OneIn(10)) {
+					batch.Delete(key);
+				}
+				else {
+					batch.Put(key, value);
+				}
+			}
+			WriteBatchInternal::SetSequence(&batch, seq);
+			seq += WriteBatchInternal::Count(&batch);
+			ASSERT_OK(writer.AddRecord(WriteBatchInternal::Contents(&batch)));
+		}
+		ASSERT_OK(file->Close());
+		delete file;
+		return seq - 1;
+	}
+
+	// Replay the log with "threads" threads and return the memtable
+	// contents, one "key -> value" per entry
+	std::string Replay(uint64_t log_number, int threads,
+		SequenceNumber* max_sequence, CountingReporter* reporter = NULL,
+		Status* status = NULL) {
+		Options options = options_;
+		options.wal_recovery_threads = threads;
+		MemTable* mem = new MemTable(icmp_, options);
+		mem->Ref();
+		*max_sequence = 0;
+		Status s = ReplayLog(options, fname_, log_number, mem, reporter,
+			max_sequence, log::kBlockSize);
+		if (status != NULL) {
+			*status = s;
+		}
+		else {
+			ASSERT_OK(s);
+		}
+		std::string contents;
+		Iterator* iter = mem->NewIterator();
+		for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+			contents.append(iter->key().ToString());
+			contents.append(" -> ");
+			contents.append(iter->value().ToString());
+			contents.append("\n");
+		}
+		delete iter;
+		mem->Unref();
+		return contents;
+	}
+
+	void Corrupt(uint64_t offset) {
+		std::string contents;
+		ASSERT_OK(ReadFileToString(env_, fname_, &contents));
+		contents[offset] ^= 0x80;
+		ASSERT_OK(WriteStringToFile(env_, contents, fname_));
+	}
+};
+
+TEST(LogReplayTest, ParallelReplayMatchesSerial) {
+	const SequenceNumber last = WriteLog(1, 2000, 301, false);
+	uint64_t size;
+	ASSERT_OK(env_->GetFileSize(fname_, &size));
+	ASSERT_GT(size, 10 * log::kBlockSize);
+
+	SequenceNumber serial_max;
+	const std::string serial = Replay(1, 0, &serial_max);
+	ASSERT_EQ(last, serial_max);
+	for (int threads = 1; threads <= 4; threads++) {
+		SequenceNumber max;
+		ASSERT_TRUE(serial == Replay(1, threads, &max));
+		ASSERT_EQ(last, max);
+	}
+}
+
+TEST(LogReplayTest, ParallelCorruption) {
+	WriteLog(1, 2000, 301, false);
+	// Break records in the middle of a piece and at the start of another
+	Corrupt(3 * log::kBlockSize + 1000);
+	Corrupt(7 * log::kBlockSize + 2);
+
+	SequenceNumber serial_max;
+	CountingReporter serial_reporter;
+	const std::string serial = Replay(1, 0, &serial_max, &serial_reporter);
+	ASSERT_GT(serial_reporter.drops_, 0);
+	for (int threads = 1; threads <= 4; threads++) {
+		SequenceNumber max;
+		CountingReporter reporter;
+		ASSERT_TRUE(serial == Replay(1, threads, &max, &reporter));
+		ASSERT_EQ(serial_max, max);
+		ASSERT_GE(reporter.drops_, serial_reporter.drops_);
+	}
+
+	// Paranoid checks stop the replay at the first drop
+	options_.paranoid_checks = true;
+	SequenceNumber max;
+	Status s;
+	Replay(1, 2, &max, NULL, &s);
+	ASSERT_TRUE(s.IsCorruption());
+}
+
+namespace {
+
+// Fails the fail_at-th call to NewSequentialFile() (counting from 1)
+class FailingOpenEnv : public EnvWrapper {
+public:
+	int fail_at_;
+	port::Mutex mu_;
+	int opens_;
+
+	FailingOpenEnv(Env* base, int fail_at)
+		: EnvWrapper(base), fail_at_(fail_at), opens_(0) { }
+
+	Status NewSequentialFile(const std::string& f, SequentialFile** r) override {
+		{
+			MutexLock l(&mu_);
+			if (++opens_ == fail_at_) {
+				*r = NULL;
+				return Status::IOError(f, "injected open error");
+			}
+		}
+		return EnvWrapper::NewSequentialFile(f, r);
+	}
+};
+
+}  // namespace
+
+TEST(LogReplayTest, ParallelOpenError) {
+	WriteLog(1, 2000, 301, false);
+	// Neither a failure of the first piece nor a later one is mistaken for
+	// the end of the log, with or without paranoid checks
+	for (int fail_at = 1; fail_at <= 5; fail_at += 4) {
+		for (int paranoid = 0; paranoid < 2; paranoid++) {
+			FailingOpenEnv env(env_, fail_at);
+			options_.env = &env;
+			options_.paranoid_checks = (paranoid != 0);
+			SequenceNumber max;
+			Status s;
+			Replay(1, 2, &max, NULL, &s);
+			ASSERT_TRUE(s.IsIOError());
+		}
+	}
+	options_.env = env_;
+}
+
+TEST(LogReplayTest, ParallelReplayRecycledLog) {
+	// The new log ends in the middle of the old one; the rest of the file
+	// is left over from log 1 and must be ignored
+	WriteLog(1, 2000, 301, false);
+	const SequenceNumber last = WriteLog(2, 500, 302, true);
+	SequenceNumber serial_max;
+	const std::string serial = Replay(2, 0, &serial_max);
+	ASSERT_EQ(last, serial_max);
+	SequenceNumber max;
+	ASSERT_TRUE(serial == Replay(2, 3, &max));
+	ASSERT_EQ(last, max);
+}
+
+}  // namespace leveldb
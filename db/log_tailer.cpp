@@ -0,0 +1,428 @@
+#include "log_tailer.h"
+
+#include <algorithm>
+#include "coding.h"
+#include "crc32c.h"
+#include "env.h"
+#include "filename.h"
+#include "mutexlock.h"
+#include "options.h"
+
+namespace leveldb {
+namespace log {
+
+AppendNotifier::AppendNotifier() : cv_(&mu_), count_(0) {
+}
+
+AppendNotifier::~AppendNotifier() {
+}
+
+void AppendNotifier::Notify() {
+	MutexLock l(&mu_);
+	count_++;
+	cv_.SignalAll();
+}
+
+uint64_t AppendNotifier::Count() {
+	MutexLock l(&mu_);
+	return count_;
+}
+
+uint64_t AppendNotifier::WaitForChange(uint64_t count, uint64_t timeout_micros) {
+	Env* env = Env::Default();
+	const uint64_t deadline = env->NowMicros() + timeout_micros;
+	MutexLock l(&mu_);
+	while (count_ == count) {
+		// 虚假唤醒之后只等待剩余的时间
+		const uint64_t now = env->NowMicros();
+		if (now >= deadline || cv_.TimedWait(deadline - now)) {
+			break;
+		}
+	}
+	return count_;
+}
+
+static bool IsRecyclable(unsigned int type) {
+	return (type >= kRecyclableFullType && type <= kRecyclableLastType) ||
+		type == kRecyclableCompressedFullType ||
+		type == kRecyclableCompressedFirstType;
+}
+
+static size_t RoundUpToBlock(size_t n) {
+	return n <= kBlockSize ? kBlockSize :
+		(n + kBlockSize - 1) / kBlockSize * kBlockSize;
+}
+
+TailingReader::TailingReader(const Options& options, const std::string& dbname,
+	const Position& start, AppendNotifier* notifier,
+	Reader::Reporter* reporter)
+	: env_(options.env),
+	dbname_(dbname),
+	read_size_(RoundUpToBlock(options.log_read_size)),
+	notifier_(notifier),
+	reporter_(reporter),
+	log_number_(start.log_number),
+	file_(NULL),
+	backing_store_(new char[RoundUpToBlock(options.log_read_size)]),
+	buffer_offset_(start.offset),
+	parse_offset_(start.offset),
+	recycled_(false),
+	stale_(false),
+	notify_count_(0) {
+}
+
+TailingReader::~TailingReader() {
+	delete file_;
+	delete[] backing_store_;
+}
+
+Status TailingReader::OpenLog(uint64_t offset) {
+	delete file_;
+	file_ = NULL;
+	buffer_.clear();
+	buffer_offset_ = offset;
+	Status s = env_->NewSequentialFile(LogFileName(dbname_, log_number_), &file_);
+	if (s.ok() && offset > 0) {
+		s = file_->Skip(offset);
+	}
+	if (!s.ok()) {
+		delete file_;
+		file_ = NULL;
+	}
+	return s;
+}
+
+bool TailingReader::ReadMore(Status* status) {
+	Slice fragment;
+	*status = file_->Read(read_size_, &fragment, backing_store_);
+	if (!status->ok() || fragment.empty()) {
+		return false;
+	}
+	buffer_.append(fragment.data(), fragment.size());
+	return true;
+}
+
+uint64_t TailingReader::NextLogNumber() {
+	std::vector<std::string> filenames;
+	if (!env_->GetChildren(dbname_, &filenames).ok()) {
+		return 0;
+	}
+	uint64_t next = 0;
+	uint64_t number;
+	FileType type;
+	for (size_t i = 0; i < filenames.size(); i++) {
+		if (ParseFileName(filenames[i], &number, &type) && type == kLogFile &&
+			number > log_number_ && (next == 0 || number < next)) {
+			next = number;
+		}
+	}
+	return next;
+}
+
+void TailingReader::ReportDrop(size_t bytes, const char* reason) {
+	if (reporter_ != NULL) {
+		reporter_->Corruption(bytes, Status::Corruption(reason));
+	}
+}
+
+TailingReader::ParseResult TailingReader::ParseRecord(bool may_read,
+	Slice* record, Status* status) {
+	// 从parse_offset_开始逐个解析physical record，parse_offset_只在两个
+	// logical record之间前进，所以未写完的record下次会从头重新解析
+	bool in_fragmented_record = false;
+	bool compressed = false;
+	size_t fragmented_bytes = 0;
+	uint64_t pos = parse_offset_;
+	stale_ = false;
+	while (true) {
+		const size_t leftover = kBlockSize - pos % kBlockSize;
+		if (leftover < static_cast<size_t>(
+			recycled_ ? kRecyclableHeaderSize : kHeaderSize)) {
+			// block尾部的填充，可复用格式的填充最长有10个bytes
+			pos += leftover;
+			if (!in_fragmented_record) {
+				parse_offset_ = pos;
+			}
+			continue;
+		}
+
+		const uint64_t end = buffer_offset_ + buffer_.size();
+		const size_t available = pos < end ? end - pos : 0;
+		if (available < kHeaderSize) {
+			if (!may_read || !ReadMore(status)) {
+				return kIncomplete;
+			}
+			continue;
+		}
+
+		const char* header = buffer_.data() + (pos - buffer_offset_);
+		const uint32_t a = static_cast<uint32_t>(header[4]) & 0xff;
+		const uint32_t b = static_cast<uint32_t>(header[5]) & 0xff;
+		unsigned int type = static_cast<unsigned char>(header[6]);
+		const uint32_t length = a | (b << 8);
+		const bool recyclable = IsRecyclable(type);
+		const size_t header_size = recyclable ? kRecyclableHeaderSize : kHeaderSize;
+
+		if (type == kZeroType && length == 0) {
+			if (recycled_ && leftover >= kRecyclableHeaderSize) {
+				// 复用的文件中预分配的空间，还没有写到这里
+				stale_ = true;
+				return kIncomplete;
+			}
+			if (available <= leftover) {
+				// 文件在这个block中结束，先读完再判断
+				if (may_read && ReadMore(status)) {
+					continue;
+				}
+				if (!status->ok() || !may_read) {
+					return kIncomplete;
+				}
+				// direct I/O写入的填充只出现在文件末尾，之后会被覆盖
+				stale_ = true;
+				return kIncomplete;
+			}
+			// 之后还有数据，是block尾部的填充(从头读复用的log时recycled_
+			// 还没有设置)或者预分配的空间，跳到下一个block
+			pos += leftover;
+			if (!in_fragmented_record) {
+				parse_offset_ = pos;
+			}
+			continue;
+		}
+
+		// 复用的log中出现旧格式的record或者超出block的长度，说明是文件
+		// 上一次使用留下的数据
+		if ((recycled_ && !recyclable) || header_size + length > leftover) {
+			if (recycled_) {
+				stale_ = true;
+				return kIncomplete;
+			}
+			ReportDrop(leftover + fragmented_bytes, "bad record length");
+			in_fragmented_record = false;
+			fragmented_bytes = 0;
+			pos += leftover;
+			parse_offset_ = pos;
+			continue;
+		}
+
+		// 文件中的数据都是已经写入的，record不完整只能是还没有写完
+		if (available < header_size + length) {
+			if (!may_read || !ReadMore(status)) {
+				return kIncomplete;
+			}
+			continue;
+		}
+
+		const uint32_t expected_crc = crc32c::Unmask(DecodeFixed32(header));
+		const uint32_t actual_crc = crc32c::Value(header + 6,
+			header_size - 6 + length);
+		if (actual_crc != expected_crc) {
+			if (recycled_) {
+				stale_ = true;
+				return kIncomplete;
+			}
+			// length本身也可能是损坏的，丢弃block中剩下的数据
+			ReportDrop(leftover + fragmented_bytes, "checksum mismatch");
+			in_fragmented_record = false;
+			fragmented_bytes = 0;
+			pos += leftover;
+			parse_offset_ = pos;
+			continue;
+		}
+
+		if (recyclable) {
+			if (DecodeFixed32(header + kHeaderSize) !=
+				static_cast<uint32_t>(log_number_)) {
+				// 其他log的record，本log还没有写到这里
+				stale_ = true;
+				return kIncomplete;
+			}
+			recycled_ = true;
+			if (type <= kRecyclableLastType) {
+				type -= kRecyclableFullType - kFullType;
+			}
+			else {
+				type -= kRecyclableCompressedFullType - kCompressedFullType;
+			}
+		}
+
+		const uint64_t payload_offset = pos + header_size;
+		const uint64_t next = payload_offset + length;
+		switch (type) {
+		case kFullType:
+		case kCompressedFullType:
+			if (in_fragmented_record) {
+				ReportDrop(fragmented_bytes, "partial record without end(1)");
+			}
+			parse_offset_ = next;
+			if (type == kFullType) {
+				// 只有一个fragment的record直接指向buffer_，不需要拷贝
+				*record = Slice(header + header_size, length);
+				return kRecord;
+			}
+			fragments_.clear();
+			fragments_.push_back(std::make_pair(payload_offset, length));
+			compressed = true;
+			break;
+
+		case kFirstType:
+		case kCompressedFirstType:
+			if (in_fragmented_record) {
+				ReportDrop(fragmented_bytes, "partial record without end(2)");
+			}
+			// 直到record完整之前都从这个fragment开始解析
+			parse_offset_ = pos;
+			in_fragmented_record = true;
+			compressed = (type == kCompressedFirstType);
+			fragments_.clear();
+			fragments_.push_back(std::make_pair(payload_offset, length));
+			fragmented_bytes = length;
+			pos = next;
+			continue;
+
+		case kMiddleType:
+			if (!in_fragmented_record) {
+				ReportDrop(length, "missing start of fragmented record(1)");
+				parse_offset_ = next;
+			}
+			else {
+				fragments_.push_back(std::make_pair(payload_offset, length));
+				fragmented_bytes += length;
+			}
+			pos = next;
+			continue;
+
+		case kLastType:
+			if (!in_fragmented_record) {
+				ReportDrop(length, "missing start of fragmented record(2)");
+				parse_offset_ = next;
+				pos = next;
+				continue;
+			}
+			fragments_.push_back(std::make_pair(payload_offset, length));
+			parse_offset_ = next;
+			break;
+
+		default:
+			ReportDrop(length + fragmented_bytes, "unknown record type");
+			in_fragmented_record = false;
+			fragmented_bytes = 0;
+			parse_offset_ = next;
+			pos = next;
+			continue;
+		}
+
+		// 拼接各个fragment，需要时再解压
+		in_fragmented_record = false;
+		fragmented_bytes = 0;
+		assembled_.push_back(std::string());
+		std::string* contents = &assembled_.back();
+		for (size_t i = 0; i < fragments_.size(); i++) {
+			contents->append(buffer_.data() + (fragments_[i].first - buffer_offset_),
+				fragments_[i].second);
+		}
+		if (compressed) {
+			std::string uncompressed;
+			size_t n;
+			if (!port::Snappy_GetUncompressedLength(contents->data(),
+				contents->size(), &n)) {
+				ReportDrop(contents->size(), "corrupted compressed record");
+				assembled_.pop_back();
+				pos = next;
+				continue;
+			}
+			uncompressed.resize(n);
+			if (!port::Snappy_Uncompress(contents->data(), contents->size(),
+				&uncompressed[0])) {
+				ReportDrop(contents->size(), "corrupted compressed record");
+				assembled_.pop_back();
+				pos = next;
+				continue;
+			}
+			contents->swap(uncompressed);
+		}
+		*record = Slice(*contents);
+		return kRecord;
+	}
+}
+
+Status TailingReader::ReadBatch(std::vector<Slice>* records, size_t max_bytes) {
+	if (notifier_ != NULL) {
+		// 在读文件之前取得计数，之后的写入一定会唤醒WaitForAppend()
+		notify_count_ = notifier_->Count();
+	}
+
+	// 丢弃已经返回过的数据
+	assembled_.clear();
+	if (parse_offset_ > buffer_offset_) {
+		const size_t consumed = static_cast<size_t>(std::min<uint64_t>(
+			parse_offset_ - buffer_offset_, buffer_.size()));
+		buffer_.erase(0, consumed);
+		buffer_offset_ += consumed;
+	}
+
+	Status s;
+	if (file_ == NULL) {
+		s = OpenLog(buffer_offset_);
+		if (!s.ok()) {
+			return s;
+		}
+	}
+
+	const size_t old_size = records->size();
+	size_t bytes = 0;
+	bool retried = false;
+	while (bytes < max_bytes) {
+		// 读文件会使buffer_中的数据移动，所以只有还没有返回record时才读
+		const bool may_read = (records->size() == old_size);
+		Slice record;
+		if (ParseRecord(may_read, &record, &s) == kRecord) {
+			records->push_back(record);
+			bytes += record.size();
+			continue;
+		}
+		if (!s.ok() || !may_read) {
+			break;
+		}
+
+		if (stale_) {
+			// 已经读入的旧数据之后可能被覆盖，重新打开文件以便再次读取
+			s = OpenLog(parse_offset_);
+			if (!s.ok()) {
+				break;
+			}
+		}
+
+		// 当前log中没有更多的record了，看看是否已经开始写新的log
+		const uint64_t next = NextLogNumber();
+		if (next == 0) {
+			break;
+		}
+		if (!retried) {
+			// 新log出现之前当前log已经写完，再读一次以免漏掉最后写入的record
+			retried = true;
+			continue;
+		}
+		log_number_ = next;
+		parse_offset_ = 0;
+		recycled_ = false;
+		retried = false;
+		s = OpenLog(0);
+		if (!s.ok()) {
+			break;
+		}
+	}
+	return s;
+}
+
+void TailingReader::WaitForAppend(uint64_t timeout_micros) {
+	if (notifier_ != NULL) {
+		notifier_->WaitForChange(notify_count_, timeout_micros);
+	}
+	else {
+		env_->SleepForMicroseconds(static_cast<int>(timeout_micros));
+	}
+}
+
+}  // namespace log
+}  // namespace leveldb
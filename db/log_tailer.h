@@ -0,0 +1,156 @@
+#ifndef STORAGE_LEVELDB_DB_LOG_TAILER_H_
+#define STORAGE_LEVELDB_DB_LOG_TAILER_H_
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <utility>
+#include <vector>
+#include "log_format.h"
+#include "log_reader.h"
+#include "port.h"
+#include "slice.h"
+#include "status.h"
+
+namespace leveldb {
+
+struct Options;
+
+class Env;
+class SequentialFile;
+
+namespace log {
+
+// Wakes up the TailingReaders waiting for logs to grow.  The log::Writers
+// of a DB share one (see Writer::SetAppendNotifier()) with the readers
+// tailing its logs, so that readers block instead of polling the files.
+//
+// Thread-safe.
+class AppendNotifier {
+public:
+	AppendNotifier();
+	~AppendNotifier();
+
+	// Called after data was appended to a log.
+	void Notify();
+
+	// Number of calls to Notify() so far.
+	uint64_t Count();
+
+	// Wait until Count() differs from "count", or for at most
+	// "timeout_micros".  Returns Count().
+	uint64_t WaitForChange(uint64_t count, uint64_t timeout_micros);
+
+private:
+	port::Mutex mu_;
+	port::CondVar cv_;
+	uint64_t count_;
+
+	// No copying allowed
+	AppendNotifier(const AppendNotifier&);
+	void operator=(const AppendNotifier&);
+};
+
+// Reads the records of the logs of a DB while they are being written,
+// for consumers that replicate or capture changes.  Unlike Reader, the
+// end of the file is not the end of the log: a record that is only partly
+// written is read once it is complete, and when a log with a larger
+// number appears the reader moves on to it.
+//
+// Not thread-safe: the caller provides external synchronization.
+class TailingReader {
+public:
+	// Position of a record: the number of its log and its physical offset
+	// in the file.
+	struct Position {
+		uint64_t log_number;
+		uint64_t offset;
+
+		Position() : log_number(0), offset(0) { }
+		Position(uint64_t number, uint64_t off) : log_number(number), offset(off) { }
+	};
+
+	// Create a reader for the logs of "dbname" that starts with the record
+	// at "start", which must be 0 or a value returned by position().
+	// Logs must be written with recyclable records if files are recycled
+	// (see Options::recycle_log_file_num).  Records are read from the
+	// files options.log_read_size bytes at a time.
+	//
+	// "notifier" and "reporter" may be NULL.  Without a notifier,
+	// WaitForAppend() just sleeps.  Dropped data is reported to
+	// "*reporter" as by Reader.  The DB must keep the logs the reader has
+	// not finished yet.
+	TailingReader(const Options& options, const std::string& dbname,
+		const Position& start, AppendNotifier* notifier,
+		Reader::Reporter* reporter);
+
+	~TailingReader();
+
+	// Append to *records the complete records that follow position(), up
+	// to about "max_bytes" of them but at least one if any is available,
+	// and advance position() past them.  Returns OK with no records added
+	// if there is no complete record yet.  Records of the next log are
+	// only returned by a call that finds no more records in the current
+	// one, so position() never skips a log.
+	//
+	// Records held in a single fragment point into the read buffer, the
+	// others are assembled (and decompressed) in internal storage.  Both
+	// stay valid until the next call to ReadBatch().
+	Status ReadBatch(std::vector<Slice>* records, size_t max_bytes);
+
+	// Block until a log may have grown since the last ReadBatch() call,
+	// or for at most "timeout_micros".
+	void WaitForAppend(uint64_t timeout_micros);
+
+	// Position of the next record to read.
+	Position position() const { return Position(log_number_, parse_offset_); }
+
+private:
+	enum ParseResult {
+		kRecord,      // A complete record was parsed
+		kIncomplete   // The next record is not completely written yet
+	};
+
+	Env* const env_;
+	const std::string dbname_;
+	const size_t read_size_;
+	AppendNotifier* const notifier_;
+	Reader::Reporter* const reporter_;
+
+	uint64_t log_number_;
+	SequentialFile* file_;  // Positioned at buffer_offset_ + buffer_.size()
+	char* const backing_store_;  // read_size_ bytes for SequentialFile::Read()
+	std::string buffer_;    // Data read from file_
+	uint64_t buffer_offset_;  // File offset of buffer_[0]
+	uint64_t parse_offset_;   // File offset of the next record
+	bool recycled_;  // A recyclable record of log_number_ has been read
+	bool stale_;     // The last ParseRecord() stopped at stale data
+	uint64_t notify_count_;  // notifier_->Count() at the last ReadBatch()
+	std::deque<std::string> assembled_;  // Records that span fragments
+	std::vector<std::pair<uint64_t, size_t> > fragments_;  // Offset, length
+
+	// Open the file of log_number_ positioned at "offset".
+	Status OpenLog(uint64_t offset);
+
+	// Append more of the file to buffer_.  Returns false if there is no
+	// more data yet or an error was stored in *status.
+	bool ReadMore(Status* status);
+
+	// Parse the next record from buffer_, reading more of the file if
+	// "may_read" (which invalidates the records returned so far).
+	ParseResult ParseRecord(bool may_read, Slice* record, Status* status);
+
+	// Number of a log newer than log_number_, or 0 if there is none.
+	uint64_t NextLogNumber();
+
+	void ReportDrop(size_t bytes, const char* reason);
+
+	// No copying allowed
+	TailingReader(const TailingReader&);
+	void operator=(const TailingReader&);
+};
+
+}  // namespace log
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_LOG_TAILER_H_
@@ -0,0 +1,350 @@
+#include "log_tailer.h"
+
+#include "env.h"
+#include "filename.h"
+#include "log_writer.h"
+#include "mutexlock.h"
+#include "options.h"
+#include "testharness.h"
+
+namespace leveldb {
+namespace log {
+
+// Construct a string of the specified length made out of the supplied
+// partial string.
+static std::string TailBigString(const std::string& partial_string, size_t n) {
+	std::string result;
+	while (result.size() < n) {
+		result.append(partial_string);
+	}
+	result.resize(n);
+	return result;
+}
+
+// Records of assorted sizes, some of which span blocks
+static std::string TailRecord(int i) {
+	char buf[20];
+	snprintf(buf, sizeof(buf), "%d.", i);
+	return TailBigString(buf, (i % 7 == 3) ? 3 * kBlockSize / 2 : 10 + i % 300);
+}
+
+class LogTailerTest {
+public:
+	Env* env_;
+	std::string dbname_;
+	Options options_;
+
+	LogTailerTest() : env_(Env::Default()) {
+		ASSERT_OK(env_->GetTestDirectory(&dbname_));
+		dbname_ += "/log_tailer_test";
+		env_->CreateDir(dbname_);
+		std::vector<std::string> filenames;
+		ASSERT_OK(env_->GetChildren(dbname_, &filenames));
+		for (size_t i = 0; i < filenames.size(); i++) {
+			env_->DeleteFile(dbname_ + "/" + filenames[i]);
+		}
+		options_.log_read_size = kBlockSize;
+	}
+
+	WritableFile* NewLog(uint64_t number) {
+		WritableFile* file;
+		ASSERT_OK(env_->NewWritableFile(LogFileName(dbname_, number), &file));
+		return file;
+	}
+
+	// Read up to "n" records, waiting for at most "timeout_micros" between
+	// appends
+	std::vector<std::string> Tail(TailingReader* reader, size_t n,
+		uint64_t timeout_micros) {
+		std::vector<std::string> result;
+		while (result.size() < n) {
+			std::vector<Slice> records;
+			ASSERT_OK(reader->ReadBatch(&records, 4096));
+			for (size_t i = 0; i < records.size(); i++) {
+				result.push_back(records[i].ToString());
+			}
+			if (records.empty()) {
+				if (timeout_micros == 0) {
+					break;
+				}
+				reader->WaitForAppend(timeout_micros);
+			}
+		}
+		return result;
+	}
+};
+
+namespace {
+
+struct TailWriterState {
+	WritableFile* file;
+	AppendNotifier* notifier;
+	int n;
+	port::Mutex mu;
+	port::CondVar cv;
+	bool done;
+
+	TailWriterState() : cv(&mu), done(false) { }
+};
+
+void TailWriterThread(void* arg) {
+	TailWriterState* state = reinterpret_cast<TailWriterState*>(arg);
+	Writer writer(state->file);
+	writer.SetAppendNotifier(state->notifier);
+	for (int i = 0; i < state->n; i++) {
+		ASSERT_OK(writer.AddRecord(TailRecord(i)));
+		if (i % 50 == 0) {
+			Env::Default()->SleepForMicroseconds(1000);
+		}
+	}
+	MutexLock l(&state->mu);
+	state->done = true;
+	state->cv.SignalAll();
+}
+
+}  // namespace
+
+TEST(LogTailerTest, TailWhileWriting) {
+	AppendNotifier notifier;
+	TailWriterState state;
+	state.file = NewLog(1);
+	state.notifier = &notifier;
+	state.n = 500;
+	TailingReader reader(options_, dbname_, TailingReader::Position(1, 0),
+		&notifier, NULL);
+	Env::Default()->StartThread(TailWriterThread, &state);
+
+	std::vector<std::string> records = Tail(&reader, state.n, 10000000);
+	ASSERT_EQ(state.n, records.size());
+	for (int i = 0; i < state.n; i++) {
+		ASSERT_EQ(TailRecord(i), records[i]);
+	}
+	{
+		MutexLock l(&state.mu);
+		while (!state.done) {
+			state.cv.Wait();
+		}
+	}
+	ASSERT_OK(state.file->Close());
+	delete state.file;
+}
+
+TEST(LogTailerTest, TailResumeFromPosition) {
+	WritableFile* file = NewLog(4);
+	Writer writer(file);
+	for (int i = 0; i < 20; i++) {
+		ASSERT_OK(writer.AddRecord(TailRecord(i)));
+	}
+
+	TailingReader::Position position;
+	{
+		TailingReader reader(options_, dbname_, TailingReader::Position(4, 0),
+			NULL, NULL);
+		// Tiny batches return one record each
+		for (int i = 0; i < 8; i++) {
+			std::vector<Slice> records;
+			ASSERT_OK(reader.ReadBatch(&records, 1));
+			ASSERT_EQ(1, records.size());
+			ASSERT_EQ(TailRecord(i), records[0].ToString());
+		}
+		position = reader.position();
+	}
+	ASSERT_EQ(4, position.log_number);
+	TailingReader reader(options_, dbname_, position, NULL, NULL);
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(12, records.size());
+	for (int i = 0; i < 12; i++) {
+		ASSERT_EQ(TailRecord(8 + i), records[i]);
+	}
+	ASSERT_OK(file->Close());
+	delete file;
+}
+
+TEST(LogTailerTest, TailMovesToNextLog) {
+	WritableFile* file = NewLog(3);
+	Writer writer(file);
+	ASSERT_OK(writer.AddRecord("three.a"));
+	ASSERT_OK(writer.AddRecord("three.b"));
+
+	TailingReader reader(options_, dbname_, TailingReader::Position(3, 0),
+		NULL, NULL);
+	ASSERT_EQ(2, Tail(&reader, 100, 0).size());
+
+	// The last record of log 3 is written after the reader caught up, but
+	// it is still read before the records of log 5
+	WritableFile* next_file = NewLog(5);
+	Writer next_writer(next_file);
+	ASSERT_OK(writer.AddRecord("three.c"));
+	ASSERT_OK(next_writer.AddRecord("five.a"));
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(2, records.size());
+	ASSERT_EQ("three.c", records[0]);
+	ASSERT_EQ("five.a", records[1]);
+	ASSERT_EQ(5, reader.position().log_number);
+
+	ASSERT_OK(file->Close());
+	ASSERT_OK(next_file->Close());
+	delete file;
+	delete next_file;
+}
+
+TEST(LogTailerTest, TailPartialRecord) {
+	// Write the log elsewhere first to hand it to the file in pieces
+	const std::string big = TailRecord(3);
+	const std::string fname = dbname_ + "/partial.tmp";
+	std::string contents;
+	{
+		WritableFile* tmp;
+		ASSERT_OK(env_->NewWritableFile(fname, &tmp));
+		Writer writer(tmp);
+		ASSERT_OK(writer.AddRecord("small"));
+		ASSERT_OK(writer.AddRecord(big));
+		ASSERT_OK(tmp->Close());
+		delete tmp;
+		ASSERT_OK(ReadFileToString(env_, fname, &contents));
+	}
+
+	WritableFile* file = NewLog(2);
+	TailingReader reader(options_, dbname_, TailingReader::Position(2, 0),
+		NULL, NULL);
+	// Header of the first record only
+	ASSERT_OK(file->Append(Slice(contents.data(), 4)));
+	ASSERT_OK(file->Flush());
+	ASSERT_EQ(0, Tail(&reader, 100, 0).size());
+
+	// The first record and most of the big one
+	const size_t split = contents.size() - 100;
+	ASSERT_OK(file->Append(Slice(contents.data() + 4, split - 4)));
+	ASSERT_OK(file->Flush());
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ("small", records[0]);
+	ASSERT_EQ(0, Tail(&reader, 100, 0).size());
+
+	ASSERT_OK(file->Append(Slice(contents.data() + split, 100)));
+	ASSERT_OK(file->Flush());
+	records = Tail(&reader, 100, 0);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ(big, records[0]);
+	ASSERT_EQ(contents.size(), reader.position().offset);
+
+	ASSERT_OK(file->Close());
+	delete file;
+}
+
+TEST(LogTailerTest, TailDirectLog) {
+	// Each flush of a direct file pads its last block with zeros, which the
+	// next records overwrite
+	WritableFile* file;
+	ASSERT_OK(env_->NewDirectWritableFile(LogFileName(dbname_, 6), &file));
+	Writer writer(file);
+	TailingReader reader(options_, dbname_, TailingReader::Position(6, 0),
+		NULL, NULL);
+	for (int i = 0; i < 30; i++) {
+		ASSERT_OK(writer.AddRecord(TailRecord(i)));
+		std::vector<std::string> records = Tail(&reader, 100, 0);
+		ASSERT_EQ(1, records.size());
+		ASSERT_EQ(TailRecord(i), records[0]);
+	}
+	ASSERT_OK(file->Close());
+	delete file;
+}
+
+TEST(LogTailerTest, TailRecycledLog) {
+	WritableFile* file = NewLog(7);
+	{
+		Writer writer(file, 7, true);
+		for (int i = 0; i < 50; i++) {
+			ASSERT_OK(writer.AddRecord(TailRecord(i)));
+		}
+		ASSERT_OK(file->Close());
+		delete file;
+	}
+
+	// Log 9 overwrites the start of the file of log 7
+	ASSERT_OK(env_->ReuseWritableFile(LogFileName(dbname_, 9),
+		LogFileName(dbname_, 7), &file));
+	Writer writer(file, 9, true);
+	ASSERT_OK(writer.AddRecord("nine.a"));
+	ASSERT_OK(writer.AddRecord("nine.b"));
+
+	TailingReader reader(options_, dbname_, TailingReader::Position(9, 0),
+		NULL, NULL);
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(2, records.size());
+	ASSERT_EQ("nine.b", records[1]);
+
+	// Records written over the stale ones are read once they are there
+	ASSERT_OK(writer.AddRecord("nine.c"));
+	records = Tail(&reader, 100, 0);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ("nine.c", records[0]);
+
+	ASSERT_OK(file->Close());
+	delete file;
+}
+
+TEST(LogTailerTest, TailRecycledLogTrailer) {
+	// The first record leaves 8 bytes in its block: too few for a
+	// recyclable header, so the writer fills them with zeros
+	const std::string first = TailBigString("first.",
+		kBlockSize - kRecyclableHeaderSize - 8);
+	WritableFile* file = NewLog(8);
+	Writer writer(file, 8, true);
+	ASSERT_OK(writer.AddRecord(first));
+
+	TailingReader reader(options_, dbname_, TailingReader::Position(8, 0),
+		NULL, NULL);
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ(first, records[0]);
+
+	ASSERT_OK(writer.AddRecord("eight.b"));
+	records = Tail(&reader, 100, 0);
+	ASSERT_EQ(1, records.size());
+	ASSERT_EQ("eight.b", records[0]);
+
+	// A reader that starts at the trailer has not seen a recyclable
+	// record yet, and a newer log must not make it skip the rest of log 8
+	ASSERT_OK(writer.AddRecord("eight.c"));
+	WritableFile* next_file = NewLog(10);
+	Writer next_writer(next_file, 10, true);
+	ASSERT_OK(next_writer.AddRecord("ten.a"));
+	TailingReader resumed(options_, dbname_,
+		TailingReader::Position(8, kBlockSize - 8), NULL, NULL);
+	records = Tail(&resumed, 100, 0);
+	ASSERT_EQ(3, records.size());
+	ASSERT_EQ("eight.b", records[0]);
+	ASSERT_EQ("eight.c", records[1]);
+	ASSERT_EQ("ten.a", records[2]);
+
+	ASSERT_OK(file->Close());
+	ASSERT_OK(next_file->Close());
+	delete file;
+	delete next_file;
+}
+
+TEST(LogTailerTest, TailSkipsZeroedBlock) {
+	// Zeros followed by more data are not padding that will be overwritten:
+	// as for Reader, the rest of the block is skipped
+	WritableFile* file = NewLog(11);
+	Writer writer(file);
+	ASSERT_OK(writer.AddRecord("eleven.a"));
+	ASSERT_OK(file->Append(std::string(kBlockSize - kHeaderSize - 8, '\0')));
+	Writer next_block_writer(file, kBlockSize);
+	ASSERT_OK(next_block_writer.AddRecord("eleven.b"));
+	ASSERT_OK(file->Flush());
+
+	TailingReader reader(options_, dbname_, TailingReader::Position(11, 0),
+		NULL, NULL);
+	std::vector<std::string> records = Tail(&reader, 100, 0);
+	ASSERT_EQ(2, records.size());
+	ASSERT_EQ("eleven.a", records[0]);
+	ASSERT_EQ("eleven.b", records[1]);
+
+	ASSERT_OK(file->Close());
+	delete file;
+}
+
+}  // namespace log
+}  // namespace leveldb
@@ -1,11 +1,18 @@
 ﻿#include "log_reader.h"
 #include "log_writer.h"
+#include "group_commit_writer.h"
 #include "env.h"
 #include "coding.h"
 #include "crc32c.h"
+#include "mutexlock.h"
+#include "port.h"
 #include "random.h"
 #include "testharness.h"
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
 #include <iostream>
+#include <set>
 
 namespace leveldb {
 namespace log {
@@ -28,6 +35,12 @@ static std::string NumberString(int n) {
 	return std::string(buf);
 }
 
+static bool SnappyCompressionSupported() {
+	std::string out;
+	Slice in = "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa";
+	return port::Snappy_Compress(in.data(), in.size(), &out);
+}
+
 // Return a skewed potentially long string
 static std::string RandomSkewedString(int i, Random* rnd) {
 	return BigString(NumberString(i), rnd->Skewed(17));
@@ -40,11 +53,29 @@ private:
 	public:
 		std::string contents_;
 
+		int syncs_;
+
+		// 复用文件时从头开始覆盖，超出旧内容的部分才追加
+		size_t write_offset_;
+
+		StringDest() : syncs_(0), write_offset_(std::string::npos) { }
+
 		virtual Status Close() { return Status::OK(); }
 		virtual Status Flush() { return Status::OK(); }
-		virtual Status Sync() { return Status::OK(); }
+		virtual Status Sync() {
+			syncs_++;
+			return Status::OK();
+		}
 		virtual Status Append(const Slice& slice) {
-			contents_.append(slice.data(), slice.size());
+			if (write_offset_ == std::string::npos) {
+				contents_.append(slice.data(), slice.size());
+				return Status::OK();
+			}
+			const size_t overlap =
+				std::min(slice.size(), contents_.size() - write_offset_);
+			contents_.replace(write_offset_, overlap, slice.data(), overlap);
+			contents_.append(slice.data() + overlap, slice.size() - overlap);
+			write_offset_ += slice.size();
 			return Status::OK();
 		}
 	};
@@ -142,6 +173,70 @@ public:
 		return dest_.contents_.size();
 	}
 
+	GroupCommitWriter* NewGroupCommitWriter() {
+		return new GroupCommitWriter(writer_, &dest_);
+	}
+
+	int Syncs() const {
+		return dest_.syncs_;
+	}
+
+	// Overwrite the log written so far, as a recycled log file, by a new
+	// log "log_number", and read it back as that log.
+	void Recycle(uint64_t log_number) {
+		ASSERT_TRUE(!reading_) << "Recycle() after starting to read";
+		dest_.write_offset_ = 0;
+		delete writer_;
+		writer_ = new Writer(&dest_, log_number, true/*recycle_log_files*/);
+		ReopenReader(log_number);
+	}
+
+	// Start over with a writer that compresses the records of log 1,
+	// overwriting the log written so far if "recycle_log_files" is true
+	void Compress(bool recycle_log_files) {
+		ASSERT_TRUE(!reading_) << "Compress() after starting to read";
+		if (recycle_log_files) {
+			dest_.write_offset_ = 0;
+		}
+		delete writer_;
+		writer_ = new Writer(&dest_, 1, recycle_log_files, kSnappyCompression);
+		ReopenReader(1);
+	}
+
+	void ReopenReader(uint64_t log_number, size_t read_size = kBlockSize) {
+		delete reader_;
+		reader_ = new Reader(&source_, &report_, true/*checksum*/,
+			0/*initial_offset*/, log_number, read_size);
+	}
+
+	// Read the whole log with a new reader that reads "read_size" bytes
+	// at a time, starting at "initial_offset".  Returns the sizes of the
+	// records and the number of bytes dropped.
+	std::string ReadAll(size_t read_size, uint64_t initial_offset = 0) {
+		StringSource source;
+		source.contents_ = Slice(dest_.contents_);
+		ReportCollector report;
+		Reader reader(&source, &report, true/*checksum*/, initial_offset,
+			0/*log_number*/, read_size);
+		std::string result;
+		std::string scratch;
+		Slice record;
+		while (reader.ReadRecord(&record, &scratch)) {
+			result.append(NumberString(static_cast<int>(record.size())));
+		}
+		result.append(" dropped=");
+		result.append(NumberString(static_cast<int>(report.dropped_bytes_)));
+		return result;
+	}
+
+	// Returns the number of dropped bytes recorded in a ReadAll() result.
+	static size_t DroppedBytesOf(const std::string& summary) {
+		const size_t pos = summary.rfind(" dropped=");
+		ASSERT_TRUE(pos != std::string::npos);
+		return static_cast<size_t>(
+			strtoull(summary.c_str() + pos + strlen(" dropped="), NULL, 10));
+	}
+
 	std::string Read() {
 		// 如果不是read状态就设置成read状态
 		// 而且把WritableFile里面的内容复制到SequentialFile里面
@@ -360,6 +455,43 @@ TEST(LogTest, RandomRead) {
 	ASSERT_EQ("EOF", Read());
 }
 
+TEST(LogTest, LargeReadSize) {
+	const int N = 500;
+	Random write_rnd(301);
+	for (int i = 0; i < N; i++) {
+		Write(RandomSkewedString(i, &write_rnd));
+	}
+	// Not a multiple of kBlockSize, so it is rounded up
+	ReopenReader(0, 3 * kBlockSize - 100);
+	Random read_rnd(301);
+	for (int i = 0; i < N; i++) {
+		ASSERT_EQ(RandomSkewedString(i, &read_rnd), Read());
+	}
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, LargeReadSizeMatchesBlockReads) {
+	Random rnd(301);
+	for (int i = 0; i < 200; i++) {
+		Write(RandomSkewedString(i, &rnd));
+	}
+	// Break records in several blocks, including the last one
+	IncrementByte(kBlockSize + 100, 1);
+	IncrementByte(4 * kBlockSize + 3, 1);
+	IncrementByte(static_cast<int>(WrittenBytes()) - 10, 1);
+	const std::string expected = ReadAll(kBlockSize);
+	const size_t dropped = DroppedBytesOf(expected);
+	ASSERT_GT(dropped, 0u);
+	for (int blocks = 2; blocks <= 8; blocks++) {
+		const std::string actual = ReadAll(blocks * kBlockSize);
+		ASSERT_EQ(dropped, DroppedBytesOf(actual));
+		ASSERT_EQ(expected, actual);
+		ASSERT_EQ(ReadAll(kBlockSize, 2 * kBlockSize + 10),
+			ReadAll(blocks * kBlockSize, 2 * kBlockSize + 10));
+	}
+}
+
 // Tests of all the error paths in log_reader.cpp follow:
 
 TEST(LogTest, ReadError) {
@@ -592,5 +724,182 @@ TEST(LogTest, ReadPastEnd) {
 	CheckOffsetPastEndReturnsNoRecords(5);
 }
 
+namespace {
+
+struct GroupCommitState {
+	GroupCommitWriter* writer;
+	int thread;
+	port::Mutex* mu;
+	port::CondVar* cv;
+	int* done;
+};
+
+const int kGroupCommitThreads = 8;
+const int kGroupCommitRecords = 200;
+
+void GroupCommitThread(void* arg) {
+	GroupCommitState* state = reinterpret_cast<GroupCommitState*>(arg);
+	Random rnd(state->thread + 1);
+	for (int i = 0; i < kGroupCommitRecords; i++) {
+		// Mix in records that span blocks
+		const std::string prefix =
+			NumberString(state->thread * kGroupCommitRecords + i);
+		std::string record = BigString(prefix, prefix.size() +
+			(i % 50 == 0 ? kBlockSize + rnd.Uniform(kBlockSize) : rnd.Uniform(200)));
+		ASSERT_OK(state->writer->AddRecord(record, i % 2 == 0));
+	}
+	MutexLock l(state->mu);
+	(*state->done)++;
+	state->cv->SignalAll();
+}
+
+}  // namespace
+
+TEST(LogTest, GroupCommit) {
+	GroupCommitWriter* writer = NewGroupCommitWriter();
+	port::Mutex mu;
+	port::CondVar cv(&mu);
+	int done = 0;
+	GroupCommitState states[kGroupCommitThreads];
+	for (int t = 0; t < kGroupCommitThreads; t++) {
+		states[t].writer = writer;
+		states[t].thread = t;
+		states[t].mu = &mu;
+		states[t].cv = &cv;
+		states[t].done = &done;
+		Env::Default()->StartThread(GroupCommitThread, &states[t]);
+	}
+	{
+		MutexLock l(&mu);
+		while (done < kGroupCommitThreads) {
+			cv.Wait();
+		}
+	}
+	delete writer;
+
+	// Every record comes back once and intact
+	ASSERT_GT(Syncs(), 0);
+	ASSERT_LE(Syncs(), kGroupCommitThreads * kGroupCommitRecords / 2);
+	std::set<int> seen;
+	for (int i = 0; i < kGroupCommitThreads * kGroupCommitRecords; i++) {
+		std::string record = Read();
+		ASSERT_NE("EOF", record);
+		const int n = atoi(record.c_str());
+		ASSERT_TRUE(seen.insert(n).second);
+		ASSERT_EQ(BigString(NumberString(n), record.size()), record);
+	}
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLog) {
+	Recycle(1);
+	Write("foo");
+	ASSERT_EQ(kRecyclableHeaderSize + 3, WrittenBytes());
+	Write(BigString("bar", 3 * kBlockSize));
+	Write("baz");
+	ASSERT_EQ("foo", Read());
+	ASSERT_EQ(BigString("bar", 3 * kBlockSize), Read());
+	ASSERT_EQ("baz", Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogIgnoresOldRecords) {
+	// The old incarnation is longer than the new one, with records in
+	// several blocks
+	for (int i = 0; i < 100; i++) {
+		Write(BigString(NumberString(i), 1000));
+	}
+	const size_t old_size = WrittenBytes();
+	Recycle(2);
+	Write("hello");
+	Write(BigString("world", kBlockSize));
+	ASSERT_EQ(old_size, WrittenBytes());
+	ASSERT_EQ("hello", Read());
+	ASSERT_EQ(BigString("world", kBlockSize), Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogIgnoresPreviousIncarnation) {
+	Recycle(3);
+	for (int i = 0; i < 100; i++) {
+		Write(BigString(NumberString(i), 1000));
+	}
+	Recycle(4);
+	Write("hello");
+	ASSERT_EQ("hello", Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, RecycledLogWrongNumber) {
+	Recycle(5);
+	Write("foo");
+	ReopenReader(6);
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, CompressedRecords) {
+	Compress(false);
+	Write("");
+	Write("small");
+	Write(BigString("compressible.", 100000));
+	Write(BigString("foo", 1000));
+	if (SnappyCompressionSupported()) {
+		ASSERT_LT(WrittenBytes(), 10000);
+	}
+	ASSERT_EQ("", Read());
+	ASSERT_EQ("small", Read());
+	ASSERT_EQ(BigString("compressible.", 100000), Read());
+	ASSERT_EQ(BigString("foo", 1000), Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, CompressedRecyclableRecords) {
+	Write(BigString("old", 100000));
+	Compress(true);
+	Write(BigString("new", 10000));
+	Write("new");
+	ASSERT_EQ(BigString("new", 10000), Read());
+	ASSERT_EQ("new", Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(0, DroppedBytes());
+}
+
+TEST(LogTest, IncompressibleRecordsStayRaw) {
+	Compress(false);
+	Random rnd(301);
+	std::string record;
+	for (int i = 0; i < 1000; i++) {
+		record.push_back(static_cast<char>(rnd.Uniform(256)));
+	}
+	Write(record);
+	ASSERT_EQ(kHeaderSize + record.size(), WrittenBytes());
+	ASSERT_EQ(record, Read());
+	ASSERT_EQ("EOF", Read());
+}
+
+TEST(LogTest, CorruptedCompressedRecord) {
+	if (!SnappyCompressionSupported()) {
+		fprintf(stderr, "skipping compressed record corruption test\n");
+		return;
+	}
+	Compress(false);
+	Write(BigString("foo", 1000));
+	Write("bar");
+	// Break the compressed payload of the first record but keep its crc valid
+	const int length = static_cast<int>(WrittenBytes()) - 2 * kHeaderSize - 3;
+	SetByte(kHeaderSize, '\xff');
+	FixChecksum(0, length);
+	ASSERT_EQ("bar", Read());
+	ASSERT_EQ("EOF", Read());
+	ASSERT_EQ(length, DroppedBytes());
+	ASSERT_EQ("OK", MatchError("corrupted compressed record"));
+}
+
 }  // namespace log
-}  // namespace leveldb
\ No newline at end of file
+}  // namespace leveldb
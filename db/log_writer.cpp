@@ -4,6 +4,8 @@
 #include "env.h"
 #include "coding.h"
 #include "crc32c.h"
+#include "log_tailer.h"
+#include "port.h"
 
 namespace leveldb {
 namespace log {
@@ -17,12 +19,34 @@ static void InitTypeCrc(uint32_t* type_crc) {
 
 Writer::Writer(WritableFile* dest)
 	: dest_(dest),
-	block_offset_(0) {
+	block_offset_(0),
+	recycle_log_files_(false),
+	header_size_(kHeaderSize),
+	log_number_(0),
+	compression_(kNoCompression),
+	notifier_(NULL) {
 	InitTypeCrc(type_crc_);
 }
 
 Writer::Writer(WritableFile* dest, uint64_t dest_length)
-	: dest_(dest), block_offset_(dest_length % kBlockSize) {
+	: dest_(dest), block_offset_(dest_length % kBlockSize),
+	recycle_log_files_(false),
+	header_size_(kHeaderSize),
+	log_number_(0),
+	compression_(kNoCompression),
+	notifier_(NULL) {
+	InitTypeCrc(type_crc_);
+}
+
+Writer::Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_files,
+	CompressionType compression)
+	: dest_(dest),
+	block_offset_(0),
+	recycle_log_files_(recycle_log_files),
+	header_size_(recycle_log_files ? kRecyclableHeaderSize : kHeaderSize),
+	log_number_(static_cast<uint32_t>(log_number)),
+	compression_(compression),
+	notifier_(NULL) {
 	InitTypeCrc(type_crc_);
 }
 
@@ -30,34 +54,84 @@ Writer::~Writer() {
 }
 
 Status Writer::AddRecord(const Slice& slice) {
+	return AddRecords(&slice, 1);
+}
+
+Status Writer::AddRecords(const Slice* records, size_t n) {
+	// 压缩后的payload保存在compressed_中，直到AppendV()返回
+	// compressed_[i]为空表示records[i]按原样写入，压缩的结果不会为空
+	const bool compress = compression_ == kSnappyCompression;
+	if (compress) {
+		if (compressed_.size() < n) {
+			compressed_.resize(n);
+		}
+		for (size_t i = 0; i < n; i++) {
+			const Slice& raw = records[i];
+			// 与table block一样，压缩率不到12.5%时直接写入原始数据
+			if (!port::Snappy_Compress(raw.data(), raw.size(), &compressed_[i]) ||
+				compressed_[i].size() >= raw.size() - (raw.size() / 8u)) {
+				compressed_[i].clear();
+			}
+		}
+	}
+
+	// headers_在格式化前按最多的fragment数分配好，pieces_中指向它的Slice不会失效
+	// 一个record最多占用size / (kBlockSize - header_size_) + 2个fragment
+	size_t max_fragments = 0;
+	for (size_t i = 0; i < n; i++) {
+		max_fragments += records[i].size() / (kBlockSize - header_size_) + 2;
+	}
+	headers_.resize(max_fragments * header_size_);
+	pieces_.clear();
+	char* header = headers_.data();
+	for (size_t i = 0; i < n; i++) {
+		if (compress && !compressed_[i].empty()) {
+			AppendRecord(compressed_[i], true, &header);
+		}
+		else {
+			AppendRecord(records[i], false, &header);
+		}
+	}
+
+	Status s = dest_->AppendV(pieces_.data(), pieces_.size());
+	if (s.ok()) {
+		s = dest_->Flush();
+	}
+	if (s.ok() && notifier_ != NULL) {
+		notifier_->Notify();
+	}
+	return s;
+}
+
+void Writer::AppendRecord(const Slice& slice, bool compressed,
+	char** header) {
 	const char* ptr = slice.data();
 	size_t left = slice.size();
 
 	// Fragment the record if necessary and emit it.  Note that if slice
 	// is empty, we still want to iterate once to emit a single
 	// zero-length record
-	Status s;
 	bool begin = true;
 	do {
 		const int leftover = kBlockSize - block_offset_;
 		assert(leftover >= 0);
-		if (leftover < kHeaderSize) {
+		if (leftover < header_size_) {
 			// Switch to a new block
 			if (leftover > 0) {
-				// File the trailer (literal below relies on kHeaderSize being 7)
-				// 每个十六进制数字占1 byte，之前已经确认了当前block剩余的size小于7
+				// Fill the trailer
+				// 之前已经确认了当前block剩余的size小于header_size_
 				// 这个操作把当前block剩下的内容设置为0
-				assert(kHeaderSize == 7);
-				dest_->Append(Slice("\x00\x00\x00\x00\x00\x00", leftover));
+				static const char kZeroes[kRecyclableHeaderSize] = { 0 };
+				pieces_.push_back(Slice(kZeroes, leftover));
 			}
 			block_offset_ = 0;
 		}
 
-		// Invariant: we never leave < kHeaderSize bytes in a block.
-		assert(kBlockSize - block_offset_ - kHeaderSize >= 0);
+		// Invariant: we never leave < header_size_ bytes in a block.
+		assert(kBlockSize - block_offset_ - header_size_ >= 0);
 
 		// 计算出当前block还可以放下的数据大小
-		const size_t avail = kBlockSize - block_offset_ - kHeaderSize;
+		const size_t avail = kBlockSize - block_offset_ - header_size_;
 		// 计算这个fragment的大小，即如果要写入数据当前record剩下的大小left小于avail，
 		// 那么就把left数据完全写入，否则把当前block剩下的写满
 		const size_t fragment_length = (left < avail) ? left : avail;
@@ -65,52 +139,61 @@ Status Writer::AddRecord(const Slice& slice) {
 		RecordType type;
 		// 如果剩下的数据size等于当前fragment的长度，则表示当前fragment可以在当前block写完
 		const bool end = (left == fragment_length);
-		if (begin && end) {
-			type = kFullType;
+		if (begin && end && compressed) {
+			type = recycle_log_files_ ? kRecyclableCompressedFullType :
+				kCompressedFullType;
+		}
+		else if (begin && end) {
+			type = recycle_log_files_ ? kRecyclableFullType : kFullType;
+		}
+		else if (begin && compressed) {
+			type = recycle_log_files_ ? kRecyclableCompressedFirstType :
+				kCompressedFirstType;
 		}
 		else if (begin) {
-			type = kFirstType;
+			type = recycle_log_files_ ? kRecyclableFirstType : kFirstType;
 		}
 		else if (end) {
-			type = kLastType;
+			type = recycle_log_files_ ? kRecyclableLastType : kLastType;
 		}
 		else {
-			type = kMiddleType;
+			type = recycle_log_files_ ? kRecyclableMiddleType : kMiddleType;
 		}
 
-		s = EmitPhysicalRecord(type, ptr, fragment_length);
+		EmitPhysicalRecord(type, ptr, fragment_length, *header);
+		*header += header_size_;
 		ptr += fragment_length;
 		left -= fragment_length;
 		begin = false;
-	} while (s.ok() && left > 0);
-	return s;
+	} while (left > 0);
 }
 
-Status Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n) {
+void Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n,
+	char* buf) {
 	assert(n <= 0xffff);  // Must fit in two bytes
-	assert(block_offset_ + kHeaderSize + n <= kBlockSize);
+	assert(block_offset_ + header_size_ + n <= kBlockSize);
 
 	// Format the header
-	char buf[kHeaderSize];
 	buf[4] = static_cast<char>(n & 0xff);
 	buf[5] = static_cast<char>(n >> 8);
 	buf[6] = static_cast<char>(t);
 
-	// Compute the crc of the record type and the payload
-	uint32_t crc = crc32c::Extend(type_crc_[t], ptr, n);
+	// Compute the crc of the record type (and log number) and the payload
+	uint32_t crc = type_crc_[t];
+	if (recycle_log_files_) {
+		EncodeFixed32(buf + kHeaderSize, log_number_);
+		crc = crc32c::Extend(crc, buf + kHeaderSize, 4);
+	}
+	crc = crc32c::Extend(crc, ptr, n);
 	crc = crc32c::Mask(crc);                 // Adjust for storage
 	EncodeFixed32(buf, crc);
 
-	// Write the header and the payload
-	Status s = dest_->Append(Slice(buf, kHeaderSize));
-	if (s.ok()) {
-		s = dest_->Append(Slice(ptr, n));
-		if (s.ok()) {
-			s = dest_->Flush();
-		}
+	// The header and the payload are written by AddRecords()
+	pieces_.push_back(Slice(buf, header_size_));
+	if (n > 0) {
+		pieces_.push_back(Slice(ptr, n));
 	}
-	block_offset_ += kHeaderSize + n;
-	return s;
+	block_offset_ += header_size_ + n;
 }
 
 }  // namespace log
@@ -1,8 +1,13 @@
 #ifndef STORAGE_LEVELDB_DB_LOG_WRITER_H_
 #define STORAGE_LEVELDB_DB_LOG_WRITER_H_
 
+#include <stddef.h>
 #include <stdint.h>
+#include <string>
+#include <vector>
 #include "log_format.h"
+#include "options.h"
+#include "slice.h"
 #include "status.h"
 
 namespace leveldb {
@@ -11,6 +16,8 @@ class WritableFile;
 
 namespace log {
 
+class AppendNotifier;
+
 class Writer {
 public:
 	// Create a writer that will append data to "*dest".
@@ -23,20 +30,66 @@ public:
 	// "*dest" must remain live while this Writer is in use.
 	Writer(WritableFile* dest, uint64_t dest_length);
 
+	// Create a writer that will write log "log_number" to "*dest", which
+	// must be initially empty or a recycled log file overwritten from its
+	// start.  If "recycle_log_files" is true, records of the recyclable
+	// types are written, which a Reader told the log number can tell from
+	// the stale records of the file's previous use.  This must be the case
+	// whenever log files may be recycled, including for new files.
+	//
+	// If "compression" is not kNoCompression, each record is compressed
+	// with it and written with the compressed record types, unless that
+	// saves less than 12.5% or the compression is not supported.  A
+	// Reader decompresses such records transparently.
+	//
+	// "*dest" must remain live while this Writer is in use.
+	Writer(WritableFile* dest, uint64_t log_number, bool recycle_log_files,
+		CompressionType compression = kNoCompression);
+
 	~Writer();
 
 	Status AddRecord(const Slice& slice);
 
+	// Same as calling AddRecord() for records[0,n-1] in order, but the
+	// headers and fragments of all of them are handed to the file in a
+	// single WritableFile::AppendV() call, followed by one Flush().
+	Status AddRecords(const Slice* records, size_t n);
+
+	// Call notifier->Notify() after each AddRecord() or AddRecords() that
+	// succeeds, so that TailingReaders waiting on it read the new records.
+	// "*notifier" must remain live while this Writer is in use.
+	void SetAppendNotifier(AppendNotifier* notifier) { notifier_ = notifier; }
+
 private:
 	WritableFile* dest_;
 	int block_offset_;       // CUrrent offset in block
+	const bool recycle_log_files_;
+	const int header_size_;  // kRecyclableHeaderSize or kHeaderSize
+	const uint32_t log_number_;  // Written into recyclable headers
+	const CompressionType compression_;
+	AppendNotifier* notifier_;
 
 	// crc32c values for all supported record types.  These are
 	// pre-computed to reduce the overhead of computing the crc of the
 	// record type stored in the header.
 	uint32_t type_crc_[kMaxRecordType + 1];
 
-	Status EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
+	// Headers of the fragments being written, and the pieces (headers,
+	// fragments and block trailers) to pass to AppendV().  Kept across
+	// calls to reuse their memory.
+	std::vector<char> headers_;
+	std::vector<Slice> pieces_;
+
+	// Compressed forms of the records being written, empty for the ones
+	// written as they are
+	std::vector<std::string> compressed_;
+
+	// Add the pieces of one record to pieces_, with its headers formatted
+	// at *header, which is advanced past them.  "compressed" tells whether
+	// the payload in "slice" is compressed.
+	void AppendRecord(const Slice& slice, bool compressed, char** header);
+	void EmitPhysicalRecord(RecordType type, const char* ptr, size_t length,
+		char* header);
 
 	// No copying allowed
 	Writer(const Writer&);
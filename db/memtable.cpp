@@ -1,9 +1,11 @@
 ﻿#include "memtable.h"
+#include <vector>
 #include "dbformat.h"
 #include "comparator.h"
 #include "env.h"
 #include "iterator.h"
 #include "coding.h"
+#include "mutexlock.h"
 
 namespace leveldb {
 
@@ -14,25 +16,98 @@ static Slice GetLengthPrefixedSlice(const char* data) {
 	return Slice(p, len);
 }
 
-MemTable::MemTable(const InternalKeyComparator& cmp)
+// Block size for the memtable arena, falling back to "default_size"
+static size_t ArenaBlockSize(const Options& options, size_t default_size) {
+	return options.arena_block_size > 0 ? options.arena_block_size : default_size;
+}
+
+static MemTableRep* NewRep(const Options& options,
+	const MemTableRep::KeyComparator& cmp, Allocator* allocator) {
+	switch (options.memtable_rep) {
+	case kHashIndexRep: {
+		size_t bucket_count = options.memtable_hash_bucket_count;
+		if (bucket_count == 0) {
+			bucket_count = options.write_buffer_size / 64 + 1;
+		}
+		return NewHashIndexRep(cmp, allocator, bucket_count);
+	}
+	case kHashSkipListRep: {
+		if (options.prefix_extractor == NULL) {
+			break;
+		}
+		size_t bucket_count = options.memtable_hash_bucket_count;
+		if (bucket_count == 0) {
+			bucket_count = options.write_buffer_size / 4096 + 1;
+		}
+		return NewHashSkipListRep(cmp, allocator, options.prefix_extractor,
+			bucket_count);
+	}
+	case kVectorRep:
+		return NewVectorRep(cmp);
+	case kInlineSkipListRep:
+		// Sized for entries of 64 bytes or more
+		return NewInlineSkipListRep(cmp, allocator,
+			options.write_buffer_size / 64 + 1);
+	case kSkipListRep:
+	default:
+		break;
+	}
+	return NewSkipListRep(cmp, allocator);
+}
+
+MemTable::MemTable(const InternalKeyComparator& cmp, const Options& options)
 	: comparator_(cmp),
 	refs_(0),
-	table_(comparator_, &arena_) {
+	arena_(ArenaBlockSize(options, Arena::kDefaultBlockSize),
+		options.memtable_huge_page_size),
+	concurrent_arena_(options.allow_concurrent_memtable_write
+		? new ConcurrentArena(
+			ArenaBlockSize(options, ConcurrentArena::kDefaultBlockSize),
+			options.memtable_huge_page_size)
+		: nullptr),
+	allocator_(concurrent_arena_ != nullptr
+		? static_cast<Allocator*>(concurrent_arena_)
+		: static_cast<Allocator*>(&arena_)),
+	table_(NewRep(options, comparator_, allocator_)),
+	merge_operator_(options.merge_operator),
+	write_buffer_manager_(options.write_buffer_manager),
+	write_buffer_reserved_(0),
+	range_del_table_(NewSkipListRep(comparator_, allocator_)),
+	num_range_deletes_(0) {
 }
 
 MemTable::~MemTable() {
 	assert(refs_ == 0);
+	if (write_buffer_manager_ != NULL) {
+		write_buffer_manager_->FreeMem(write_buffer_reserved_.load());
+	}
+	delete range_del_table_;
+	delete table_;
+	delete concurrent_arena_;
 }
 
-size_t MemTable::ApproximateMemoryUsage() { return arena_.MemoryUsage(); }
+size_t MemTable::ApproximateMemoryUsage() {
+	return allocator_->MemoryUsage() + table_->ApproximateMemoryUsage();
+}
 
-int MemTable::KeyComparator::operator()(const char* aptr, const char* bptr) const {
-	// Internal keys are encoded as length-prefixed strings.
-	Slice a = GetLengthPrefixedSlice(aptr);
-	Slice b = GetLengthPrefixedSlice(bptr);
-	return comparator.Compare(a, b);
+void MemTable::UpdateWriteBufferReservation() {
+	if (write_buffer_manager_ == NULL) {
+		return;
+	}
+	// 并发写入时多个线程可能同时更新，只有成功推进write_buffer_reserved_的线程
+	// 预留差值，保证每个字节只预留一次
+	const size_t usage = ApproximateMemoryUsage();
+	size_t reserved = write_buffer_reserved_.load(std::memory_order_relaxed);
+	while (usage > reserved) {
+		if (write_buffer_reserved_.compare_exchange_weak(reserved, usage,
+			std::memory_order_relaxed)) {
+			write_buffer_manager_->ReserveMem(usage - reserved);
+			break;
+		}
+	}
 }
 
+
 // Encode a suitable internal key target for "target" and return it.
 // Uses *scratch as scratch space, and the returned pointer will point
 // into this scratch space.
@@ -45,29 +120,90 @@ static const char* EncodeKey(std::string* scratch, const Slice& target) {
 
 class MemTableIterator : public Iterator {
 public:
-	// 需要注意的是MemTable::Table就是SkipList<const char*, KeyComparator>
-	// MemTableIterator构造函数需要跳跃表的指针，毕竟遍历MemTable等同于遍历SkipList
-	explicit MemTableIterator(MemTable::Table* table) : iter_(table) { }
-
-	virtual bool Valid() const { return iter_.Valid(); }
-	virtual void Seek(const Slice& k) { iter_.Seek(EncodeKey(&tmp_, k)); }
-	virtual void SeekToFirst() { iter_.SeekToFirst(); }
-	virtual void SeekToLast() { iter_.SeekToLast(); }
-	virtual void Next() { iter_.Next(); }
-	virtual void Prev() { iter_.Prev(); }
-	virtual Slice key() const { return GetLengthPrefixedSlice(iter_.key()); }
+	// MemTableIterator构造函数接管MemTableRep的迭代器，遍历MemTable等同于遍历底层的数据结构
+	explicit MemTableIterator(MemTableRep::Iterator* iter)
+		: iter_(iter), snapshot_(0), fragment_(-1) {
+	}
+
+	// Skips entries deleted by a tombstone in *tombstones visible at snapshot
+	MemTableIterator(MemTableRep::Iterator* iter,
+		const std::shared_ptr<const FragmentedRangeTombstoneList>& tombstones,
+		SequenceNumber snapshot)
+		: iter_(iter), tombstones_(tombstones), snapshot_(snapshot),
+		fragment_(-1) {
+	}
+
+	virtual ~MemTableIterator() { delete iter_; }
+
+	virtual bool Valid() const { return iter_->Valid(); }
+	virtual void Seek(const Slice& k) {
+		iter_->Seek(EncodeKey(&tmp_, k));
+		SkipCoveredForward();
+	}
+	virtual void SeekToFirst() {
+		iter_->SeekToFirst();
+		SkipCoveredForward();
+	}
+	virtual void SeekToLast() {
+		iter_->SeekToLast();
+		SkipCoveredBackward();
+	}
+	virtual void Next() {
+		iter_->Next();
+		SkipCoveredForward();
+	}
+	virtual void Prev() {
+		iter_->Prev();
+		SkipCoveredBackward();
+	}
+	virtual Slice key() const { return GetLengthPrefixedSlice(iter_->key()); }
 	virtual Slice value() const {
 		// 在内存中跳过键的部分后面就是值
 		// 因为在调用GetVarint32Ptr之后p会直接advance到读取的数据之后
-		Slice key_slice = GetLengthPrefixedSlice(iter_.key());
+		Slice key_slice = GetLengthPrefixedSlice(iter_->key());
 		return GetLengthPrefixedSlice(key_slice.data() + key_slice.size());
 	}
 
 	virtual Status status() const { return Status::OK(); }
 
 private:
-	MemTable::Table::Iterator iter_;
+	// Return true if the current entry is deleted by a visible tombstone
+	bool Covered() {
+		const Slice ikey = key();
+		const Slice user_key = ExtractUserKey(ikey);
+		// Consecutive entries mostly fall into the same fragment
+		if (fragment_ < 0 || !tombstones_->Contains(fragment_, user_key)) {
+			fragment_ = tombstones_->Find(user_key);
+			if (fragment_ < 0) {
+				return false;
+			}
+		}
+		const SequenceNumber seq = DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+		return seq < tombstones_->MaxSeqAtOrBelow(fragment_, snapshot_);
+	}
+
+	void SkipCoveredForward() {
+		if (tombstones_ != nullptr) {
+			while (iter_->Valid() && Covered()) {
+				iter_->Next();
+			}
+		}
+	}
+
+	void SkipCoveredBackward() {
+		if (tombstones_ != nullptr) {
+			while (iter_->Valid() && Covered()) {
+				iter_->Prev();
+			}
+		}
+	}
+
+	MemTableRep::Iterator* iter_;
 	std::string tmp_;         // For passing to EncodeKey
+	// Null unless covered entries are skipped
+	const std::shared_ptr<const FragmentedRangeTombstoneList> tombstones_;
+	const SequenceNumber snapshot_;
+	int fragment_;  // Fragment of the last entry checked, or -1
 
 	// No copying allowed
 	MemTableIterator(const MemTableIterator&);
@@ -75,10 +211,53 @@ private:
 };
 
 Iterator* MemTable::NewIterator() {
-	return new MemTableIterator(&table_);
+	return new MemTableIterator(table_->NewIterator());
 }
 
-void MemTable::Add(SequenceNumber s, ValueType type,
+Iterator* MemTable::NewIterator(SequenceNumber snapshot) {
+	std::shared_ptr<const FragmentedRangeTombstoneList> tombstones =
+		GetRangeTombstones();
+	if (tombstones == nullptr) {
+		return NewIterator();
+	}
+	return new MemTableIterator(table_->NewIterator(), tombstones, snapshot);
+}
+
+Iterator* MemTable::NewRangeTombstoneIterator() {
+	return new MemTableIterator(range_del_table_->NewIterator());
+}
+
+std::shared_ptr<const FragmentedRangeTombstoneList> MemTable::GetRangeTombstones() {
+	const uint64_t count = num_range_deletes_.load(std::memory_order_acquire);
+	if (count == 0) {
+		return nullptr;
+	}
+	std::shared_ptr<const FragmentedRangeDels> dels =
+		std::atomic_load(&fragmented_range_dels_);
+	if (dels == nullptr || dels->count < count) {
+		// 只有重新构建时才加锁，其他线程可能已经构建好了
+		MutexLock l(&range_del_mu_);
+		dels = std::atomic_load(&fragmented_range_dels_);
+		if (dels == nullptr || dels->count < count) {
+			// Tombstones added while building are picked up as well; they
+			// only trigger one extra rebuild.
+			const uint64_t n = num_range_deletes_.load(std::memory_order_acquire);
+			Iterator* iter = NewRangeTombstoneIterator();
+			dels = std::make_shared<const FragmentedRangeDels>(n, iter,
+				comparator_.comparator.user_comparator());
+			delete iter;
+			std::atomic_store(&fragmented_range_dels_, dels);
+		}
+	}
+	// 和dels共享所有权，只指向其中的list
+	return std::shared_ptr<const FragmentedRangeTombstoneList>(dels, &dels->list);
+}
+
+Iterator* MemTable::NewPrefixIterator() {
+	return new MemTableIterator(table_->NewPrefixIterator());
+}
+
+const char* MemTable::EncodeEntry(SequenceNumber s, ValueType type,
 	const Slice& key,
 	const Slice& value) {
 	// Format of an entry is concatenation of:
@@ -98,8 +277,9 @@ void MemTable::Add(SequenceNumber s, ValueType type,
 		VarintLength(internal_key_size) + internal_key_size +
 		VarintLength(val_size) + val_size;
 	
-	// 申请需要的内存
-	char* buf = arena_.Allocate(encoded_len);
+	// 申请需要的内存，kInlineSkipListRep的entry直接存放在跳跃表节点中
+	MemTableRep* rep = (type == kTypeRangeDeletion) ? range_del_table_ : table_;
+	char* buf = rep->AllocateEntry(encoded_len, allocator_);
 	char* p = EncodeVarint32(buf, internal_key_size);
 	
 	// 存放internal key
@@ -113,14 +293,103 @@ void MemTable::Add(SequenceNumber s, ValueType type,
 	memcpy(p, value.data(), val_size);
 
 	assert((p + val_size) - buf == encoded_len);
-	table_.Insert(buf);
+	return buf;
+}
+
+void MemTable::Add(SequenceNumber s, ValueType type,
+	const Slice& key,
+	const Slice& value) {
+	const char* entry = EncodeEntry(s, type, key, value);
+	if (type == kTypeRangeDeletion) {
+		range_del_table_->Insert(entry);
+		num_range_deletes_.fetch_add(1, std::memory_order_release);
+	}
+	else {
+		table_->Insert(entry);
+	}
+	UpdateWriteBufferReservation();
+}
+
+void MemTable::AddBatch(SequenceNumber s, const BatchEntry* entries,
+	size_t n) {
+	std::vector<const char*> encoded;
+	encoded.reserve(n);
+	for (size_t i = 0; i < n; i++) {
+		if (entries[i].type == kTypeRangeDeletion) {
+			Add(s + i, entries[i].type, entries[i].key, entries[i].value);
+		}
+		else {
+			encoded.push_back(EncodeEntry(s + i, entries[i].type, entries[i].key,
+				entries[i].value));
+		}
+	}
+	table_->InsertBatch(encoded.data(), encoded.size());
+	UpdateWriteBufferReservation();
+}
+
+void MemTable::AddConcurrent(SequenceNumber s, ValueType type,
+	const Slice& key,
+	const Slice& value) {
+	assert(concurrent_arena_ != nullptr);
+	const char* entry = EncodeEntry(s, type, key, value);
+	if (type == kTypeRangeDeletion) {
+		range_del_table_->InsertConcurrently(entry);
+		num_range_deletes_.fetch_add(1, std::memory_order_release);
+	}
+	else {
+		table_->InsertConcurrently(entry);
+	}
+	UpdateWriteBufferReservation();
 }
 
-bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
-	Slice memkey = key.memtable_key();
-	Table::Iterator iter(&table_);
-	iter.Seek(memkey.data());
-	if (iter.Valid()) {
+// Apply the operands in *merge_context to base (NULL if none) and store
+// the outcome in *value and *s.
+static void ResolveMerge(const MergeOperator* merge_operator,
+	const MergeContext& merge_context, const Slice& user_key,
+	const Slice* base, std::string* value, Status* s) {
+	if (!merge_context.Resolve(merge_operator, user_key, base, value)) {
+		*s = Status::Corruption("merge operator failed");
+	}
+}
+
+bool MemTable::Get(const LookupKey& key, std::string* value, Status* s,
+	MergeContext* merge_context) {
+	return GetFromEntry(key, table_->Get(key.memtable_key().data()), value, s,
+		merge_context);
+}
+
+void MemTable::MultiGet(const LookupKey* const* keys, size_t n,
+	std::string* values, Status* statuses, bool* found) {
+	std::vector<const char*> memkeys(n);
+	std::vector<const char*> entries(n);
+	for (size_t i = 0; i < n; i++) {
+		memkeys[i] = keys[i]->memtable_key().data();
+	}
+	table_->MultiGet(memkeys.data(), n, entries.data());
+	for (size_t i = 0; i < n; i++) {
+		found[i] = GetFromEntry(*keys[i], entries[i], &values[i], &statuses[i],
+			nullptr);
+	}
+}
+
+bool MemTable::GetFromEntry(const LookupKey& key, const char* entry,
+	std::string* value, Status* s, MergeContext* merge_context) {
+	// Newest range deletion covering the key that is visible to the lookup
+	SequenceNumber tombstone_seq = 0;
+	if (num_range_deletes_.load(std::memory_order_acquire) > 0) {
+		const Slice ikey = key.internal_key();
+		const SequenceNumber snapshot =
+			DecodeFixed64(ikey.data() + ikey.size() - 8) >> 8;
+		tombstone_seq = GetRangeTombstones()->MaxCoveringTombstoneSeqnum(
+			key.user_key(), snapshot);
+	}
+
+	// Operands of the key, newest first, from newer sources and this one
+	MergeContext local_context;
+	MergeContext* operands =
+		merge_context != nullptr ? merge_context : &local_context;
+	bool done = false;
+	while (entry != nullptr && !done) {
 		// entry format is:
 		//    klength  varint32
 		//    userkey  char[klength]
@@ -128,28 +397,88 @@ bool MemTable::Get(const LookupKey& key, std::string* value, Status* s) {
 		//    vlength  varint32
 		//    value    char[vlength]
 		// Check that it belongs to same user key.  We do not check the
-		// sequence number since the Seek() call above should have skipped
+		// sequence number since the lookup of entry should have skipped
 		// all entries with overly large sequence numbers.
-		const char* entry = iter.key();
 		uint32_t key_length;
 		const char* key_ptr = GetVarint32Ptr(entry, entry + 5, &key_length);
 		if (comparator_.comparator.user_comparator()->Compare(
 			Slice(key_ptr, key_length - 8),
-			key.user_key()) == 0) {
-			// Correct user key
-			const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
-			switch (static_cast<ValueType>(tag & 0xff)) {
-			case kTypeValue: {
-				Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+			key.user_key()) != 0) {
+			break;
+		}
+		// Correct user key
+		const uint64_t tag = DecodeFixed64(key_ptr + key_length - 8);
+		ValueType type = static_cast<ValueType>(tag & 0xff);
+		if ((tag >> 8) < tombstone_seq) {
+			type = kTypeDeletion;
+		}
+		switch (type) {
+		case kTypeValue: {
+			Slice v = GetLengthPrefixedSlice(key_ptr + key_length);
+			if (operands->empty()) {
 				value->assign(v.data(), v.size());
-				return true;
 			}
-			case kTypeDeletion:
+			else {
+				ResolveMerge(merge_operator_, *operands, key.user_key(), &v,
+					value, s);
+			}
+			done = true;
+			break;
+		}
+		case kTypeDeletion:
+			if (operands->empty()) {
 				*s = Status::NotFound(Slice());
-				return true;
 			}
+			else {
+				ResolveMerge(merge_operator_, *operands, key.user_key(), NULL,
+					value, s);
+			}
+			done = true;
+			break;
+		case kTypeMerge:
+			if (merge_operator_ == NULL) {
+				*s = Status::InvalidArgument(
+					"merge operand found without a merge operator");
+				done = true;
+				break;
+			}
+			operands->PushOlderOperand(merge_operator_, key.user_key(),
+				GetLengthPrefixedSlice(key_ptr + key_length));
+			// Walk on to the older entries of the key with the same lookup
+			// as for the first one: some reps (such as the vector rep) copy
+			// all entries to create an iterator
+			if ((tag >> 8) == 0) {
+				entry = nullptr;
+			}
+			else {
+				LookupKey older(key.user_key(), (tag >> 8) - 1);
+				entry = table_->Get(older.memtable_key().data());
+			}
+			break;
+		default:
+			entry = nullptr;
+			break;
 		}
 	}
+	if (done) {
+		return true;
+	}
+
+	if (tombstone_seq > 0) {
+		// Everything older than this memtable is older than the tombstone
+		if (operands->empty()) {
+			*s = Status::NotFound(Slice());
+		}
+		else {
+			ResolveMerge(merge_operator_, *operands, key.user_key(), NULL,
+				value, s);
+		}
+		return true;
+	}
+	if (!operands->empty() && merge_context == nullptr) {
+		ResolveMerge(merge_operator_, *operands, key.user_key(), NULL, value, s);
+		return true;
+	}
 	return false;
 }
 
@@ -1,11 +1,21 @@
 ﻿#ifndef STORAGE_LEVELDB_DB_MEMTABLE_H_
 #define STORAGE_LEVELDB_DB_MEMTABLE_H_
 
+#include <atomic>
+#include <memory>
 #include <string>
 #include "dbformat.h"
-#include "skiplist.h"
+#include "memtablerep.h"
 #include "arena.h"
+#include "concurrent_arena.h"
 #include "iterator.h"
+#include "merge_context.h"
+#include "merge_operator.h"
+#include "options.h"
+#include "port.h"
+#include "range_tombstone.h"
+#include "thread_annotations.h"
+#include "write_buffer_manager.h"
 
 namespace leveldb {
 
@@ -19,7 +29,8 @@ public:
 	// is zero and the caller must call Ref() at least once.
 	// 构造函数，需要提供InternalKeyComparator的对象
 	// 这表明在MemTable中是通过InternalKey进行排序的
-	explicit MemTable(const InternalKeyComparator& comparator);
+	// options决定了MemTable是否接受多个线程同时写入
+	MemTable(const InternalKeyComparator& comparator, const Options& options);
 
 	// Increase reference count
 	void Ref() { ++refs_; }
@@ -35,6 +46,8 @@ public:
 
 	// Returns an estimate of the number of bytes of data in use by this
 	// data structure. It is safe to call when MemTable is being modified.
+	// This is also the amount reserved from options.write_buffer_manager,
+	// if any, as of the last write.
 	size_t ApproximateMemoryUsage();
 
 	// Return an iterator that yields the contents of the memtable.
@@ -45,9 +58,36 @@ public:
 	// db/format.{h,cc} module.
 	Iterator* NewIterator();
 
+	// Same as NewIterator(), but skips entries deleted by a range
+	// tombstone visible at "snapshot".  Entries newer than snapshot are
+	// still returned.  Checking an entry costs O(log T) for T tombstone
+	// fragments, or O(1) while the iterator stays within one fragment.
+	Iterator* NewIterator(SequenceNumber snapshot);
+
+	// Return an iterator over the range tombstones of the memtable, in
+	// internal key order: key() is the internal key of the start of the
+	// range and value() the end user key (exclusive).  Suitable for
+	// passing to TableBuilder::AddTombstone().
+	Iterator* NewRangeTombstoneIterator();
+
+	// Return the range tombstones of the memtable split into
+	// non-overlapping fragments, or nullptr if there are none.  The result
+	// is cached until another tombstone is added; only the call that
+	// rebuilds it takes a lock, so readers do not serialize on it.
+	std::shared_ptr<const FragmentedRangeTombstoneList> GetRangeTombstones();
+
+	// Return an iterator that is only correct for the entries sharing the
+	// prefix (see Options::prefix_extractor) of the last Seek() target.
+	// It is invalid until Seek() is called, and may stop early or yield
+	// entries with other prefixes once it has moved past them.  With a
+	// kHashSkipListRep memtable it only visits the entries of one bucket.
+	Iterator* NewPrefixIterator();
+
 	// Add an entry into memtable that maps key to value at the
 	// specified sequence number and with the specified type.
 	// Typically value will be empty if type==kTypeDeletion.
+	// If type==kTypeRangeDeletion, every key in [key, value) is deleted.
+	// If type==kTypeMerge, value is an operand for options.merge_operator.
 	// 
     // 向MemTable中添加对象，提供提供了用户指定的键和值，同时还提供了顺序号和值类型
 	// 说明顺序号是上级(leveldb)别产生的
@@ -56,34 +96,107 @@ public:
 		const Slice& key,
 		const Slice& value);
 
+	// One entry of a batch passed to AddBatch()
+	struct BatchEntry {
+		ValueType type;
+		Slice key;
+		Slice value;
+	};
+
+	// Add entries[0,n-1] with sequence numbers seq, seq+1, ..., seq+n-1.
+	// Runs of ascending keys are inserted without searching the memtable
+	// from the top for every entry.
+	// REQUIRES: no concurrent call to Add() or AddConcurrent().
+	void AddBatch(SequenceNumber seq, const BatchEntry* entries, size_t n);
+
+	// Same as Add(), but may be called from several threads at once
+	// without external synchronization.  Readers stay lock-free.
+	// REQUIRES: options.allow_concurrent_memtable_write was true when
+	// this memtable was created.
+	// REQUIRES: no concurrent call to Add().
+	void AddConcurrent(SequenceNumber seq, ValueType type,
+		const Slice& key,
+		const Slice& value);
+
 	// If memtable contains a value for key, store it in *value and return true.
-	// If memtable contains a deletion for key, store a NotFound() error
-	// in *status and return true.
+	// If memtable contains a deletion for key, or a range deletion covering
+	// it that is newer than any value, store a NotFound() error in *status
+	// and return true.
 	// Else, return false.
-	bool Get(const LookupKey& key, std::string* value, Status* s);
+	//
+	// Merge operands found above the value are applied to it (or to no
+	// value, above a deletion) by options.merge_operator.  If the operands
+	// reach past the oldest entry for key, they are added to
+	// *merge_context and false is returned, so that the caller can go on to
+	// older data with the same context.  Without a merge_context the
+	// memtable is taken to hold the whole history of key, and the operands
+	// are applied to no value.
+	bool Get(const LookupKey& key, std::string* value, Status* s,
+		MergeContext* merge_context = nullptr);
+
+	// Look up *keys[0,n-1] at once: found[i] is set to what
+	// Get(*keys[i], &values[i], &statuses[i]) would return.  The descents
+	// of a skiplist memtable are interleaved, so that the cache misses of
+	// one key overlap with those of the others.
+	void MultiGet(const LookupKey* const* keys, size_t n,
+		std::string* values, Status* statuses, bool* found);
 
 private:
 	~MemTable();  // Private since only Unref() should be used to delete it
 	
 	// 自定义了比较器，说明在InternalKey基础上又进行了扩展
 	// 但最终还是通过InternalKeyComparator实现的比较
-	struct KeyComparator {
-		const InternalKeyComparator comparator;
-		explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) { }
-		// 这里可以看出来进行比较的已经不是Slice
-		// 而是一个buf，所以需要比较器解析buf
-		int operator()(const char* a, const char* b) const;
-	};
+	typedef MemTableRep::KeyComparator KeyComparator;
 	friend class MemTableIterator;
 	friend class MemTableBackwardIterator;
 
-	typedef SkipList<const char*, KeyComparator> Table;
+	// The rest of Get() once table_ has been searched for key: entry is
+	// the first entry at or after it, or nullptr.
+	bool GetFromEntry(const LookupKey& key, const char* entry,
+		std::string* value, Status* s, MergeContext* merge_context);
+
+	// Encode an entry into memory obtained from allocator_ and return it.
+	const char* EncodeEntry(SequenceNumber seq, ValueType type,
+		const Slice& key,
+		const Slice& value);
+
+	// Reserve the growth of ApproximateMemoryUsage() since the last call
+	// from write_buffer_manager_, if any.
+	void UpdateWriteBufferReservation();
 
-	// 成员变量包括：比较器，引用计数，内存管理和跳跃表
+	// 成员变量包括：比较器，引用计数，内存管理和底层的数据结构(默认为跳跃表)
 	KeyComparator comparator_;
 	int refs_;
 	Arena arena_;
-	Table table_;
+	// 只有在允许并发写入时才会创建，多个写线程各自从自己的shard分配内存
+	ConcurrentArena* const concurrent_arena_;
+	// 实际使用的内存分配器，允许并发写入时为concurrent_arena_，否则为arena_
+	Allocator* const allocator_;
+	// 由options.memtable_rep决定具体实现，其内存同样来自allocator_
+	MemTableRep* const table_;
+	// 读取时合并kTypeMerge的entry，可以为NULL
+	const MergeOperator* const merge_operator_;
+	// 多个memtable共享的内存预算，可以为NULL
+	WriteBufferManager* const write_buffer_manager_;
+	// 已经从write_buffer_manager_预留的字节数，析构时归还
+	std::atomic<size_t> write_buffer_reserved_;
+
+	// 范围删除不放在table_中，单独存放在跳跃表中，按起始InternalKey排序
+	MemTableRep* const range_del_table_;
+	// range_del_table_中entry的个数，在entry插入之后才增加
+	std::atomic<uint64_t> num_range_deletes_;
+	// 由range_del_table_构建的不重叠片段，以及构建时的num_range_deletes_
+	struct FragmentedRangeDels {
+		FragmentedRangeDels(uint64_t n, Iterator* iter, const Comparator* ucmp)
+			: count(n), list(iter, ucmp) { }
+
+		const uint64_t count;
+		const FragmentedRangeTombstoneList list;
+	};
+	// 读取时用std::atomic_load()，不需要加锁；有新的范围删除时持有
+	// range_del_mu_重新构建，再用std::atomic_store()替换
+	std::shared_ptr<const FragmentedRangeDels> fragmented_range_dels_;
+	port::Mutex range_del_mu_;
 
 	// No copying allowed
 	MemTable(const MemTable&);
@@ -0,0 +1,940 @@
+#include "memtable.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <string>
+#include <vector>
+
+#include "coding.h"
+#include "comparator.h"
+#include "dbformat.h"
+#include "env.h"
+#include "iterator.h"
+#include "merge_operator.h"
+#include "mutexlock.h"
+#include "options.h"
+#include "port.h"
+#include "random.h"
+#include "slice_transform.h"
+#include "testharness.h"
+#include "write_buffer_manager.h"
+
+namespace leveldb {
+
+static std::string Get(MemTable* mem, const std::string& key,
+	SequenceNumber seq) {
+	LookupKey lkey(key, seq);
+	std::string value;
+	Status s;
+	if (!mem->Get(lkey, &value, &s)) {
+		return "MISSING";
+	}
+	if (s.IsNotFound()) {
+		return "DELETED";
+	}
+	return value;
+}
+
+class MemTableTest {
+public:
+	InternalKeyComparator icmp_;
+	Options options_;
+
+	MemTableTest() : icmp_(BytewiseComparator()) { }
+};
+
+TEST(MemTableTest, EmptyMemTable) {
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	ASSERT_EQ("MISSING", Get(mem, "foo", 100));
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+	mem->Unref();
+}
+
+TEST(MemTableTest, AddAndGet) {
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "foo", "v1");
+	mem->Add(2, kTypeValue, "bar", "b1");
+	mem->Add(3, kTypeValue, "foo", "v2");
+	mem->Add(4, kTypeDeletion, "bar", "");
+
+	ASSERT_EQ("MISSING", Get(mem, "foo", 0));
+	ASSERT_EQ("v1", Get(mem, "foo", 1));
+	ASSERT_EQ("v1", Get(mem, "foo", 2));
+	ASSERT_EQ("v2", Get(mem, "foo", 3));
+	ASSERT_EQ("b1", Get(mem, "bar", 3));
+	ASSERT_EQ("DELETED", Get(mem, "bar", 4));
+	ASSERT_EQ("MISSING", Get(mem, "baz", 10));
+
+	// Entries come back ordered by user key, newest first
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	ASSERT_TRUE(iter->Valid());
+	ASSERT_EQ("bar", ExtractUserKey(iter->key()).ToString());
+	ASSERT_EQ(kTypeDeletion, ExtractValueType(iter->key()));
+	iter->Next();
+	ASSERT_EQ("bar", ExtractUserKey(iter->key()).ToString());
+	ASSERT_EQ("b1", iter->value().ToString());
+	iter->Next();
+	ASSERT_EQ("foo", ExtractUserKey(iter->key()).ToString());
+	ASSERT_EQ("v2", iter->value().ToString());
+	iter->Next();
+	ASSERT_EQ("v1", iter->value().ToString());
+	iter->Next();
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+
+	ASSERT_GT(mem->ApproximateMemoryUsage(), 0);
+	mem->Unref();
+}
+
+TEST(MemTableTest, HashIndexRepAddAndGet) {
+	// Few buckets, so that most lookups walk past other keys
+	options_.memtable_rep = kHashIndexRep;
+	options_.memtable_hash_bucket_count = 3;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "foo", "v1");
+	mem->Add(2, kTypeValue, "bar", "b1");
+	mem->Add(5, kTypeValue, "foo", "v3");
+	mem->Add(4, kTypeDeletion, "bar", "");
+	mem->Add(3, kTypeValue, "foo", "v2");
+	char key[100];
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		mem->Add(10 + i, kTypeValue, key, key);
+	}
+
+	ASSERT_EQ("MISSING", Get(mem, "foo", 0));
+	ASSERT_EQ("v1", Get(mem, "foo", 1));
+	ASSERT_EQ("v1", Get(mem, "foo", 2));
+	ASSERT_EQ("v2", Get(mem, "foo", 3));
+	ASSERT_EQ("v2", Get(mem, "foo", 4));
+	ASSERT_EQ("v3", Get(mem, "foo", kMaxSequenceNumber));
+	ASSERT_EQ("b1", Get(mem, "bar", 3));
+	ASSERT_EQ("DELETED", Get(mem, "bar", 4));
+	ASSERT_EQ("MISSING", Get(mem, "baz", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "k050", 59));
+	ASSERT_EQ("k050", Get(mem, "k050", 60));
+	ASSERT_EQ("k099", Get(mem, "k099", kMaxSequenceNumber));
+
+	// Iteration still comes from the ordered list
+	Iterator* iter = mem->NewIterator();
+	iter->Seek(LookupKey("foo", kMaxSequenceNumber).internal_key());
+	ASSERT_TRUE(iter->Valid());
+	ASSERT_EQ("v3", iter->value().ToString());
+	iter->Next();
+	ASSERT_EQ("v2", iter->value().ToString());
+	iter->Next();
+	ASSERT_EQ("v1", iter->value().ToString());
+	iter->Next();
+	ASSERT_EQ("k000", ExtractUserKey(iter->key()).ToString());
+	delete iter;
+	mem->Unref();
+}
+
+namespace {
+
+struct ConcurrentAddState {
+	MemTable* mem;
+	std::atomic<SequenceNumber> next_seq;
+	int num_per_thread;
+
+	port::Mutex mu;
+	port::CondVar cv;
+	int done;
+
+	ConcurrentAddState() : next_seq(1), cv(&mu), done(0) { }
+};
+
+struct ConcurrentAddThread {
+	ConcurrentAddState* state;
+	int id;
+};
+
+void ConcurrentAddBody(void* arg) {
+	ConcurrentAddThread* t = reinterpret_cast<ConcurrentAddThread*>(arg);
+	ConcurrentAddState* state = t->state;
+	char key[100];
+	for (int i = 0; i < state->num_per_thread; i++) {
+		snprintf(key, sizeof(key), "%04d.%06d", t->id, i);
+		state->mem->AddConcurrent(
+			state->next_seq.fetch_add(1, std::memory_order_relaxed),
+			kTypeValue, key, key);
+	}
+	state->mu.Lock();
+	state->done++;
+	state->cv.Signal();
+	state->mu.Unlock();
+}
+
+void CheckAddConcurrent(const InternalKeyComparator& icmp, Options options) {
+	const int kThreads = 4;
+	const int kNumPerThread = 5000;
+	options.allow_concurrent_memtable_write = true;
+	MemTable* mem = new MemTable(icmp, options);
+	mem->Ref();
+
+	ConcurrentAddState state;
+	state.mem = mem;
+	state.num_per_thread = kNumPerThread;
+	ConcurrentAddThread threads[kThreads];
+	for (int i = 0; i < kThreads; i++) {
+		threads[i].state = &state;
+		threads[i].id = i;
+		Env::Default()->StartThread(ConcurrentAddBody, &threads[i]);
+	}
+	state.mu.Lock();
+	while (state.done < kThreads) {
+		state.cv.Wait();
+	}
+	state.mu.Unlock();
+
+	// Every key must be present exactly once and in order
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	char key[100];
+	for (int t = 0; t < kThreads; t++) {
+		for (int i = 0; i < kNumPerThread; i++) {
+			snprintf(key, sizeof(key), "%04d.%06d", t, i);
+			ASSERT_TRUE(iter->Valid());
+			ASSERT_EQ(std::string(key), ExtractUserKey(iter->key()).ToString());
+			ASSERT_EQ(std::string(key), iter->value().ToString());
+			iter->Next();
+		}
+	}
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+
+	ASSERT_EQ("0002.000042", Get(mem, "0002.000042", kMaxSequenceNumber));
+	mem->Unref();
+}
+
+}  // namespace
+
+TEST(MemTableTest, AddConcurrent) {
+	CheckAddConcurrent(icmp_, options_);
+}
+
+TEST(MemTableTest, HashIndexRepAddConcurrent) {
+	options_.memtable_rep = kHashIndexRep;
+	options_.memtable_hash_bucket_count = 1000;
+	CheckAddConcurrent(icmp_, options_);
+}
+
+TEST(MemTableTest, HugePageArenaBlocks) {
+	options_.arena_block_size = 1 << 20;
+	options_.memtable_huge_page_size = 2 << 20;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	char key[100];
+	for (int i = 0; i < 10000; i++) {
+		snprintf(key, sizeof(key), "%06d", i);
+		mem->Add(i + 1, kTypeValue, key, key);
+	}
+	ASSERT_GE(mem->ApproximateMemoryUsage(), 2 << 20);
+	ASSERT_EQ("004242", Get(mem, "004242", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "010000", kMaxSequenceNumber));
+	mem->Unref();
+}
+
+TEST(MemTableTest, WriteBufferManager) {
+	WriteBufferManager manager(1 << 20);
+	options_.write_buffer_manager = &manager;
+	MemTable* mem1 = new MemTable(icmp_, options_);
+	mem1->Ref();
+	MemTable* mem2 = new MemTable(icmp_, options_);
+	mem2->Ref();
+
+	// Both memtables count against the one budget
+	std::string value(100, 'v');
+	char key[100];
+	int i = 0;
+	while (!manager.ShouldFlush()) {
+		snprintf(key, sizeof(key), "%06d", i);
+		mem1->Add(i + 1, kTypeValue, key, value);
+		mem2->Add(i + 1, kTypeValue, key, value);
+		ASSERT_EQ(mem1->ApproximateMemoryUsage() + mem2->ApproximateMemoryUsage(),
+			manager.memory_usage());
+		i++;
+	}
+	ASSERT_GE(manager.memory_usage(), 1 << 20);
+	ASSERT_LT(mem1->ApproximateMemoryUsage(), 1 << 20);
+
+	// Flushing one of them frees its share
+	const size_t mem2_usage = mem2->ApproximateMemoryUsage();
+	mem1->Unref();
+	ASSERT_EQ(mem2_usage, manager.memory_usage());
+	ASSERT_TRUE(!manager.ShouldFlush());
+	mem2->Unref();
+	ASSERT_EQ(0, manager.memory_usage());
+}
+
+namespace {
+
+// Orders user keys by descending bytes, so memtable key prefixes do not
+// agree with the comparator and must not be used.
+class ReverseBytewiseComparator : public Comparator {
+public:
+	virtual const char* Name() const { return "test.ReverseBytewiseComparator"; }
+	virtual int Compare(const Slice& a, const Slice& b) const {
+		return -a.compare(b);
+	}
+	virtual void FindShortestSeparator(std::string* start,
+		const Slice& limit) const { }
+	virtual void FindShortSuccessor(std::string* key) const { }
+};
+
+// Ignores the case of ASCII letters, so equal user keys can differ in
+// their bytes.
+class CaseInsensitiveComparator : public Comparator {
+public:
+	virtual const char* Name() const { return "test.CaseInsensitiveComparator"; }
+	virtual int Compare(const Slice& a, const Slice& b) const {
+		const size_t n = std::min(a.size(), b.size());
+		for (size_t i = 0; i < n; i++) {
+			const int x = tolower(static_cast<unsigned char>(a[i]));
+			const int y = tolower(static_cast<unsigned char>(b[i]));
+			if (x != y) {
+				return x < y ? -1 : +1;
+			}
+		}
+		return a.size() < b.size() ? -1 : (a.size() > b.size() ? +1 : 0);
+	}
+	virtual void FindShortestSeparator(std::string* start,
+		const Slice& limit) const { }
+	virtual void FindShortSuccessor(std::string* key) const { }
+};
+
+// Keys whose order is decided at, before and after the 8-byte prefix,
+// including keys shorter than the prefix and embedded zero bytes.
+std::vector<std::string> PrefixEdgeKeys() {
+	std::vector<std::string> keys;
+	keys.push_back("");
+	keys.push_back("a");
+	keys.push_back(std::string("a\0", 2));
+	keys.push_back(std::string("a\0\1", 3));
+	keys.push_back("ab");
+	keys.push_back("abcdefg");
+	keys.push_back("abcdefgh");
+	keys.push_back(std::string("abcdefgh\0", 9));
+	keys.push_back("abcdefghi");
+	keys.push_back("abcdefghij");
+	keys.push_back("abcdefgi");
+	keys.push_back("\xff\xff\xff\xff\xff\xff\xff\xff");
+	keys.push_back("\xff\xff\xff\xff\xff\xff\xff\xff\xff");
+	keys.push_back("\x80");
+	return keys;
+}
+
+void CheckPrefixEdgeKeys(const Comparator* user_comparator) {
+	std::vector<std::string> keys = PrefixEdgeKeys();
+	Options options;
+	MemTable* mem = new MemTable(InternalKeyComparator(user_comparator), options);
+	mem->Ref();
+	Random rnd(301);
+	for (int i = keys.size() - 1; i > 0; i--) {
+		std::swap(keys[i], keys[rnd.Uniform(i + 1)]);
+	}
+	for (size_t i = 0; i < keys.size(); i++) {
+		mem->Add(i + 1, kTypeValue, keys[i], keys[i]);
+	}
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_EQ(keys[i], Get(mem, keys[i], kMaxSequenceNumber));
+	}
+
+	std::sort(keys.begin(), keys.end(),
+		[user_comparator](const std::string& a, const std::string& b) {
+			return user_comparator->Compare(a, b) < 0;
+		});
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	for (size_t i = 0; i < keys.size(); i++) {
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(keys[i], ExtractUserKey(iter->key()).ToString());
+		iter->Next();
+	}
+	ASSERT_TRUE(!iter->Valid());
+	for (size_t i = 0; i < keys.size(); i++) {
+		iter->Seek(LookupKey(keys[i], kMaxSequenceNumber).internal_key());
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(keys[i], ExtractUserKey(iter->key()).ToString());
+	}
+	delete iter;
+	mem->Unref();
+}
+
+}  // namespace
+
+TEST(MemTableTest, PrefixFingerprintOrdering) {
+	CheckPrefixEdgeKeys(BytewiseComparator());
+}
+
+TEST(MemTableTest, NonBytewiseComparatorIgnoresPrefix) {
+	ReverseBytewiseComparator cmp;
+	CheckPrefixEdgeKeys(&cmp);
+}
+
+TEST(MemTableTest, HashIndexRepNonBytewiseComparator) {
+	// The hash index would miss keys that only compare equal
+	CaseInsensitiveComparator cmp;
+	Options options;
+	options.memtable_rep = kHashIndexRep;
+	MemTable* mem = new MemTable(InternalKeyComparator(&cmp), options);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "Foo", "v1");
+	mem->Add(2, kTypeValue, "BAR", "b1");
+	ASSERT_EQ("v1", Get(mem, "foo", kMaxSequenceNumber));
+	ASSERT_EQ("v1", Get(mem, "FOO", kMaxSequenceNumber));
+	ASSERT_EQ("b1", Get(mem, "bar", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "baz", kMaxSequenceNumber));
+	mem->Unref();
+}
+
+TEST(MemTableTest, HashSkipListRepPrefixes) {
+	const SliceTransform* prefix_extractor = NewFixedPrefixTransform(4);
+	options_.memtable_rep = kHashSkipListRep;
+	options_.prefix_extractor = prefix_extractor;
+	options_.memtable_hash_bucket_count = 1000;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	// Tenants t000..t019, inserted interleaved, plus keys too short for
+	// the extractor
+	char key[100];
+	SequenceNumber seq = 1;
+	for (int i = 0; i < 50; i++) {
+		for (int t = 0; t < 20; t++) {
+			snprintf(key, sizeof(key), "t%03d.%04d", t, i);
+			mem->Add(seq++, kTypeValue, key, key);
+		}
+	}
+	mem->Add(seq++, kTypeValue, "t0", "short");
+	mem->Add(seq++, kTypeDeletion, "t005.0007", "");
+
+	ASSERT_EQ("t013.0042", Get(mem, "t013.0042", kMaxSequenceNumber));
+	ASSERT_EQ("DELETED", Get(mem, "t005.0007", kMaxSequenceNumber));
+	ASSERT_EQ("t005.0007", Get(mem, "t005.0007", seq - 3));
+	ASSERT_EQ("short", Get(mem, "t0", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "t013.0050", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "t999.0000", kMaxSequenceNumber));
+
+	// A full iteration sees every entry in order
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	ASSERT_EQ("t0", ExtractUserKey(iter->key()).ToString());
+	iter->Next();
+	for (int t = 0; t < 20; t++) {
+		for (int i = 0; i < 50; i++) {
+			snprintf(key, sizeof(key), "t%03d.%04d", t, i);
+			ASSERT_TRUE(iter->Valid());
+			ASSERT_EQ(std::string(key), ExtractUserKey(iter->key()).ToString());
+			iter->Next();
+			if (t == 5 && i == 7) {
+				// The deletion is newer, so it comes first
+				ASSERT_EQ(std::string(key), ExtractUserKey(iter->key()).ToString());
+				iter->Next();
+			}
+		}
+	}
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+
+	// A prefix iteration sees one tenant in order
+	iter = mem->NewPrefixIterator();
+	ASSERT_TRUE(!iter->Valid());
+	iter->Seek(LookupKey("t007.0010", kMaxSequenceNumber).internal_key());
+	for (int i = 10; i < 50; i++) {
+		snprintf(key, sizeof(key), "t007.%04d", i);
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(std::string(key), ExtractUserKey(iter->key()).ToString());
+		iter->Next();
+	}
+	ASSERT_TRUE(!iter->Valid() ||
+		!ExtractUserKey(iter->key()).starts_with("t007"));
+	delete iter;
+
+	mem->Unref();
+	delete prefix_extractor;
+}
+
+TEST(MemTableTest, HashSkipListRepAddConcurrent) {
+	const SliceTransform* prefix_extractor = NewFixedPrefixTransform(2);
+	options_.memtable_rep = kHashSkipListRep;
+	options_.prefix_extractor = prefix_extractor;
+	CheckAddConcurrent(icmp_, options_);
+	delete prefix_extractor;
+}
+
+TEST(MemTableTest, VectorRepAddAndGet) {
+	options_.memtable_rep = kVectorRep;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "foo", "v1");
+	mem->Add(2, kTypeValue, "bar", "b1");
+	mem->Add(3, kTypeValue, "foo", "v2");
+	ASSERT_EQ("v1", Get(mem, "foo", 2));
+	ASSERT_EQ("b1", Get(mem, "bar", 3));
+
+	// Entries added after the vector was sorted are found as well
+	mem->Add(4, kTypeDeletion, "bar", "");
+	mem->Add(5, kTypeValue, "baz", "z1");
+	ASSERT_EQ("DELETED", Get(mem, "bar", 4));
+	ASSERT_EQ("b1", Get(mem, "bar", 3));
+	ASSERT_EQ("z1", Get(mem, "baz", 5));
+	ASSERT_EQ("v2", Get(mem, "foo", 5));
+	ASSERT_EQ("MISSING", Get(mem, "baa", 5));
+
+	// An iterator is not disturbed by later inserts
+	Iterator* iter = mem->NewIterator();
+	mem->Add(6, kTypeValue, "aaa", "a1");
+	iter->SeekToFirst();
+	ASSERT_EQ("bar", ExtractUserKey(iter->key()).ToString());
+	ASSERT_EQ(kTypeDeletion, ExtractValueType(iter->key()));
+	iter->SeekToLast();
+	ASSERT_EQ("v1", iter->value().ToString());
+	iter->Prev();
+	ASSERT_EQ("v2", iter->value().ToString());
+	iter->Seek(LookupKey("baz", kMaxSequenceNumber).internal_key());
+	ASSERT_EQ("z1", iter->value().ToString());
+	delete iter;
+	ASSERT_EQ("a1", Get(mem, "aaa", 6));
+	mem->Unref();
+}
+
+TEST(MemTableTest, VectorRepBulkLoad) {
+	// Enough entries to be sorted by several threads on multi-core hosts
+	const int N = 140000;
+	options_.memtable_rep = kVectorRep;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	Random rnd(301);
+	std::vector<int> order(N);
+	for (int i = 0; i < N; i++) {
+		order[i] = i;
+	}
+	for (int i = N - 1; i > 0; i--) {
+		std::swap(order[i], order[rnd.Uniform(i + 1)]);
+	}
+	char key[100];
+	for (int i = 0; i < N; i++) {
+		snprintf(key, sizeof(key), "%08d", order[i]);
+		mem->Add(i + 1, kTypeValue, key, key);
+	}
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	for (int i = 0; i < N; i++) {
+		snprintf(key, sizeof(key), "%08d", i);
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(std::string(key), iter->value().ToString());
+		iter->Next();
+	}
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+	mem->Unref();
+}
+
+TEST(MemTableTest, VectorRepAddConcurrent) {
+	options_.memtable_rep = kVectorRep;
+	CheckAddConcurrent(icmp_, options_);
+}
+
+TEST(MemTableTest, InlineSkipListRepAddAndGet) {
+	options_.memtable_rep = kInlineSkipListRep;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "foo", "v1");
+	mem->Add(2, kTypeValue, "bar", "b1");
+	mem->Add(3, kTypeValue, "foo", "v2");
+	mem->Add(4, kTypeDeletion, "bar", "");
+	mem->Add(5, kTypeRangeDeletion, "x", "z");
+	mem->Add(6, kTypeValue, "y", "y1");
+	ASSERT_EQ("v1", Get(mem, "foo", 2));
+	ASSERT_EQ("v2", Get(mem, "foo", 3));
+	ASSERT_EQ("b1", Get(mem, "bar", 3));
+	ASSERT_EQ("DELETED", Get(mem, "bar", 4));
+	ASSERT_EQ("MISSING", Get(mem, "baz", 10));
+	ASSERT_EQ("DELETED", Get(mem, "xx", 10));
+	ASSERT_EQ("y1", Get(mem, "y", 10));
+
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	ASSERT_EQ("bar", ExtractUserKey(iter->key()).ToString());
+	ASSERT_EQ(kTypeDeletion, ExtractValueType(iter->key()));
+	iter->SeekToLast();
+	ASSERT_EQ("y1", iter->value().ToString());
+	iter->Prev();
+	ASSERT_EQ("v1", iter->value().ToString());
+	iter->Prev();
+	ASSERT_EQ("v2", iter->value().ToString());
+	delete iter;
+	mem->Unref();
+}
+
+TEST(MemTableTest, InlineSkipListRepAddConcurrent) {
+	options_.memtable_rep = kInlineSkipListRep;
+	CheckAddConcurrent(icmp_, options_);
+}
+
+TEST(MemTableTest, AddBatch) {
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "k050", "old");
+
+	// An ascending run, a step back and another run
+	std::vector<std::string> keys;
+	char key[100];
+	for (int i = 0; i < 100; i += 2) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		keys.push_back(key);
+	}
+	for (int i = 1; i < 100; i += 2) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		keys.push_back(key);
+	}
+	std::vector<MemTable::BatchEntry> batch(keys.size());
+	for (size_t i = 0; i < keys.size(); i++) {
+		batch[i].type = kTypeValue;
+		batch[i].key = keys[i];
+		batch[i].value = keys[i];
+	}
+	batch[3].type = kTypeDeletion;
+	batch[3].value = Slice();
+	mem->AddBatch(10, batch.data(), batch.size());
+
+	ASSERT_EQ("old", Get(mem, "k050", 34));
+	ASSERT_EQ("k050", Get(mem, "k050", 35));
+	ASSERT_EQ("DELETED", Get(mem, "k006", kMaxSequenceNumber));
+	ASSERT_EQ("MISSING", Get(mem, "k006", 12));
+	ASSERT_EQ("k099", Get(mem, "k099", kMaxSequenceNumber));
+
+	Iterator* iter = mem->NewIterator();
+	iter->SeekToFirst();
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		ASSERT_TRUE(iter->Valid());
+		ASSERT_EQ(std::string(key), ExtractUserKey(iter->key()).ToString());
+		iter->Next();
+		if (i == 50) {
+			ASSERT_EQ("old", iter->value().ToString());
+			iter->Next();
+		}
+	}
+	ASSERT_TRUE(!iter->Valid());
+	delete iter;
+	mem->Unref();
+}
+
+TEST(MemTableTest, RangeDeletionGet) {
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "a", "va");
+	mem->Add(2, kTypeValue, "b", "vb");
+	mem->Add(3, kTypeRangeDeletion, "a", "c");
+	mem->Add(4, kTypeValue, "b", "vb2");
+	mem->Add(5, kTypeRangeDeletion, "b", "d");
+
+	ASSERT_EQ("va", Get(mem, "a", 2));
+	ASSERT_EQ("DELETED", Get(mem, "a", 3));
+	ASSERT_EQ("DELETED", Get(mem, "a", kMaxSequenceNumber));
+	ASSERT_EQ("vb", Get(mem, "b", 2));
+	ASSERT_EQ("DELETED", Get(mem, "b", 3));
+	ASSERT_EQ("vb2", Get(mem, "b", 4));
+	ASSERT_EQ("DELETED", Get(mem, "b", 5));
+	// No point entry, but a newer tombstone hides older tables
+	ASSERT_EQ("MISSING", Get(mem, "c", 4));
+	ASSERT_EQ("DELETED", Get(mem, "c", 5));
+	ASSERT_EQ("MISSING", Get(mem, "d", kMaxSequenceNumber));
+
+	// Tombstones are not returned by the point iterator
+	Iterator* iter = mem->NewIterator();
+	int count = 0;
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		ASSERT_EQ(kTypeValue, ExtractValueType(iter->key()));
+		count++;
+	}
+	ASSERT_EQ(3, count);
+	delete iter;
+	mem->Unref();
+}
+
+namespace {
+
+struct RangeDelReaderState {
+	MemTable* mem;
+	std::atomic<bool> stop;
+	port::Mutex mu;
+	port::CondVar cv;
+	int done;
+	bool ok;
+
+	RangeDelReaderState() : stop(false), cv(&mu), done(0), ok(true) { }
+};
+
+// Once a key reads as deleted it must stay deleted, whichever reader
+// rebuilt the tombstone fragments
+void RangeDelReaderBody(void* arg) {
+	RangeDelReaderState* state = reinterpret_cast<RangeDelReaderState*>(arg);
+	bool deleted[100] = { false };
+	Random rnd(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(&deleted)));
+	char key[100];
+	while (!state->stop.load(std::memory_order_acquire)) {
+		const int i = rnd.Uniform(100);
+		snprintf(key, sizeof(key), "k%03d", i);
+		const std::string value = Get(state->mem, key, kMaxSequenceNumber);
+		if (value == "DELETED") {
+			deleted[i] = true;
+		}
+		else if (deleted[i] || value != key) {
+			state->ok = false;
+		}
+	}
+	MutexLock l(&state->mu);
+	state->done++;
+	state->cv.Signal();
+}
+
+}  // namespace
+
+TEST(MemTableTest, RangeDeletionConcurrentReads) {
+	const int kReaders = 3;
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	char key[100];
+	char end[100];
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		mem->Add(i + 1, kTypeValue, key, key);
+	}
+
+	RangeDelReaderState state;
+	state.mem = mem;
+	for (int i = 0; i < kReaders; i++) {
+		Env::Default()->StartThread(RangeDelReaderBody, &state);
+	}
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		snprintf(end, sizeof(end), "k%03d", i + 1);
+		mem->Add(101 + i, kTypeRangeDeletion, key, end);
+		Env::Default()->SleepForMicroseconds(100);
+	}
+	state.stop.store(true, std::memory_order_release);
+	{
+		MutexLock l(&state.mu);
+		while (state.done < kReaders) {
+			state.cv.Wait();
+		}
+	}
+	ASSERT_TRUE(state.ok);
+	for (int i = 0; i < 100; i++) {
+		snprintf(key, sizeof(key), "k%03d", i);
+		ASSERT_EQ("DELETED", Get(mem, key, kMaxSequenceNumber));
+	}
+	mem->Unref();
+}
+
+TEST(MemTableTest, RangeDeletionIterator) {
+	MemTable* mem = new MemTable(icmp_, options_);
+	mem->Ref();
+	char key[10];
+	for (int i = 0; i < 20; i++) {
+		snprintf(key, sizeof(key), "k%02d", i);
+		mem->Add(i + 1, kTypeValue, key, key);
+	}
+	mem->Add(30, kTypeRangeDeletion, "k03", "k07");
+	mem->Add(31, kTypeRangeDeletion, "k05", "k10");
+	mem->Add(32, kTypeRangeDeletion, "k15", "k16");
+	mem->Add(33, kTypeValue, "k08", "new");
+
+	// Reads the user keys seen going forward, or backward
+	struct Scan {
+		static std::string Run(Iterator* iter, bool forward) {
+			std::string result;
+			if (forward) {
+				iter->SeekToFirst();
+			}
+			else {
+				iter->SeekToLast();
+			}
+			while (iter->Valid()) {
+				result += ExtractUserKey(iter->key()).ToString().substr(1) + " ";
+				if (forward) {
+					iter->Next();
+				}
+				else {
+					iter->Prev();
+				}
+			}
+			return result;
+		}
+	};
+
+	Iterator* iter = mem->NewIterator(kMaxSequenceNumber);
+	ASSERT_EQ("00 01 02 08 10 11 12 13 14 16 17 18 19 ", Scan::Run(iter, true));
+	ASSERT_EQ("19 18 17 16 14 13 12 11 10 08 02 01 00 ", Scan::Run(iter, false));
+	iter->Seek(InternalKey("k04", kMaxSequenceNumber, kValueTypeForSeek).Encode());
+	ASSERT_TRUE(iter->Valid());
+	ASSERT_EQ("new", iter->value().ToString());
+	delete iter;
+
+	// A snapshot older than some tombstones only sees the older ones;
+	// entries newer than the snapshot are still returned
+	iter = mem->NewIterator(30);
+	ASSERT_EQ("00 01 02 07 08 08 09 10 11 12 13 14 15 16 17 18 19 ",
+		Scan::Run(iter, true));
+	delete iter;
+	mem->Unref();
+}
+
+static std::string Fixed64(uint64_t n) {
+	std::string result;
+	PutFixed64(&result, n);
+	return result;
+}
+
+// Checks counters kept with merge operands in a memtable of options
+static void CheckMergeCounters(const InternalKeyComparator& icmp,
+	Options options) {
+	const MergeOperator* add = NewUInt64AddOperator();
+	options.merge_operator = add;
+	MemTable* mem = new MemTable(icmp, options);
+	mem->Ref();
+	mem->Add(1, kTypeValue, "base", Fixed64(10));
+	mem->Add(2, kTypeMerge, "base", Fixed64(1));
+	mem->Add(3, kTypeMerge, "base", Fixed64(2));
+	mem->Add(4, kTypeMerge, "fresh", Fixed64(5));
+	mem->Add(5, kTypeDeletion, "reset", "");
+	mem->Add(6, kTypeMerge, "reset", Fixed64(7));
+	mem->Add(7, kTypeMerge, "base", Fixed64(3));
+
+	ASSERT_EQ(Fixed64(10), Get(mem, "base", 1));
+	ASSERT_EQ(Fixed64(13), Get(mem, "base", 3));
+	ASSERT_EQ(Fixed64(16), Get(mem, "base", kMaxSequenceNumber));
+	ASSERT_EQ(Fixed64(5), Get(mem, "fresh", kMaxSequenceNumber));
+	ASSERT_EQ("DELETED", Get(mem, "reset", 5));
+	ASSERT_EQ(Fixed64(7), Get(mem, "reset", 6));
+
+	// With a merge context, operands without a base are left to the caller
+	MergeContext context;
+	std::string value;
+	Status s;
+	ASSERT_TRUE(!mem->Get(LookupKey("fresh", kMaxSequenceNumber), &value, &s,
+		&context));
+	ASSERT_EQ(1, context.size());
+	ASSERT_TRUE(mem->Get(LookupKey("base", kMaxSequenceNumber), &value, &s,
+		&context));
+	ASSERT_OK(s);
+	// The operand of "fresh" was applied on top of "base"
+	ASSERT_EQ(Fixed64(21), value);
+	mem->Unref();
+	delete add;
+}
+
+TEST(MemTableTest, MergeCounters) {
+	CheckMergeCounters(icmp_, options_);
+	Options options = options_;
+	options.memtable_rep = kHashIndexRep;
+	CheckMergeCounters(icmp_, options);
+	options.memtable_rep = kVectorRep;
+	CheckMergeCounters(icmp_, options);
+	options.memtable_rep = kInlineSkipListRep;
+	CheckMergeCounters(icmp_, options);
+}
+
+TEST(MemTableTest, MergeAcrossMemTables) {
+	const MergeOperator* append = NewStringAppendOperator(',');
+	Options options = options_;
+	options.merge_operator = append;
+	MemTable* older = new MemTable(icmp_, options);
+	older->Ref();
+	MemTable* newer = new MemTable(icmp_, options);
+	newer->Ref();
+	older->Add(1, kTypeValue, "list", "a");
+	older->Add(2, kTypeMerge, "list", "b");
+	newer->Add(3, kTypeMerge, "list", "c");
+	newer->Add(4, kTypeMerge, "list", "d");
+	newer->Add(5, kTypeRangeDeletion, "m", "n");
+	newer->Add(6, kTypeMerge, "mm", "x");
+
+	MergeContext context;
+	std::string value;
+	Status s;
+	LookupKey lkey("list", kMaxSequenceNumber);
+	ASSERT_TRUE(!newer->Get(lkey, &value, &s, &context));
+	// "c" and "d" were partially merged into one operand
+	ASSERT_EQ(1, context.size());
+	ASSERT_TRUE(older->Get(lkey, &value, &s, &context));
+	ASSERT_OK(s);
+	ASSERT_EQ("a,b,c,d", value);
+
+	// A range deletion below the operands acts as the base
+	context.Clear();
+	ASSERT_TRUE(newer->Get(LookupKey("mm", kMaxSequenceNumber), &value, &s,
+		&context));
+	ASSERT_OK(s);
+	ASSERT_EQ("x", value);
+
+	// Without a merge operator, operands cannot be read
+	Options plain = options_;
+	MemTable* mem = new MemTable(icmp_, plain);
+	mem->Ref();
+	mem->Add(1, kTypeMerge, "k", "v");
+	s = Status::OK();
+	ASSERT_TRUE(mem->Get(LookupKey("k", kMaxSequenceNumber), &value, &s));
+	ASSERT_TRUE(!s.ok() && !s.IsNotFound());
+	mem->Unref();
+
+	newer->Unref();
+	older->Unref();
+	delete append;
+}
+
+// Checks MultiGet() against Get() on a memtable of options
+static void CheckMultiGet(const InternalKeyComparator& icmp,
+	const Options& options) {
+	MemTable* mem = new MemTable(icmp, options);
+	mem->Ref();
+	char key[10];
+	for (int i = 0; i < 300; i += 2) {
+		snprintf(key, sizeof(key), "k%04d", i);
+		mem->Add(i + 1, kTypeValue, key, key);
+	}
+	mem->Add(1000, kTypeDeletion, "k0010", "");
+
+	const int n = 200;
+	std::vector<LookupKey*> keys;
+	for (int i = 0; i < n; i++) {
+		snprintf(key, sizeof(key), "k%04d", (i * 7) % 320);
+		keys.push_back(new LookupKey(key, (i % 3 == 0) ? 100 : kMaxSequenceNumber));
+	}
+	std::vector<std::string> values(n);
+	std::vector<Status> statuses(n);
+	bool found[n];
+	mem->MultiGet(&keys[0], n, &values[0], &statuses[0], found);
+	for (int i = 0; i < n; i++) {
+		std::string value;
+		Status s;
+		ASSERT_EQ(mem->Get(*keys[i], &value, &s), found[i]);
+		if (found[i]) {
+			ASSERT_EQ(s.ToString(), statuses[i].ToString());
+			ASSERT_EQ(value, values[i]);
+		}
+		delete keys[i];
+	}
+	mem->Unref();
+}
+
+TEST(MemTableTest, MultiGet) {
+	CheckMultiGet(icmp_, options_);
+	Options options = options_;
+	options.memtable_rep = kHashIndexRep;
+	CheckMultiGet(icmp_, options);
+	options.memtable_rep = kVectorRep;
+	CheckMultiGet(icmp_, options);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,78 @@
+#include "memtablerep.h"
+
+#include <algorithm>
+
+#include "coding.h"
+
+namespace leveldb {
+
+int MemTableRep::KeyComparator::operator()(const char* aptr, const char* bptr) const {
+	// Internal keys are encoded as length-prefixed strings.
+	uint32_t alen, blen;
+	const char* a = GetVarint32Ptr(aptr, aptr + 5, &alen);
+	const char* b = GetVarint32Ptr(bptr, bptr + 5, &blen);
+	return comparator.Compare(Slice(a, alen), Slice(b, blen));
+}
+
+namespace {
+
+class SortedVectorIterator : public MemTableRep::Iterator {
+public:
+	SortedVectorIterator(const MemTableRep::KeyComparator& cmp,
+		const std::vector<const char*>* entries, bool owned)
+		: cmp_(cmp), entries_(entries), owned_(owned), pos_(entries->size()) {
+	}
+
+	~SortedVectorIterator() override {
+		if (owned_) {
+			delete entries_;
+		}
+	}
+
+	bool Valid() const override { return pos_ < entries_->size(); }
+
+	const char* key() const override {
+		assert(Valid());
+		return (*entries_)[pos_];
+	}
+
+	void Next() override {
+		assert(Valid());
+		++pos_;
+	}
+
+	void Prev() override {
+		assert(Valid());
+		// Stepping before the first entry wraps to size(), which is invalid
+		pos_ = (pos_ == 0) ? entries_->size() : pos_ - 1;
+	}
+
+	void Seek(const char* target) override {
+		const MemTableRep::KeyComparator& cmp = cmp_;
+		pos_ = std::lower_bound(entries_->begin(), entries_->end(), target,
+			[&cmp](const char* a, const char* b) { return cmp(a, b) < 0; })
+			- entries_->begin();
+	}
+
+	void SeekToFirst() override { pos_ = 0; }
+
+	void SeekToLast() override {
+		pos_ = entries_->empty() ? 0 : entries_->size() - 1;
+	}
+
+private:
+	const MemTableRep::KeyComparator cmp_;
+	const std::vector<const char*>* const entries_;
+	const bool owned_;
+	size_t pos_;
+};
+
+}  // namespace
+
+MemTableRep::Iterator* NewSortedVectorIterator(
+	const MemTableRep::KeyComparator& cmp,
+	const std::vector<const char*>* entries, bool owned) {
+	return new SortedVectorIterator(cmp, entries, owned);
+}
+
+}  // namespace leveldb
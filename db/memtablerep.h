@@ -0,0 +1,173 @@
+#ifndef STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+#define STORAGE_LEVELDB_DB_MEMTABLEREP_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "allocator.h"
+#include "dbformat.h"
+#include "slice_transform.h"
+
+namespace leveldb {
+
+// MemTableRep is the in-memory data structure beneath a MemTable.  It
+// stores entries encoded by MemTable:
+//    klength  varint32
+//    userkey  char[klength-8]
+//    tag      uint64
+//    vlength  varint32
+//    value    char[vlength]
+// and hands them back in internal key order.  Entries live in memory
+// owned by the MemTable's allocator; a rep only keeps pointers to them.
+//
+// Insert() requires external synchronization, as for SkipList.  Reads
+// may run concurrently with one writer, or with several writers calling
+// InsertConcurrently().
+class MemTableRep {
+public:
+	// 比较两个编码后的entry，实际比较的是其中的InternalKey
+	struct KeyComparator {
+		const InternalKeyComparator comparator;
+		explicit KeyComparator(const InternalKeyComparator& c) : comparator(c) { }
+		// 这里可以看出来进行比较的已经不是Slice
+		// 而是一个buf，所以需要比较器解析buf
+		int operator()(const char* a, const char* b) const;
+	};
+
+	MemTableRep() { }
+	virtual ~MemTableRep() { }
+
+	// Return memory for an entry of "len" bytes that will be passed to
+	// Insert() or InsertConcurrently().  Reps that keep entries inside
+	// their own nodes hand out the space within a node; the default takes
+	// it from allocator, the allocator of the memtable.
+	virtual char* AllocateEntry(size_t len, Allocator* allocator) {
+		return allocator->Allocate(len);
+	}
+
+	// Insert entry into the rep.
+	// REQUIRES: nothing that compares equal to entry is in the rep.
+	virtual void Insert(const char* entry) = 0;
+
+	// Same as Insert(), but may be called from several threads at once.
+	virtual void InsertConcurrently(const char* entry) = 0;
+
+	// Insert entries[0,n-1], as if by Insert() in turn.  Reps may insert
+	// a sorted run faster than one entry at a time.
+	// REQUIRES: the entries are distinct and none is in the rep.
+	virtual void InsertBatch(const char* const* entries, size_t n) {
+		for (size_t i = 0; i < n; i++) {
+			Insert(entries[i]);
+		}
+	}
+
+	// "key" is a memtable key as built by LookupKey.  Return the first
+	// entry at or after key in internal key order, or nullptr if there is
+	// none.  A rep may also return nullptr instead of an entry for a
+	// different user key; the caller checks the user key.
+	virtual const char* Get(const char* key) const = 0;
+
+	// Store Get(keys[i]) in results[i] for each of keys[0,n-1].  Reps may
+	// overlap the memory accesses of the lookups.
+	virtual void MultiGet(const char* const* keys, size_t n,
+		const char** results) const {
+		for (size_t i = 0; i < n; i++) {
+			results[i] = Get(keys[i]);
+		}
+	}
+
+	// Bytes used by the rep beyond what it took from the allocator.
+	virtual size_t ApproximateMemoryUsage() const { return 0; }
+
+	// Iteration over the entries of a rep, in internal key order.
+	class Iterator {
+	public:
+		Iterator() { }
+		virtual ~Iterator() { }
+
+		virtual bool Valid() const = 0;
+
+		// Returns the entry at the current position.
+		// REQUIRES: Valid()
+		virtual const char* key() const = 0;
+
+		// REQUIRES: Valid()
+		virtual void Next() = 0;
+
+		// REQUIRES: Valid()
+		virtual void Prev() = 0;
+
+		// Advance to the first entry at or after the memtable key "target".
+		virtual void Seek(const char* target) = 0;
+
+		virtual void SeekToFirst() = 0;
+		virtual void SeekToLast() = 0;
+
+	private:
+		// No copying allowed
+		Iterator(const Iterator&);
+		void operator=(const Iterator&);
+	};
+
+	// Return a new iterator over the rep.  The caller must delete it
+	// before the rep is destroyed.
+	virtual Iterator* NewIterator() = 0;
+
+	// Return a new iterator that only needs to be correct for entries
+	// sharing the prefix of the last Seek() target.  It may stop early or
+	// yield other entries once it moves past them, and is invalid until
+	// the first Seek().  Reps that do not group entries by prefix return
+	// a full iterator.
+	virtual Iterator* NewPrefixIterator() { return NewIterator(); }
+
+private:
+	// No copying allowed
+	MemTableRep(const MemTableRep&);
+	void operator=(const MemTableRep&);
+};
+
+// A rep backed by a SkipList, ordered on every insert.  O(log n) inserts
+// and lookups.
+extern MemTableRep* NewSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator);
+
+// A skiplist whose nodes hold the entries themselves, right after their
+// links: no key pointer and no separate allocation per entry.  Tall
+// nodes are cache-line aligned, and the height of the list is chosen for
+// about "expected_entries" entries.
+extern MemTableRep* NewInlineSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, size_t expected_entries);
+
+// Returns an iterator over "*entries", which must be sorted by cmp.  If
+// "owned", the iterator deletes entries when it is destroyed; otherwise
+// entries must outlive the iterator.
+extern MemTableRep::Iterator* NewSortedVectorIterator(
+	const MemTableRep::KeyComparator& cmp,
+	const std::vector<const char*>* entries, bool owned);
+
+// A skiplist rep plus a hash index from user key to the entries for it,
+// so that Get() costs O(1) while iteration stays ordered.  "bucket_count"
+// fixed-size buckets are allocated up front from allocator.  The index
+// needs user keys that compare equal to be bytewise identical, so with a
+// user comparator other than BytewiseComparator() a plain skiplist rep is
+// returned instead.
+extern MemTableRep* NewHashIndexRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, size_t bucket_count);
+
+// Entries are hashed by prefix_extractor into "bucket_count" buckets,
+// each holding its own skiplist, so that Get() and prefix iteration only
+// search the entries sharing one prefix.  A full iterator sorts a copy
+// of all entries when created.
+extern MemTableRep* NewHashSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator, const SliceTransform* prefix_extractor,
+	size_t bucket_count);
+
+// Entries are appended to a vector, which is sorted (by several threads
+// if large) the first time it is read.  Inserts are O(1) and input that
+// arrives in order is never sorted; every iterator copies the vector.
+// Meant for bulk loads that are not read until the memtable is flushed.
+extern MemTableRep* NewVectorRep(const MemTableRep::KeyComparator& cmp);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MEMTABLEREP_H_
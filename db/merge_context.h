@@ -0,0 +1,65 @@
+#ifndef STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+#define STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
+
+#include <string>
+#include <vector>
+#include "merge_operator.h"
+#include "slice.h"
+
+namespace leveldb {
+
+// The merge operands of one key collected by a lookup that has not yet
+// reached the value below them.  A lookup that goes through several
+// memtables (or tables) passes the same MergeContext to each, newest
+// first, and resolves it once it finds a value, a deletion, or runs out
+// of sources.
+class MergeContext {
+public:
+	MergeContext() { }
+
+	bool empty() const { return operands_.empty(); }
+
+	// Number of operands kept, after partial merges.
+	size_t size() const { return operands_.size(); }
+
+	void Clear() { operands_.clear(); }
+
+	// Add an operand older than all the operands added so far.  It is
+	// combined with the oldest of them by merge_operator->PartialMerge()
+	// if possible, so that a stack of combinable operands takes one slot.
+	void PushOlderOperand(const MergeOperator* merge_operator,
+		const Slice& user_key, const Slice& operand) {
+		std::string combined;
+		if (!operands_.empty() &&
+			merge_operator->PartialMerge(user_key, operand, operands_.back(),
+				&combined)) {
+			operands_.back().swap(combined);
+		}
+		else {
+			operands_.push_back(operand.ToString());
+		}
+	}
+
+	// Apply the operands to base (NULL if the key has no value) and store
+	// the result in *value.  Returns false if the merge operator fails.
+	bool Resolve(const MergeOperator* merge_operator, const Slice& user_key,
+		const Slice* base, std::string* value) const {
+		std::vector<Slice> oldest_first;
+		oldest_first.reserve(operands_.size());
+		for (size_t i = operands_.size(); i > 0; i--) {
+			oldest_first.push_back(operands_[i - 1]);
+		}
+		return merge_operator->FullMerge(user_key, base, oldest_first, value);
+	}
+
+private:
+	std::vector<std::string> operands_;  // Newest first
+
+	// No copying allowed
+	MergeContext(const MergeContext&);
+	void operator=(const MergeContext&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_MERGE_CONTEXT_H_
@@ -0,0 +1,125 @@
+#include "range_tombstone.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace leveldb {
+
+namespace {
+
+struct Tombstone {
+	std::string start;
+	std::string end;
+	SequenceNumber seq;
+};
+
+}  // namespace
+
+FragmentedRangeTombstoneList::FragmentedRangeTombstoneList(Iterator* iter,
+	const Comparator* user_comparator)
+	: ucmp_(user_comparator) {
+	std::vector<Tombstone> tombstones;
+	std::vector<std::string> bounds;
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		ParsedInternalKey parsed;
+		if (!ParseInternalKey(iter->key(), &parsed) ||
+			parsed.type != kTypeRangeDeletion) {
+			continue;
+		}
+		if (ucmp_->Compare(parsed.user_key, iter->value()) >= 0) {
+			continue;  // Empty range
+		}
+		Tombstone t;
+		t.start = parsed.user_key.ToString();
+		t.end = iter->value().ToString();
+		t.seq = parsed.sequence;
+		bounds.push_back(t.start);
+		bounds.push_back(t.end);
+		tombstones.push_back(t);
+	}
+
+	const Comparator* ucmp = ucmp_;
+	auto less = [ucmp](const std::string& a, const std::string& b) {
+		return ucmp->Compare(a, b) < 0;
+	};
+	std::sort(bounds.begin(), bounds.end(), less);
+	bounds.erase(std::unique(bounds.begin(), bounds.end(),
+		[ucmp](const std::string& a, const std::string& b) {
+			return ucmp->Compare(a, b) == 0;
+		}), bounds.end());
+	std::sort(tombstones.begin(), tombstones.end(),
+		[&less](const Tombstone& a, const Tombstone& b) {
+			return less(a.start, b.start);
+		});
+
+	// Sweep over the bounds, keeping the tombstones spanning the gap
+	// between each bound and the next one
+	std::vector<const Tombstone*> active;
+	size_t next = 0;
+	for (size_t i = 0; i + 1 < bounds.size(); i++) {
+		while (next < tombstones.size() &&
+			ucmp_->Compare(tombstones[next].start, bounds[i]) == 0) {
+			active.push_back(&tombstones[next++]);
+		}
+		size_t kept = 0;
+		for (size_t j = 0; j < active.size(); j++) {
+			if (ucmp_->Compare(active[j]->end, bounds[i]) > 0) {
+				active[kept++] = active[j];
+			}
+		}
+		active.resize(kept);
+		if (active.empty()) {
+			continue;
+		}
+
+		Fragment f;
+		f.start = bounds[i];
+		f.end = bounds[i + 1];
+		for (size_t j = 0; j < active.size(); j++) {
+			f.seqs.push_back(active[j]->seq);
+		}
+		std::sort(f.seqs.begin(), f.seqs.end(), std::greater<SequenceNumber>());
+		f.seqs.erase(std::unique(f.seqs.begin(), f.seqs.end()), f.seqs.end());
+		fragments_.push_back(f);
+	}
+}
+
+int FragmentedRangeTombstoneList::Find(const Slice& user_key) const {
+	// Find the last fragment starting at or before user_key
+	int left = 0;
+	int right = static_cast<int>(fragments_.size());
+	while (left < right) {
+		int mid = left + (right - left) / 2;
+		if (ucmp_->Compare(fragments_[mid].start, user_key) <= 0) {
+			left = mid + 1;
+		}
+		else {
+			right = mid;
+		}
+	}
+	int i = left - 1;
+	return (i >= 0 && Contains(i, user_key)) ? i : -1;
+}
+
+bool FragmentedRangeTombstoneList::Contains(int i, const Slice& user_key) const {
+	const Fragment& f = fragments_[i];
+	return ucmp_->Compare(f.start, user_key) <= 0 &&
+		ucmp_->Compare(user_key, f.end) < 0;
+}
+
+SequenceNumber FragmentedRangeTombstoneList::MaxSeqAtOrBelow(int i,
+	SequenceNumber snapshot) const {
+	const std::vector<SequenceNumber>& seqs = fragments_[i].seqs;
+	// seqs is decreasing, so the first one at or below snapshot is the largest
+	std::vector<SequenceNumber>::const_iterator it = std::lower_bound(
+		seqs.begin(), seqs.end(), snapshot, std::greater<SequenceNumber>());
+	return it != seqs.end() ? *it : 0;
+}
+
+SequenceNumber FragmentedRangeTombstoneList::MaxCoveringTombstoneSeqnum(
+	const Slice& user_key, SequenceNumber snapshot) const {
+	int i = Find(user_key);
+	return i >= 0 ? MaxSeqAtOrBelow(i, snapshot) : 0;
+}
+
+}  // namespace leveldb
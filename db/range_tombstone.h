@@ -0,0 +1,68 @@
+#ifndef STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+#define STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
+
+#include <string>
+#include <vector>
+
+#include "dbformat.h"
+#include "iterator.h"
+
+namespace leveldb {
+
+// A set of range tombstones, split into non-overlapping fragments so that
+// the tombstones covering a key are found with one binary search.
+//
+// A tombstone [start, end) @ seq deletes every entry for a user key in
+// [start, end) with a sequence number below seq, for readers whose
+// snapshot is at or above seq.  Overlapping tombstones are cut at every
+// start and end key; each fragment lists the sequence numbers of all the
+// tombstones that span it.
+//
+// Immutable once built, so it may be shared by several readers.
+class FragmentedRangeTombstoneList {
+public:
+	struct Fragment {
+		std::string start;  // Inclusive
+		std::string end;    // Exclusive
+		std::vector<SequenceNumber> seqs;  // Distinct, in decreasing order
+	};
+
+	// Build from the tombstones yielded by *iter: key() is the internal
+	// key of the start (type kTypeRangeDeletion) and value() the end user
+	// key.  Does not take ownership of iter.
+	FragmentedRangeTombstoneList(Iterator* iter,
+		const Comparator* user_comparator);
+
+	bool empty() const { return fragments_.empty(); }
+	size_t size() const { return fragments_.size(); }
+	const Fragment& fragment(size_t i) const { return fragments_[i]; }
+
+	// Return the index of the fragment containing user_key, or -1 if no
+	// tombstone covers it.  O(log fragments)
+	int Find(const Slice& user_key) const;
+
+	// Return true if user_key lies in fragment(i).
+	bool Contains(int i, const Slice& user_key) const;
+
+	// Return the largest sequence number of the tombstones in fragment(i)
+	// that are visible at "snapshot", or 0 if there is none.
+	SequenceNumber MaxSeqAtOrBelow(int i, SequenceNumber snapshot) const;
+
+	// Return the largest sequence number of a tombstone that covers
+	// user_key and is visible at "snapshot", or 0 if there is none.  An
+	// entry for user_key with a lower sequence number is deleted.
+	SequenceNumber MaxCoveringTombstoneSeqnum(const Slice& user_key,
+		SequenceNumber snapshot) const;
+
+private:
+	const Comparator* const ucmp_;
+	std::vector<Fragment> fragments_;  // Sorted by start, non-overlapping
+
+	// No copying allowed
+	FragmentedRangeTombstoneList(const FragmentedRangeTombstoneList&);
+	void operator=(const FragmentedRangeTombstoneList&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_RANGE_TOMBSTONE_H_
@@ -0,0 +1,193 @@
+#include "range_tombstone.h"
+
+#include <string.h>
+#include <string>
+
+#include "comparator.h"
+#include "dbformat.h"
+#include "env.h"
+#include "iterator.h"
+#include "logging.h"
+#include "memtable.h"
+#include "options.h"
+#include "table.h"
+#include "table_builder.h"
+#include "testharness.h"
+
+namespace leveldb {
+
+// In-memory table file, written by TableBuilder and read back by Table
+class StringTableFile : public WritableFile, public RandomAccessFile {
+public:
+	std::string contents_;
+
+	virtual Status Append(const Slice& data) {
+		contents_.append(data.data(), data.size());
+		return Status::OK();
+	}
+	virtual Status Close() { return Status::OK(); }
+	virtual Status Flush() { return Status::OK(); }
+	virtual Status Sync() { return Status::OK(); }
+
+	virtual Status Read(uint64_t offset, size_t n, Slice* result,
+		char* scratch) const {
+		if (offset > contents_.size()) {
+			return Status::InvalidArgument("invalid Read offset");
+		}
+		if (offset + n > contents_.size()) {
+			n = contents_.size() - offset;
+		}
+		memcpy(scratch, contents_.data() + offset, n);
+		*result = Slice(scratch, n);
+		return Status::OK();
+	}
+};
+
+class RangeTombstoneTest {
+public:
+	InternalKeyComparator icmp_;
+	Options options_;
+	Options table_options_;  // For tables of internal keys
+	MemTable* mem_;
+
+	RangeTombstoneTest() : icmp_(BytewiseComparator()) {
+		table_options_.comparator = &icmp_;
+		mem_ = new MemTable(icmp_, options_);
+		mem_->Ref();
+	}
+
+	~RangeTombstoneTest() {
+		mem_->Unref();
+	}
+
+	void DeleteRange(SequenceNumber seq, const char* start, const char* end) {
+		mem_->Add(seq, kTypeRangeDeletion, start, end);
+	}
+
+	// Return the fragments as "[start,end)@seq,seq ..." strings
+	static std::string Dump(const FragmentedRangeTombstoneList& list) {
+		std::string result;
+		for (size_t i = 0; i < list.size(); i++) {
+			const FragmentedRangeTombstoneList::Fragment& f = list.fragment(i);
+			if (!result.empty()) {
+				result.push_back(' ');
+			}
+			result += "[" + f.start + "," + f.end + ")@";
+			for (size_t j = 0; j < f.seqs.size(); j++) {
+				if (j > 0) {
+					result.push_back(',');
+				}
+				result += NumberToString(f.seqs[j]);
+			}
+		}
+		return result;
+	}
+};
+
+TEST(RangeTombstoneTest, NoTombstones) {
+	ASSERT_TRUE(mem_->GetRangeTombstones() == nullptr);
+	Iterator* iter = mem_->NewRangeTombstoneIterator();
+	FragmentedRangeTombstoneList list(iter, BytewiseComparator());
+	delete iter;
+	ASSERT_TRUE(list.empty());
+	ASSERT_EQ(-1, list.Find("a"));
+}
+
+TEST(RangeTombstoneTest, Fragments) {
+	DeleteRange(5, "a", "e");
+	DeleteRange(9, "c", "g");
+	DeleteRange(7, "c", "d");
+	DeleteRange(3, "k", "m");
+	DeleteRange(4, "x", "x");  // Empty, ignored
+	std::shared_ptr<const FragmentedRangeTombstoneList> list =
+		mem_->GetRangeTombstones();
+	ASSERT_EQ("[a,c)@5 [c,d)@9,7,5 [d,e)@9,5 [e,g)@9 [k,m)@3", Dump(*list));
+
+	ASSERT_EQ(-1, list->Find("0"));
+	ASSERT_EQ(0, list->Find("a"));
+	ASSERT_EQ(1, list->Find("c"));
+	ASSERT_EQ(3, list->Find("f"));
+	ASSERT_EQ(-1, list->Find("g"));
+	ASSERT_EQ(-1, list->Find("h"));
+	ASSERT_EQ(4, list->Find("l"));
+	ASSERT_EQ(-1, list->Find("m"));
+
+	ASSERT_EQ(0, list->MaxCoveringTombstoneSeqnum("c", 4));
+	ASSERT_EQ(5, list->MaxCoveringTombstoneSeqnum("c", 6));
+	ASSERT_EQ(7, list->MaxCoveringTombstoneSeqnum("c", 8));
+	ASSERT_EQ(9, list->MaxCoveringTombstoneSeqnum("c", 100));
+	ASSERT_EQ(5, list->MaxCoveringTombstoneSeqnum("d", 8));
+	ASSERT_EQ(0, list->MaxCoveringTombstoneSeqnum("h", 100));
+
+	// The list is cached until another tombstone arrives
+	ASSERT_TRUE(list == mem_->GetRangeTombstones());
+	DeleteRange(10, "b", "c");
+	ASSERT_TRUE(list != mem_->GetRangeTombstones());
+	ASSERT_EQ("[a,b)@5 [b,c)@10,5 [c,d)@9,7,5 [d,e)@9,5 [e,g)@9 [k,m)@3",
+		Dump(*mem_->GetRangeTombstones()));
+}
+
+TEST(RangeTombstoneTest, PersistInTable) {
+	mem_->Add(1, kTypeValue, "b", "vb");
+	mem_->Add(2, kTypeValue, "d", "vd");
+	DeleteRange(3, "a", "c");
+	DeleteRange(4, "c", "e");
+
+	StringTableFile file;
+	TableBuilder builder(table_options_, &file);
+	Iterator* iter = mem_->NewIterator();
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		builder.Add(iter->key(), iter->value());
+	}
+	delete iter;
+	iter = mem_->NewRangeTombstoneIterator();
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		builder.AddTombstone(iter->key(), iter->value());
+	}
+	delete iter;
+	ASSERT_OK(builder.Finish());
+	ASSERT_EQ(2, builder.NumEntries());
+
+	Table* table = NULL;
+	ASSERT_OK(Table::Open(table_options_, &file, file.contents_.size(), &table));
+
+	// Tombstones stay out of the data blocks
+	iter = table->NewIterator(ReadOptions());
+	int count = 0;
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		ASSERT_EQ(kTypeValue, ExtractValueType(iter->key()));
+		count++;
+	}
+	ASSERT_EQ(2, count);
+	delete iter;
+
+	iter = table->NewRangeTombstoneIterator(ReadOptions());
+	FragmentedRangeTombstoneList list(iter, BytewiseComparator());
+	ASSERT_OK(iter->status());
+	delete iter;
+	ASSERT_EQ("[a,c)@3 [c,e)@4", Dump(list));
+	delete table;
+}
+
+TEST(RangeTombstoneTest, TableWithoutTombstones) {
+	mem_->Add(1, kTypeValue, "b", "vb");
+	StringTableFile file;
+	TableBuilder builder(table_options_, &file);
+	Iterator* iter = mem_->NewIterator();
+	for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+		builder.Add(iter->key(), iter->value());
+	}
+	delete iter;
+	ASSERT_OK(builder.Finish());
+
+	Table* table = NULL;
+	ASSERT_OK(Table::Open(table_options_, &file, file.contents_.size(), &table));
+	iter = table->NewRangeTombstoneIterator(ReadOptions());
+	iter->SeekToFirst();
+	ASSERT_TRUE(!iter->Valid());
+	ASSERT_OK(iter->status());
+	delete iter;
+	delete table;
+}
+
+}  // namespace leveldb
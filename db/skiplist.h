@@ -4,7 +4,12 @@
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// Writes via Insert(), InsertWithHint() and InsertBatch() require external
+// synchronization, most likely a mutex.
+// InsertConcurrently() can be safely called concurrently with reads and
+// with other concurrent inserts, provided the allocator passed to the
+// constructor is itself safe for concurrent use.  Mixing Insert() with
+// InsertConcurrently() still requires external synchronization.
 // Reads require a guarantee that the SkipList will not be destroyed
 // while the read is in progress.  Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -17,33 +22,41 @@
 //
 // (2) The contents of a Node except for the next/prev pointers are
 // immutable after the Node has been linked into the SkipList.
-// Only Insert() modifies the list, and it is careful to initialize
-// a node and use release-stores to publish the nodes in one or
-// more lists.
+// Only Insert() and InsertConcurrently() modify the list, and they are
+// careful to initialize a node and use release-stores (or successful
+// compare-and-swaps) to publish the nodes in one or more lists.
 //
 // ... prev vs. next pointer ordering ...
 
 #include <atomic>
 #include <cassert>
 #include <cstdlib>
+#include <functional>
+#include <thread>
 
-#include "arena.h"
+#include "allocator.h"
+#include "port.h"
 #include "random.h"
 
 namespace leveldb {
 
-class Arena;
-
 template <typename Key, class Comparator>
 class SkipList {
 private:
 	struct Node;
 
+	// 使用枚举类型定义skiplist最高高度
+	enum { kMaxHeight = 12 };
+
+	// Searches kept in flight by FindGreaterOrEqualBatch(), about the
+	// number of cache misses a core can have outstanding
+	enum { kMaxBatchSearches = 16 };
+
 public:
 	// Create a new SkipList object that will use "cmp" for comparing keys,
-	// and will allocate memory using "*arena".  Objects allocated in the arena
-	// must remain allocated for the lifetime of the skiplist object.
-	explicit SkipList(Comparator cmp, Arena* arena);
+	// and will allocate memory using "*allocator".  Objects allocated in the
+	// allocator must remain allocated for the lifetime of the skiplist object.
+	explicit SkipList(Comparator cmp, Allocator* allocator);
 
 	SkipList(const SkipList&) = delete;
 	SkipList& operator=(const SkipList&) = delete;
@@ -52,9 +65,54 @@ public:
 	// REQUIRES: nothing that compares equal to key is currently in the list.
 	void Insert(const Key& key);
 
+	// Like Insert(), but may be called by several threads at once.  Nodes
+	// are linked in with compare-and-swap, one level at a time from the
+	// bottom up, so concurrent readers always see a well-formed list.
+	// REQUIRES: nothing that compares equal to key is currently in the list.
+	// REQUIRES: the allocator supports concurrent allocation.
+	void InsertConcurrently(const Key& key);
+
+	// The splice of the previous InsertWithHint() ("finger").  A key
+	// that sorts just after the previously inserted one is linked in
+	// without searching the list from head_.  A Hint starts out empty and
+	// may only be used with one list.
+	class Hint {
+	public:
+		Hint() : height_(0) { }
+
+	private:
+		friend class SkipList;
+
+		int height_;  // Levels of prev_ and next_ that are filled in
+		Node* prev_[kMaxHeight];
+		Node* next_[kMaxHeight];
+	};
+
+	// Same as Insert(), but starts from the splice remembered in *hint and
+	// leaves the splice of key there.  Each key of an ascending run costs
+	// O(1) comparisons per level instead of a search from the top; a key
+	// elsewhere falls back to an ordinary search.
+	// REQUIRES: external synchronization, as for Insert().
+	// REQUIRES: nothing that compares equal to key is currently in the list.
+	void InsertWithHint(const Key& key, Hint* hint);
+
+	// Insert keys[0,n-1] with InsertWithHint(), sharing one Hint.  Fastest
+	// when the keys are sorted.
+	// REQUIRES: external synchronization, as for Insert().
+	// REQUIRES: the keys are distinct and none is currently in the list.
+	void InsertBatch(const Key* keys, size_t n);
+
 	// Returns true iff an entry that compares equal to key is in the list.
 	bool Contains(const Key& key) const;
 
+	// For each of keys[0,n-1], store in results[i] the first key in the
+	// list at or after it, or nullptr if there is none.  Up to
+	// kMaxBatchSearches searches advance in turn, one node each, and each
+	// prefetches the node it will compare against next, so that the cache
+	// misses of different searches overlap instead of stalling in series.
+	void FindGreaterOrEqualBatch(const Key* keys, size_t n,
+		const Key** results) const;
+
 	// Iteration over the contents of a skip list
 	class Iterator {
 	public:
@@ -95,15 +153,16 @@ public:
 	};
 
 private:
-	// 使用枚举类型定义skiplist最高高度
-	enum { kMaxHeight = 12 };
-
 	inline int GetMaxHeight() const {
 		return max_height_.load(std::memory_order_relaxed);
 	}
 
 	Node* NewNode(const Key& key, int height);
-	int RandomHeight();
+	int RandomHeight(Random* rnd);
+
+	// Per-thread generator used by InsertConcurrently(), since rnd_ may
+	// only be touched by one writer at a time.
+	static Random* ThreadLocalRandom();
 	bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
 
 	// Return true if key is greater than the data stored in "n"
@@ -124,18 +183,28 @@ private:
 	// Return head_ if list is empty.
 	Node* FindLast() const;
 
+	// Return true if key sorts strictly between prev and next, where
+	// head_ sorts before and nullptr after every key
+	bool SpliceContains(Node* prev, Node* next, const Key& key) const;
+
+	// Starting at "before", which must sort before key, walk "level" and
+	// store in *out_prev and *out_next the pair of adjacent nodes that key
+	// would be spliced between.
+	void FindSpliceForLevel(const Key& key, Node* before, int level,
+		Node** out_prev, Node** out_next) const;
+
 	// Immutable after construction
 	// 用户定制的比较器
 	Comparator const compare_;
-	// Arena used for allocations of nodes
-	// leveldb实现的简单的内存分配器
-	Arena* const arena_;
+	// Allocator used for allocations of nodes
+	// 结点内存的分配器，通常是leveldb实现的简单的Arena
+	Allocator* const allocator_;
 
 	// skiplist的前置哨兵结点
 	Node* const head_;
 
-	// Modified only by Insert().  Read racily by readers, but stale
-	// values are ok.
+	// Modified only by Insert() and InsertConcurrently().  Read racily by
+	// readers, but stale values are ok.
 	// 记录当前skiplist使用的最高高度
 	std::atomic<int> max_height_;  // Height of the entire list
 
@@ -179,6 +248,13 @@ struct SkipList<Key, Comparator>::Node {
 		next_[n].store(x, std::memory_order_relaxed);
 	}
 
+	// Atomically replace the link at level n with x if it still equals
+	// expected.  Used by InsertConcurrently() to publish x.
+	bool CASNext(int n, Node* expected, Node* x) {
+		assert(n >= 0);
+		return next_[n].compare_exchange_strong(expected, x);
+	}
+
 private:
 	// Array of length equal to the node height.  next_[0] is the lowest level link
 	// 当前结点的下一个结点数组
@@ -188,7 +264,7 @@ private:
 template <typename Key, class Comparator>
 typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::NewNode(
 	const Key& key, int height) {
-	char* const node_memory = arena_->AllocateAligned(
+	char* const node_memory = allocator_->AllocateAligned(
 		sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1));
 	return new (node_memory) Node(key);
 }
@@ -247,7 +323,7 @@ inline void SkipList<Key, Comparator>::Iterator::SeekToLast() {
 
 // 用随机数获取要插入的节点的高度
 template <typename Key, class Comparator>
-int SkipList<Key, Comparator>::RandomHeight() {
+int SkipList<Key, Comparator>::RandomHeight(Random* rnd) {
 	// Increase height with probability 1 in kBranching
 	static const unsigned int kBranching = 4;
 	int height = 1;
@@ -255,7 +331,7 @@ int SkipList<Key, Comparator>::RandomHeight() {
 	// 如果我们得到一个随机值，直接对 kMaxHeight 取模加 1，然后赋值给 height，那么 height 在 [1~12] 之前出现的概率一样的
 	// 如果节点个数为 n，那么有 12 层的节点有 n/12 个，11 层的有 n/12+n/12(需要把12层的也加上)，节点太多，最上层平均前进一次才右移 12 个节点，下面层就更不用说了，效率低；
 	// 作者的方法是每一层会按照4的倍数减少，出现4层的概率只有出现3层概率的1/4，这样查询起来效率就提高了
-	while (height < kMaxHeight && ((rnd_.Next() % kBranching) == 0)) {
+	while (height < kMaxHeight && ((rnd->Next() % kBranching) == 0)) {
 		height++;
 	}
 	assert(height > 0);
@@ -263,6 +339,14 @@ int SkipList<Key, Comparator>::RandomHeight() {
 	return height;
 }
 
+template <typename Key, class Comparator>
+Random* SkipList<Key, Comparator>::ThreadLocalRandom() {
+	// Seed must stay within [1, 2^31-2], see Random
+	static thread_local Random rnd(static_cast<uint32_t>(
+		std::hash<std::thread::id>()(std::this_thread::get_id()) % 0x7ffffffeu) + 1);
+	return &rnd;
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::KeyIsAfterNode(const Key& key, Node* n) const {
 	// null n is considered infinite
@@ -349,10 +433,33 @@ typename SkipList<Key, Comparator>::Node* SkipList<Key, Comparator>::FindLast()
 }
 
 template <typename Key, class Comparator>
-SkipList<Key, Comparator>::SkipList(Comparator cmp, Arena* arena)
+void SkipList<Key, Comparator>::FindSpliceForLevel(const Key& key,
+	Node* before, int level, Node** out_prev, Node** out_next) const {
+	while (true) {
+		Node* next = before->Next(level);
+		if (KeyIsAfterNode(key, next)) {
+			before = next;
+		}
+		else {
+			*out_prev = before;
+			*out_next = next;
+			return;
+		}
+	}
+}
+
+template <typename Key, class Comparator>
+bool SkipList<Key, Comparator>::SpliceContains(Node* prev, Node* next,
+	const Key& key) const {
+	return (prev == head_ || compare_(prev->key, key) < 0) &&
+		(next == nullptr || compare_(key, next->key) < 0);
+}
+
+template <typename Key, class Comparator>
+SkipList<Key, Comparator>::SkipList(Comparator cmp, Allocator* allocator)
 	: compare_(cmp),
-	arena_(arena),
-	head_(NewNode(0 /* any key will do */, kMaxHeight)),
+	allocator_(allocator),
+	head_(NewNode(Key() /* any key will do */, kMaxHeight)),
 	max_height_(1),
 	rnd_(0xdeadbeef) {
 	for (int i = 0; i < kMaxHeight; i++) {
@@ -373,7 +480,7 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
 	assert(x == nullptr || !Equal(key, x->key));
 
 	// 使用随机数获取该结点的插入高度
-	int height = RandomHeight();
+	int height = RandomHeight(&rnd_);
 	if (height > GetMaxHeight()) {
 		// 大于当前skiplist最高高度的话，将多出来的高度的prev设置为哨兵结点
 		for (int i = GetMaxHeight(); i < height; i++) {
@@ -401,6 +508,113 @@ void SkipList<Key, Comparator>::Insert(const Key& key) {
 	}
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertConcurrently(const Key& key) {
+	int height = RandomHeight(ThreadLocalRandom());
+	Node* x = NewNode(key, height);
+
+	// Raise max_height_ if needed.  Readers that see the new height before
+	// the upper levels of head_ are linked simply drop down a level, exactly
+	// as in Insert().
+	int max_height = GetMaxHeight();
+	while (height > max_height) {
+		if (max_height_.compare_exchange_weak(max_height, height)) {
+			max_height = height;
+			break;
+		}
+	}
+
+	// Compute the splice for every level, top-down, so that each level's
+	// search starts from the node found on the level above.
+	Node* prev[kMaxHeight];
+	Node* next[kMaxHeight];
+	Node* before = head_;
+	for (int i = max_height - 1; i >= 0; i--) {
+		FindSpliceForLevel(key, before, i, &prev[i], &next[i]);
+		before = prev[i];
+	}
+
+	// Our data structure does not allow duplicate insertion
+	assert(next[0] == nullptr || !Equal(key, next[0]->key));
+
+	// Link x in from the bottom up.  Once level 0 is published x is
+	// visible to readers; the upper levels only speed up searches.  If a
+	// concurrent insert changed prev[i] underneath us the CAS fails and we
+	// recompute the splice for that level, starting from prev[i] which is
+	// still known to sort before key since nodes are never removed.
+	for (int i = 0; i < height; i++) {
+		while (true) {
+			x->NoBarrier_SetNext(i, next[i]);
+			if (prev[i]->CASNext(i, next[i], x)) {
+				break;
+			}
+			FindSpliceForLevel(key, prev[i], i, &prev[i], &next[i]);
+		}
+	}
+}
+
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertWithHint(const Key& key, Hint* hint) {
+	int height = RandomHeight(&rnd_);
+	int max_height = GetMaxHeight();
+	if (height > max_height) {
+		// Safe without synchronization, see Insert()
+		max_height_.store(height, std::memory_order_relaxed);
+		max_height = height;
+	}
+	// Levels the hint has not seen yet span the whole level
+	for (int i = hint->height_; i < max_height; i++) {
+		hint->prev_[i] = head_;
+		hint->next_[i] = nullptr;
+	}
+	hint->height_ = max_height;
+
+	// Find the lowest level whose remembered splice still brackets key.
+	// Splices nest, so every level above it brackets key as well.
+	int level = 0;
+	while (level < max_height &&
+		!SpliceContains(hint->prev_[level], hint->next_[level], key)) {
+		level++;
+	}
+
+	// From that level up each search starts at the remembered prev, which
+	// sorts before key; walking from there also picks up nodes inserted
+	// since by Insert().  Below it, and wherever the remembered prev is
+	// head_ (a fresh hint), the search descends from the level above, as
+	// in FindGreaterOrEqual().
+	for (int i = max_height - 1; i >= 0; i--) {
+		Node* before;
+		if (i >= level && hint->prev_[i] != head_) {
+			before = hint->prev_[i];
+		}
+		else {
+			before = (i + 1 < max_height) ? hint->prev_[i + 1] : head_;
+		}
+		FindSpliceForLevel(key, before, i, &hint->prev_[i], &hint->next_[i]);
+	}
+
+	// Our data structure does not allow duplicate insertion
+	assert(hint->next_[0] == nullptr || !Equal(key, hint->next_[0]->key));
+
+	Node* x = NewNode(key, height);
+	for (int i = 0; i < height; i++) {
+		// NoBarrier_SetNext() suffices since we will add a barrier when
+		// we publish a pointer to "x" in prev[i].
+		x->NoBarrier_SetNext(i, hint->next_[i]);
+		hint->prev_[i]->SetNext(i, x);
+		// The next key of an ascending run goes right after x
+		hint->prev_[i] = x;
+	}
+}
+
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::InsertBatch(const Key* keys, size_t n) {
+	Hint hint;
+	for (size_t i = 0; i < n; i++) {
+		InsertWithHint(keys[i], &hint);
+	}
+}
+
 template <typename Key, class Comparator>
 bool SkipList<Key, Comparator>::Contains(const Key& key) const {
 	Node* x = FindGreaterOrEqual(key, nullptr);
@@ -412,6 +626,70 @@ bool SkipList<Key, Comparator>::Contains(const Key& key) const {
 	}
 }
 
+template <typename Key, class Comparator>
+void SkipList<Key, Comparator>::FindGreaterOrEqualBatch(const Key* keys,
+	size_t n, const Key** results) const {
+	// One FindGreaterOrEqual() descent, suspended between steps
+	struct Search {
+		size_t index;  // Into keys and results
+		Node* x;       // Sorts before keys[index]
+		Node* next;    // x->Next(level), already prefetched
+		int level;
+	};
+	Search searches[kMaxBatchSearches];
+	const int top_level = GetMaxHeight() - 1;
+	Node* const top_next = head_->Next(top_level);
+	size_t started = 0;
+	int active = 0;
+	while (active < kMaxBatchSearches && started < n) {
+		Search& s = searches[active++];
+		s.index = started++;
+		s.x = head_;
+		s.next = top_next;
+		s.level = top_level;
+	}
+	if (top_next != nullptr) {
+		port::PrefetchForRead(top_next);
+	}
+
+	while (active > 0) {
+		// Take one step of every search in flight
+		int i = 0;
+		while (i < active) {
+			Search& s = searches[i];
+			if (KeyIsAfterNode(keys[s.index], s.next)) {
+				s.x = s.next;
+			}
+			else if (s.level > 0) {
+				s.level--;
+			}
+			else {
+				results[s.index] = (s.next != nullptr) ? &s.next->key : nullptr;
+				if (started < n) {
+					// Reuse the slot for the next key
+					s.index = started++;
+					s.x = head_;
+					s.level = top_level;
+					s.next = top_next;
+				}
+				else {
+					// Move the last search into the slot; it takes its
+					// step in this round
+					s = searches[--active];
+					continue;
+				}
+				i++;
+				continue;
+			}
+			s.next = s.x->Next(s.level);
+			if (s.next != nullptr) {
+				port::PrefetchForRead(s.next);
+			}
+			i++;
+		}
+	}
+}
+
 }  // namespace leveldb
 
 #endif // !STORAGE_LEVELDB_DB_SKIPLIST_H_
@@ -2,6 +2,7 @@
 
 #include <atomic>
 #include <set>
+#include <vector>
 
 #include "env.h"
 #include "port.h"
@@ -126,6 +127,170 @@ TEST(SkipTest, InsertAndLookup) {
 	}
 }
 
+TEST(SkipTest, InsertConcurrentlyAndLookup) {
+	// Exercise the CAS-based insert path from a single thread and check it
+	// against the same model as InsertAndLookup.
+	const int N = 2000;
+	const int R = 5000;
+	Random rnd(1000);
+	std::set<Key> keys;
+	Arena arena;
+	Comparator cmp;
+	SkipList<Key, Comparator> list(cmp, &arena);
+	for (int i = 0; i < N; i++) {
+		Key key = rnd.Next() % R;
+		if (keys.insert(key).second) {
+			list.InsertConcurrently(key);
+		}
+	}
+
+	for (int i = 0; i < R; i++) {
+		ASSERT_EQ(keys.count(i), list.Contains(i) ? 1 : 0);
+	}
+
+	SkipList<Key, Comparator>::Iterator iter(&list);
+	iter.SeekToFirst();
+	for (std::set<Key>::iterator model_iter = keys.begin();
+		model_iter != keys.end(); ++model_iter) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(*model_iter, iter.key());
+		iter.Next();
+	}
+	ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, InsertWithHintAndLookup) {
+	// Ascending runs, descending runs and random keys through one hint,
+	// interleaved with plain inserts that the hint does not know about.
+	const int R = 20000;
+	Random rnd(301);
+	std::set<Key> keys;
+	Arena arena;
+	Comparator cmp;
+	SkipList<Key, Comparator> list(cmp, &arena);
+	SkipList<Key, Comparator>::Hint hint;
+	for (int run = 0; run < 200; run++) {
+		Key start = rnd.Next() % R;
+		int len = 1 + rnd.Uniform(50);
+		int pattern = rnd.Uniform(4);
+		for (int i = 0; i < len; i++) {
+			Key key;
+			if (pattern == 0) {
+				key = start + i;
+			}
+			else if (pattern == 1) {
+				key = start + 10 * (len - i);
+			}
+			else {
+				key = rnd.Next() % R;
+			}
+			if (!keys.insert(key).second) {
+				continue;
+			}
+			if (pattern == 3 && rnd.OneIn(2)) {
+				list.Insert(key);
+			}
+			else {
+				list.InsertWithHint(key, &hint);
+			}
+		}
+	}
+
+	for (int i = 0; i < R + 600; i++) {
+		ASSERT_EQ(keys.count(i), list.Contains(i) ? 1 : 0);
+	}
+
+	SkipList<Key, Comparator>::Iterator iter(&list);
+	iter.SeekToFirst();
+	for (std::set<Key>::iterator model_iter = keys.begin();
+		model_iter != keys.end(); ++model_iter) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(*model_iter, iter.key());
+		iter.Next();
+	}
+	ASSERT_TRUE(!iter.Valid());
+
+	// Walking backwards checks the upper levels as well
+	iter.SeekToLast();
+	for (std::set<Key>::reverse_iterator model_iter = keys.rbegin();
+		model_iter != keys.rend(); ++model_iter) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(*model_iter, iter.key());
+		iter.Prev();
+	}
+	ASSERT_TRUE(!iter.Valid());
+}
+
+TEST(SkipTest, InsertBatchSorted) {
+	const int N = 10000;
+	Arena arena;
+	Comparator cmp;
+	SkipList<Key, Comparator> list(cmp, &arena);
+	std::vector<Key> batch;
+	for (int i = 0; i < N; i++) {
+		batch.push_back(2 * i);
+	}
+	list.InsertBatch(&batch[0], batch.size());
+	// A second batch that falls in between the first
+	for (int i = 0; i < N; i++) {
+		batch[i] = 2 * i + 1;
+	}
+	list.InsertBatch(&batch[0], batch.size());
+
+	SkipList<Key, Comparator>::Iterator iter(&list);
+	iter.SeekToFirst();
+	for (int i = 0; i < 2 * N; i++) {
+		ASSERT_TRUE(iter.Valid());
+		ASSERT_EQ(i, iter.key());
+		iter.Next();
+	}
+	ASSERT_TRUE(!iter.Valid());
+	iter.Seek(777);
+	ASSERT_EQ(777, iter.key());
+}
+
+TEST(SkipTest, FindGreaterOrEqualBatch) {
+	const int N = 2000;
+	const int R = 5000;
+	Random rnd(1000);
+	std::set<Key> keys;
+	Arena arena;
+	Comparator cmp;
+	SkipList<Key, Comparator> list(cmp, &arena);
+
+	std::vector<Key> targets;
+	std::vector<const Key*> results;
+	// An empty list finds nothing
+	targets.push_back(5);
+	results.resize(1);
+	list.FindGreaterOrEqualBatch(&targets[0], 1, &results[0]);
+	ASSERT_TRUE(results[0] == nullptr);
+
+	for (int i = 0; i < N; i++) {
+		Key key = rnd.Next() % R;
+		if (keys.insert(key).second) {
+			list.Insert(key);
+		}
+	}
+	// More targets than searches in flight, including some past the end
+	targets.clear();
+	for (int i = 0; i < 1000; i++) {
+		targets.push_back(rnd.Next() % (R + 100));
+	}
+	results.resize(targets.size());
+	list.FindGreaterOrEqualBatch(&targets[0], targets.size(), &results[0]);
+	for (size_t i = 0; i < targets.size(); i++) {
+		std::set<Key>::iterator model = keys.lower_bound(targets[i]);
+		if (model == keys.end()) {
+			ASSERT_TRUE(results[i] == nullptr);
+		}
+		else {
+			ASSERT_TRUE(results[i] != nullptr);
+			ASSERT_EQ(*model, *results[i]);
+		}
+	}
+}
+
 // We want to make sure that with a single writer and multiple
 // concurrent readers (with no synchronization other than when a
 // reader's iterator is created), the reader always observes all the
@@ -0,0 +1,135 @@
+#include "memtablerep.h"
+
+#include <algorithm>
+
+#include "coding.h"
+#include "comparator.h"
+#include "skiplist.h"
+
+namespace leveldb {
+
+namespace {
+
+// 跳跃表中存放的键：编码后的entry，以及用户键前8个字节组成的大端整数
+// 前缀直接存放在跳跃表节点中，多数比较只需比较前缀，
+// 不必访问entry所在的内存，也不必调用虚函数形式的比较器
+struct TableKey {
+	uint64_t prefix;
+	const char* entry;
+
+	TableKey() : prefix(0), entry(nullptr) { }
+
+	// "e" may be an entry or a memtable key; only its key is read
+	explicit TableKey(const char* e) : prefix(0), entry(e) {
+		uint32_t internal_key_size;
+		const char* p = GetVarint32Ptr(e, e + 5, &internal_key_size);
+		const size_t user_key_size = internal_key_size - 8;
+		const size_t n = user_key_size < 8 ? user_key_size : 8;
+		// Big-endian so that integer order matches bytewise order
+		for (size_t i = 0; i < n; i++) {
+			prefix |= static_cast<uint64_t>(static_cast<unsigned char>(p[i])) << (56 - 8 * i);
+		}
+	}
+};
+
+struct TableKeyComparator {
+	const MemTableRep::KeyComparator cmp;
+	// Only a bytewise user comparator orders keys the way their
+	// prefixes do; any other comparator always compares entries.
+	const bool use_prefix;
+
+	explicit TableKeyComparator(const MemTableRep::KeyComparator& c)
+		: cmp(c),
+		use_prefix(c.comparator.user_comparator() == BytewiseComparator()) {
+	}
+
+	int operator()(const TableKey& a, const TableKey& b) const {
+		// Keys whose prefixes differ are ordered by them, since
+		// zero-padding a short key never reorders it
+		if (use_prefix && a.prefix != b.prefix) {
+			return a.prefix < b.prefix ? -1 : +1;
+		}
+		return cmp(a.entry, b.entry);
+	}
+};
+
+class SkipListRep : public MemTableRep {
+private:
+	typedef SkipList<TableKey, TableKeyComparator> Table;
+
+public:
+	SkipListRep(const KeyComparator& cmp, Allocator* allocator)
+		: table_(TableKeyComparator(cmp), allocator) {
+	}
+
+	void Insert(const char* entry) override {
+		table_.Insert(TableKey(entry));
+	}
+
+	void InsertConcurrently(const char* entry) override {
+		table_.InsertConcurrently(TableKey(entry));
+	}
+
+	void InsertBatch(const char* const* entries, size_t n) override {
+		Table::Hint hint;
+		for (size_t i = 0; i < n; i++) {
+			table_.InsertWithHint(TableKey(entries[i]), &hint);
+		}
+	}
+
+	const char* Get(const char* key) const override {
+		Table::Iterator iter(&table_);
+		iter.Seek(TableKey(key));
+		return iter.Valid() ? iter.key().entry : nullptr;
+	}
+
+	void MultiGet(const char* const* keys, size_t n,
+		const char** results) const override {
+		// Keys are converted and looked up in chunks to stay on the stack
+		enum { kChunk = 64 };
+		TableKey table_keys[kChunk];
+		const TableKey* found[kChunk];
+		for (size_t start = 0; start < n; start += kChunk) {
+			const size_t m = std::min<size_t>(kChunk, n - start);
+			for (size_t i = 0; i < m; i++) {
+				table_keys[i] = TableKey(keys[start + i]);
+			}
+			table_.FindGreaterOrEqualBatch(table_keys, m, found);
+			for (size_t i = 0; i < m; i++) {
+				results[start + i] = (found[i] != nullptr) ? found[i]->entry : nullptr;
+			}
+		}
+	}
+
+	class Iterator : public MemTableRep::Iterator {
+	public:
+		explicit Iterator(const Table* table) : iter_(table) { }
+
+		bool Valid() const override { return iter_.Valid(); }
+		const char* key() const override { return iter_.key().entry; }
+		void Next() override { iter_.Next(); }
+		void Prev() override { iter_.Prev(); }
+		void Seek(const char* target) override { iter_.Seek(TableKey(target)); }
+		void SeekToFirst() override { iter_.SeekToFirst(); }
+		void SeekToLast() override { iter_.SeekToLast(); }
+
+	private:
+		Table::Iterator iter_;
+	};
+
+	MemTableRep::Iterator* NewIterator() override {
+		return new Iterator(&table_);
+	}
+
+private:
+	Table table_;
+};
+
+}  // namespace
+
+MemTableRep* NewSkipListRep(const MemTableRep::KeyComparator& cmp,
+	Allocator* allocator) {
+	return new SkipListRep(cmp, allocator);
+}
+
+}  // namespace leveldb
@@ -38,6 +38,12 @@ TableCache::~TableCache() {
 	delete cache_;
 }
 
+Status TableCache::NewTableFile(const std::string& fname,
+	RandomAccessFile** file) {
+	return options_->use_direct_reads ? env_->NewDirectRandomAccessFile(fname, file)
+		: env_->NewRandomAccessFile(fname, file);
+}
+
 Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 	Cache::Handle** handle) {
 	Status s;
@@ -53,11 +59,11 @@ Status TableCache::FindTable(uint64_t file_number, uint64_t file_size,
 		std::string fname = TableFileName(dbname_, file_number);
 		RandomAccessFile* file = NULL;
 		Table* table = NULL;
-		s = env_->NewRandomAccessFile(fname, &file);
+		s = NewTableFile(fname, &file);
 		if (!s.ok()) {
 			// 如果创建RandomAccess文件没有成功
 			std::string old_fname = SSTTableFileName(dbname_, file_number);
-			if (env_->NewRandomAccessFile(old_fname, &file).ok()) {
+			if (NewTableFile(old_fname, &file).ok()) {
 				s = Status::OK();
 			}
 		}
@@ -120,4 +126,25 @@ Status TableCache::Get(const ReadOptions& options,
 	return s;
 }
 
+void TableCache::MultiGet(const ReadOptions& options,
+	uint64_t file_number,
+	uint64_t file_size,
+	const Slice* keys,
+	size_t n,
+	Status* statuses,
+	void* arg,
+	void (*saver)(void*, size_t, const Slice&, const Slice&)) {
+	Cache::Handle* handle = NULL;
+	Status s = FindTable(file_number, file_size, &handle);
+	if (!s.ok()) {
+		for (size_t i = 0; i < n; i++) {
+			statuses[i] = s;
+		}
+		return;
+	}
+	Table* t = reinterpret_cast<TableAndFile*>(cache_->Value(handle))->table;
+	t->InternalMultiGet(options, keys, n, statuses, arg, saver);
+	cache_->Release(handle);
+}
+
 }  // namespace leveldb
\ No newline at end of file
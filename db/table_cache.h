@@ -40,6 +40,18 @@ public:
 		void* arg,
 		void (*handle_result)(void*, const Slice&, const Slice&));
 
+	// Look up keys[0,n-1] in the specified file as by Get(), calling
+	// (*handle_result)(arg, i, found_key, found_value) for keys[i] and
+	// storing the status of its lookup in statuses[i].
+	void MultiGet(const ReadOptions& options,
+		uint64_t file_number,
+		uint64_t file_size,
+		const Slice* keys,
+		size_t n,
+		Status* statuses,
+		void* arg,
+		void (*handle_result)(void*, size_t, const Slice&, const Slice&));
+
 	// Evict any entry for the specified file number
 	void Evict(uint64_t file_number);
 
@@ -50,6 +62,9 @@ private:
 	Cache* cache_;
 
 	Status FindTable(uint64_t file_number, uint64_t file_size, Cache::Handle**);
+
+	// Open a table file, with direct I/O if options_->use_direct_reads
+	Status NewTableFile(const std::string& fname, RandomAccessFile** file);
 };
 
 }  // namespace leveldb
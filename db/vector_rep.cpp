@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "memtablerep.h"
+#include "mutexlock.h"
+#include "port.h"
+#include "thread_annotations.h"
+
+namespace leveldb {
+
+namespace {
+
+// Below this many entries per thread a sort is not worth splitting
+const size_t kMinParallelSortRun = 1 << 16;
+
+// Sort "*v" with up to hardware_concurrency() threads: each sorts one
+// run, then neighbouring runs are merged pairwise, in parallel as well.
+template <typename Compare>
+void ParallelSort(std::vector<const char*>* v, Compare less) {
+	const size_t n = v->size();
+	size_t runs = std::thread::hardware_concurrency();
+	if (runs == 0) {
+		runs = 1;
+	}
+	runs = std::min(runs, n / kMinParallelSortRun);
+	if (runs <= 1) {
+		std::sort(v->begin(), v->end(), less);
+		return;
+	}
+
+	std::vector<size_t> bounds(runs + 1);
+	for (size_t i = 0; i <= runs; i++) {
+		bounds[i] = n * i / runs;
+	}
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < runs; i++) {
+		threads.emplace_back([v, &bounds, i, less]() {
+			std::sort(v->begin() + bounds[i], v->begin() + bounds[i + 1], less);
+		});
+	}
+	for (size_t i = 0; i < threads.size(); i++) {
+		threads[i].join();
+	}
+
+	// Merge runs [i, i + width) with [i + width, i + 2 * width)
+	for (size_t width = 1; width < runs; width *= 2) {
+		threads.clear();
+		for (size_t i = 0; i + width < runs; i += 2 * width) {
+			const size_t begin = bounds[i];
+			const size_t middle = bounds[i + width];
+			const size_t end = bounds[std::min(i + 2 * width, runs)];
+			threads.emplace_back([v, begin, middle, end, less]() {
+				std::inplace_merge(v->begin() + begin, v->begin() + middle,
+					v->begin() + end, less);
+			});
+		}
+		for (size_t i = 0; i < threads.size(); i++) {
+			threads[i].join();
+		}
+	}
+}
+
+class VectorRep : public MemTableRep {
+public:
+	explicit VectorRep(const KeyComparator& cmp)
+		: cmp_(cmp), sorted_(true), memory_usage_(0) {
+	}
+
+	void Insert(const char* entry) override {
+		MutexLock l(&mu_);
+		// Input that arrives in order never needs a sort
+		if (sorted_ && !entries_.empty() && cmp_(entries_.back(), entry) > 0) {
+			sorted_ = false;
+		}
+		entries_.push_back(entry);
+		memory_usage_.store(entries_.capacity() * sizeof(const char*),
+			std::memory_order_relaxed);
+	}
+
+	void InsertConcurrently(const char* entry) override {
+		Insert(entry);
+	}
+
+	const char* Get(const char* key) const override {
+		MutexLock l(&mu_);
+		SortLocked();
+		const KeyComparator& cmp = cmp_;
+		auto iter = std::lower_bound(entries_.begin(), entries_.end(), key,
+			[&cmp](const char* a, const char* b) { return cmp(a, b) < 0; });
+		return iter != entries_.end() ? *iter : nullptr;
+	}
+
+	size_t ApproximateMemoryUsage() const override {
+		return memory_usage_.load(std::memory_order_relaxed);
+	}
+
+	// Iterates over a sorted copy, so later inserts do not disturb it.
+	MemTableRep::Iterator* NewIterator() override {
+		MutexLock l(&mu_);
+		SortLocked();
+		return NewSortedVectorIterator(cmp_,
+			new std::vector<const char*>(entries_), true);
+	}
+
+private:
+	void SortLocked() const EXCLUSIVE_LOCKS_REQUIRED(mu_) {
+		if (!sorted_) {
+			const KeyComparator& cmp = cmp_;
+			ParallelSort(&entries_,
+				[&cmp](const char* a, const char* b) { return cmp(a, b) < 0; });
+			sorted_ = true;
+		}
+	}
+
+	const KeyComparator cmp_;
+	// Reads sort the entries in place, hence mutable
+	mutable port::Mutex mu_;
+	mutable std::vector<const char*> entries_ GUARDED_BY(mu_);
+	mutable bool sorted_ GUARDED_BY(mu_);
+	std::atomic<size_t> memory_usage_;
+};
+
+}  // namespace
+
+MemTableRep* NewVectorRep(const MemTableRep::KeyComparator& cmp) {
+	return new VectorRep(cmp);
+}
+
+}  // namespace leveldb
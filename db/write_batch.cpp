@@ -0,0 +1,209 @@
+// WriteBatch::rep_ :=
+//    sequence: fixed64
+//    count: fixed32
+//    data: record[count]
+// record :=
+//    kTypeValue varstring varstring         |
+//    kTypeDeletion varstring                |
+//    kTypeRangeDeletion varstring varstring |
+//    kTypeMerge varstring varstring
+// varstring :=
+//    len: varint32
+//    data: uint8[len]
+
+#include "write_batch.h"
+
+#include "coding.h"
+#include "dbformat.h"
+#include "memtable.h"
+#include "write_batch_internal.h"
+
+namespace leveldb {
+
+WriteBatch::WriteBatch() { Clear(); }
+
+WriteBatch::~WriteBatch() { }
+
+WriteBatch::Handler::~Handler() { }
+
+void WriteBatch::Clear() {
+	rep_.clear();
+	rep_.resize(WriteBatchInternal::kHeader);
+}
+
+size_t WriteBatch::ApproximateSize() const { return rep_.size(); }
+
+Status WriteBatch::Iterate(Handler* handler) const {
+	Slice input(rep_);
+	if (input.size() < WriteBatchInternal::kHeader) {
+		return Status::Corruption("malformed WriteBatch (too small)");
+	}
+
+	input.remove_prefix(WriteBatchInternal::kHeader);
+	Slice key, value;
+	int found = 0;
+	while (!input.empty()) {
+		found++;
+		char tag = input[0];
+		input.remove_prefix(1);
+		switch (tag) {
+		case kTypeValue:
+			if (GetLengthPrefixedSlice(&input, &key) &&
+				GetLengthPrefixedSlice(&input, &value)) {
+				handler->Put(key, value);
+			}
+			else {
+				return Status::Corruption("bad WriteBatch Put");
+			}
+			break;
+		case kTypeDeletion:
+			if (GetLengthPrefixedSlice(&input, &key)) {
+				handler->Delete(key);
+			}
+			else {
+				return Status::Corruption("bad WriteBatch Delete");
+			}
+			break;
+		case kTypeRangeDeletion:
+			if (GetLengthPrefixedSlice(&input, &key) &&
+				GetLengthPrefixedSlice(&input, &value)) {
+				handler->DeleteRange(key, value);
+			}
+			else {
+				return Status::Corruption("bad WriteBatch DeleteRange");
+			}
+			break;
+		case kTypeMerge:
+			if (GetLengthPrefixedSlice(&input, &key) &&
+				GetLengthPrefixedSlice(&input, &value)) {
+				handler->Merge(key, value);
+			}
+			else {
+				return Status::Corruption("bad WriteBatch Merge");
+			}
+			break;
+		default:
+			return Status::Corruption("unknown WriteBatch tag");
+		}
+	}
+	if (found != WriteBatchInternal::Count(this)) {
+		return Status::Corruption("WriteBatch has wrong count");
+	}
+	else {
+		return Status::OK();
+	}
+}
+
+int WriteBatchInternal::Count(const WriteBatch* b) {
+	return DecodeFixed32(b->rep_.data() + 8);
+}
+
+void WriteBatchInternal::SetCount(WriteBatch* b, int n) {
+	EncodeFixed32(&b->rep_[8], n);
+}
+
+SequenceNumber WriteBatchInternal::Sequence(const WriteBatch* b) {
+	return SequenceNumber(DecodeFixed64(b->rep_.data()));
+}
+
+void WriteBatchInternal::SetSequence(WriteBatch* b, SequenceNumber seq) {
+	EncodeFixed64(&b->rep_[0], seq);
+}
+
+void WriteBatch::Put(const Slice& key, const Slice& value) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	rep_.push_back(static_cast<char>(kTypeValue));
+	PutLengthPrefixedSlice(&rep_, key);
+	PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::Delete(const Slice& key) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	rep_.push_back(static_cast<char>(kTypeDeletion));
+	PutLengthPrefixedSlice(&rep_, key);
+}
+
+void WriteBatch::DeleteRange(const Slice& begin_key, const Slice& end_key) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	rep_.push_back(static_cast<char>(kTypeRangeDeletion));
+	PutLengthPrefixedSlice(&rep_, begin_key);
+	PutLengthPrefixedSlice(&rep_, end_key);
+}
+
+void WriteBatch::Merge(const Slice& key, const Slice& value) {
+	WriteBatchInternal::SetCount(this, WriteBatchInternal::Count(this) + 1);
+	rep_.push_back(static_cast<char>(kTypeMerge));
+	PutLengthPrefixedSlice(&rep_, key);
+	PutLengthPrefixedSlice(&rep_, value);
+}
+
+void WriteBatch::Append(const WriteBatch& source) {
+	WriteBatchInternal::Append(this, &source);
+}
+
+namespace {
+
+// 把batch中的每个操作转换成MemTable::AddBatch()的参数
+class EntryCollector : public WriteBatch::Handler {
+public:
+	std::vector<MemTable::BatchEntry>* entries_;
+
+	void Put(const Slice& key, const Slice& value) override {
+		Add(kTypeValue, key, value);
+	}
+	void Delete(const Slice& key) override {
+		Add(kTypeDeletion, key, Slice());
+	}
+	void DeleteRange(const Slice& begin_key, const Slice& end_key) override {
+		Add(kTypeRangeDeletion, begin_key, end_key);
+	}
+	void Merge(const Slice& key, const Slice& value) override {
+		Add(kTypeMerge, key, value);
+	}
+
+private:
+	void Add(ValueType type, const Slice& key, const Slice& value) {
+		MemTable::BatchEntry entry;
+		entry.type = type;
+		entry.key = key;
+		entry.value = value;
+		entries_->push_back(entry);
+	}
+};
+
+}  // namespace
+
+Status WriteBatchInternal::GetEntries(const WriteBatch* b,
+	std::vector<MemTable::BatchEntry>* entries) {
+	const size_t old_size = entries->size();
+	EntryCollector collector;
+	collector.entries_ = entries;
+	Status s = b->Iterate(&collector);
+	if (!s.ok()) {
+		entries->resize(old_size);
+	}
+	return s;
+}
+
+Status WriteBatchInternal::InsertInto(const WriteBatch* b,
+	MemTable* memtable) {
+	std::vector<MemTable::BatchEntry> entries;
+	Status s = GetEntries(b, &entries);
+	if (s.ok() && !entries.empty()) {
+		memtable->AddBatch(Sequence(b), entries.data(), entries.size());
+	}
+	return s;
+}
+
+void WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
+	assert(contents.size() >= kHeader);
+	b->rep_.assign(contents.data(), contents.size());
+}
+
+void WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src) {
+	SetCount(dst, Count(dst) + Count(src));
+	assert(src->rep_.size() >= kHeader);
+	dst->rep_.append(src->rep_.data() + kHeader, src->rep_.size() - kHeader);
+}
+
+}  // namespace leveldb
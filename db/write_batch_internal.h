@@ -0,0 +1,50 @@
+#ifndef STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
+#define STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
+
+#include <vector>
+#include "dbformat.h"
+#include "memtable.h"
+#include "write_batch.h"
+
+namespace leveldb {
+
+// WriteBatchInternal provides static methods for manipulating a
+// WriteBatch that we don't want in the public WriteBatch interface.
+class WriteBatchInternal {
+public:
+	// Size of the header of a batch: sequence number and count
+	static const size_t kHeader = 12;
+
+	// Return the number of entries in the batch.
+	static int Count(const WriteBatch* batch);
+
+	// Set the count for the number of entries in the batch.
+	static void SetCount(WriteBatch* batch, int n);
+
+	// Return the sequence number for the start of this batch.
+	static SequenceNumber Sequence(const WriteBatch* batch);
+
+	// Store the specified number as the sequence number for the start of
+	// this batch.
+	static void SetSequence(WriteBatch* batch, SequenceNumber seq);
+
+	static Slice Contents(const WriteBatch* batch) { return Slice(batch->rep_); }
+
+	static size_t ByteSize(const WriteBatch* batch) { return batch->rep_.size(); }
+
+	static void SetContents(WriteBatch* batch, const Slice& contents);
+
+	// Append the entries of the batch to *entries, in order.  They point
+	// into the batch, and get sequence numbers Sequence(batch),
+	// Sequence(batch)+1, ... when passed to MemTable::AddBatch().
+	static Status GetEntries(const WriteBatch* batch,
+		std::vector<MemTable::BatchEntry>* entries);
+
+	static Status InsertInto(const WriteBatch* batch, MemTable* memtable);
+
+	static void Append(WriteBatch* dst, const WriteBatch* src);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_DB_WRITE_BATCH_INTERNAL_H_
@@ -40,6 +40,7 @@ namespace leveldb {
 
 class FileLock;
 class Logger;
+class AlignedBufferPool;
 class RandomAccessFile;
 class SequentialFile;
 class Slice;
@@ -76,6 +77,14 @@ public:
 	virtual Status NewRandomAccessFile(const std::string& fname,
 		RandomAccessFile** result) = 0;
 
+	// Same as NewRandomAccessFile(), but reads bypass the operating
+	// system's cache where supported, so that the block cache is the only
+	// cache of the file's contents.
+	//
+	// The default implementation calls NewRandomAccessFile().
+	virtual Status NewDirectRandomAccessFile(const std::string& fname,
+		RandomAccessFile** result);
+
 	// Create an object that writes to a new file with the specified
 	// name.  Deletes any existing file with the same name and creates a
 	// new file.  On success, stores a pointer to the new file in
@@ -86,6 +95,15 @@ public:
 	virtual Status NewWritableFile(const std::string& fname,
 		WritableFile** result) = 0;
 
+	// Same as NewWritableFile(), but the data bypasses the operating
+	// system's cache where supported, so that writing large files does not
+	// evict cached data.  Until the file is closed, its size may include
+	// zero padding up to the alignment required for direct I/O.
+	//
+	// The default implementation calls NewWritableFile().
+	virtual Status NewDirectWritableFile(const std::string& fname,
+		WritableFile** result);
+
 	// Create an object that either appends to an existing file, or
 	// writes to a new file (if the file does not exist to begin with).
 	// On success, stores a pointer to the new file in *result and
@@ -101,6 +119,18 @@ public:
 	virtual Status NewAppendableFile(const std::string& fname,
 		WritableFile** result);
 
+	// Rename the existing file "old_fname" to "fname" and return an object
+	// that overwrites it from its start, keeping its size and allocated
+	// blocks.  Used to recycle log files, whose syncs then need not update
+	// the file size.  On failure stores NULL in *result and returns
+	// non-OK.
+	//
+	// The default implementation renames the file and truncates it with
+	// NewWritableFile().
+	virtual Status ReuseWritableFile(const std::string& fname,
+		const std::string& old_fname,
+		WritableFile** result);
+
 	// Returns true iff the named file exists.
 	virtual bool FileExists(const std::string& fname) = 0;
 
@@ -214,6 +244,17 @@ private:
 	void operator=(const SequentialFile&);
 };
 
+// One read of a RandomAccessFile::MultiRead() batch.
+struct ReadRequest {
+	uint64_t offset;
+	size_t len;
+	char* scratch;  // At least len bytes, used as by RandomAccessFile::Read()
+
+	// Set by MultiRead(), as by Read()
+	Slice result;
+	Status status;
+};
+
 // A file abstraction for randomly reading the contents of a file.
 class RandomAccessFile {
 public:
@@ -232,6 +273,23 @@ public:
 	virtual Status Read(uint64_t offset, size_t n, Slice* result,
 		char* scratch) const = 0;
 
+	// For files read with direct I/O, the pool of aligned buffers that
+	// Read() stages unaligned reads in, NULL otherwise.  A Read() whose
+	// offset, size and scratch are aligned to its alignment() goes
+	// straight to the device, so callers that read into buffers of the
+	// pool save a copy.
+	virtual AlignedBufferPool* aligned_buffer_pool() const { return NULL; }
+
+	// Perform the reads reqs[0,n-1], storing the outcome of each in its
+	// result and status.  Implementations may keep all of them in flight
+	// at once.  Returns non-OK if the batch as a whole failed, in which
+	// case every request holds that status too.
+	//
+	// The default implementation calls Read() for each request in turn.
+	//
+	// Safe for concurrent use by multiple threads.
+	virtual Status MultiRead(ReadRequest* reqs, size_t n) const;
+
 private:
 	// No copying allowed
 	RandomAccessFile(const RandomAccessFile&);
@@ -247,6 +305,16 @@ public:
 	virtual ~WritableFile();
 
 	virtual Status Append(const Slice& data) = 0;
+
+	// Append data[0,n-1] in order, as one gathered write where the file
+	// supports it.  The default implementation calls Append() for each.
+	virtual Status AppendV(const Slice* data, size_t n);
+
+	// Reserve disk space for the byte range [offset, offset + len) without
+	// changing the file size, so that appending to it later allocates no
+	// blocks.  Best effort: the default implementation does nothing.
+	virtual Status Allocate(uint64_t offset, uint64_t len);
+
 	virtual Status Close() = 0;
 	virtual Status Flush() = 0;
 	virtual Status Sync() = 0;
@@ -318,12 +386,22 @@ public:
 	Status NewRandomAccessFile(const std::string& f, RandomAccessFile** r) {
 		return target_->NewRandomAccessFile(f, r);
 	}
+	Status NewDirectRandomAccessFile(const std::string& f, RandomAccessFile** r) {
+		return target_->NewDirectRandomAccessFile(f, r);
+	}
 	Status NewWritableFile(const std::string& f, WritableFile** r) {
 		return target_->NewWritableFile(f, r);
 	}
 	Status NewAppendableFile(const std::string& f, WritableFile** r) {
 		return target_->NewAppendableFile(f, r);
 	}
+	Status NewDirectWritableFile(const std::string& f, WritableFile** r) {
+		return target_->NewDirectWritableFile(f, r);
+	}
+	Status ReuseWritableFile(const std::string& f, const std::string& o,
+		WritableFile** r) {
+		return target_->ReuseWritableFile(f, o, r);
+	}
 	bool FileExists(const std::string& f) { return target_->FileExists(f); }
 	Status GetChildren(const std::string& dir, std::vector<std::string>* r) {
 		return target_->GetChildren(dir, r);
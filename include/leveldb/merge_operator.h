@@ -0,0 +1,63 @@
+// A database can be configured with a MergeOperator, which defines how
+// a stack of merge operands written for a key combines with the value
+// below them.  Clients record a read-modify-write (incrementing a
+// counter, appending to a list, ...) as a single operand instead of a
+// Get() followed by a Put(); the operands are folded into the value
+// when the key is read.
+//
+// See NewUInt64AddOperator() and NewStringAppendOperator() below for
+// builtin operators.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+#define STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
+
+#include <string>
+#include <vector>
+#include "slice.h"
+
+namespace leveldb {
+
+class MergeOperator {
+public:
+	virtual ~MergeOperator();
+
+	// Return the name of this operator.  The name must change if the
+	// meaning of the operands changes in an incompatible way.
+	virtual const char* Name() const = 0;
+
+	// Apply operands[0,n-1], oldest first, to existing_value, which is
+	// NULL if the key has no value (it was never written or deleted),
+	// and store the result in *new_value.  Return false if the operands
+	// are corrupt; the read of key then fails.
+	virtual bool FullMerge(const Slice& key,
+		const Slice* existing_value,
+		const std::vector<Slice>& operands,
+		std::string* new_value) const = 0;
+
+	// Combine two adjacent operands, left_operand being the older one,
+	// into a single operand with the same effect, and store it in
+	// *new_value.  Return false if the operands cannot be combined without
+	// knowing the value below them; they are then passed to FullMerge()
+	// separately.  Operators whose operands combine (such as additions)
+	// should implement this, so that long stacks of operands collapse.
+	virtual bool PartialMerge(const Slice& /*key*/,
+		const Slice& /*left_operand*/,
+		const Slice& /*right_operand*/,
+		std::string* /*new_value*/) const {
+		return false;
+	}
+};
+
+// Return a new merge operator for counters stored as 64-bit unsigned
+// integers in the fixed-width little-endian format of EncodeFixed64().
+// Each operand, in the same format, is added to the value; a missing
+// value counts as zero.
+extern const MergeOperator* NewUInt64AddOperator();
+
+// Return a new merge operator that appends each operand to the value,
+// separated by "delim".  A missing value counts as the empty list.
+extern const MergeOperator* NewStringAppendOperator(char delim);
+
+}
+
+#endif // !STORAGE_LEVELDB_INCLUDE_MERGE_OPERATOR_H_
@@ -10,7 +10,10 @@ class Comparator;
 class Env;
 class FilterPolicy;
 class Logger;
+class MergeOperator;
+class SliceTransform;
 class Snapshot;
+class WriteBufferManager;
 
 // DB contents are stored in a set of blocks, each of which holds a
 // sequence of key,value pairs.  Each block may be compressed before
@@ -23,6 +26,23 @@ enum CompressionType {
   kSnappyCompression = 0x1
 };
 
+// The in-memory data structure a memtable keeps its entries in.
+enum MemTableRepType {
+  // A skiplist, ordered on every insert.
+  kSkipListRep       = 0x0,
+  // A skiplist plus a hash index over user keys, for O(1) point lookups.
+  kHashIndexRep      = 0x1,
+  // One skiplist per key prefix (see Options::prefix_extractor), for
+  // lookups and scans confined to a prefix.
+  kHashSkipListRep   = 0x2,
+  // An append-only vector, sorted when first read.  For bulk loads that
+  // are not read before the memtable is flushed.
+  kVectorRep         = 0x3,
+  // A skiplist that stores each entry inside its node, for a smaller
+  // memory footprint per entry.
+  kInlineSkipListRep = 0x4
+};
+
 // Options to control the behavior of a database (passed to DB::Open)
 struct Options {
   // -------------------
@@ -78,6 +98,72 @@ struct Options {
   // Default: 4MB
   size_t write_buffer_size;
 
+  // If true, several threads may insert into the same memtable at once
+  // through MemTable::AddConcurrent().  Node linking is lock-free, so
+  // readers never block, and the memtable allocates from a
+  // ConcurrentArena with per-core slabs instead of a plain Arena.  The
+  // memtable has to be created with this option set.
+  //
+  // Default: false
+  bool allow_concurrent_memtable_write;
+
+  // Size of the blocks the memtable arena carves its entries out of.
+  // Larger blocks mean fewer allocations and less TLB pressure when a
+  // large write buffer is filled.  Zero picks the arena's own default
+  // (4KB, or 64KB with allow_concurrent_memtable_write).
+  //
+  // Default: 0
+  size_t arena_block_size;
+
+  // If non-zero, memtable arena blocks are rounded up to a multiple of
+  // this size and mmap()ed so they can be backed by huge pages.  Reserved
+  // huge pages (MAP_HUGETLB) are used when the system has them, otherwise
+  // transparent huge pages are requested with madvise().  Must be the
+  // system's huge page size, typically 2MB.  Ignored on platforms without
+  // mmap().
+  //
+  // Default: 0
+  size_t memtable_huge_page_size;
+
+  // Data structure beneath each memtable.  kHashIndexRep speeds up point
+  // lookups at the cost of a bucket array and 16 bytes per entry.  It is
+  // only used with BytewiseComparator(); other comparators get
+  // kSkipListRep.
+  //
+  // Default: kSkipListRep
+  MemTableRepType memtable_rep;
+
+  // Number of hash buckets of a kHashIndexRep or kHashSkipListRep
+  // memtable.  Zero picks one bucket per 64 bytes of write_buffer_size for
+  // kHashIndexRep and one per 4KB for kHashSkipListRep.
+  //
+  // Default: 0
+  size_t memtable_hash_bucket_count;
+
+  // If non-NULL, kHashSkipListRep memtables group user keys by the
+  // result of this transform.  Full iteration over such a memtable has to
+  // sort all of its entries, so use it where scans stay within a prefix
+  // (see MemTable::NewPrefixIterator()).  kHashSkipListRep without a
+  // prefix_extractor behaves like kSkipListRep.
+  //
+  // Default: NULL
+  const SliceTransform* prefix_extractor;
+
+  // If non-NULL, combines the merge operands (entries of type kTypeMerge)
+  // of a key with its value when the key is read.  Required if any merge
+  // operands are written.
+  //
+  // Default: NULL
+  const MergeOperator* merge_operator;
+
+  // If non-NULL, the memory of every memtable created with these options
+  // is counted by this manager, which may be shared by many DB instances
+  // to keep their memtables within one budget and optionally charge them
+  // to a block cache.  See write_buffer_manager.h.
+  //
+  // Default: NULL
+  WriteBufferManager* write_buffer_manager;
+
   // Number of open files that can be used by the DB.  You may need to
   // increase this if your database has a large working set (budget
   // one open file per 2MB of working set).
@@ -137,12 +223,73 @@ struct Options {
   // efficiently detect that and will switch to uncompressed mode.
   CompressionType compression;
 
+  // Number of background threads a TableBuilder uses to compress and
+  // checksum data blocks, plus one more that appends the finished blocks
+  // to the file and builds the filter block.  With 0, all of the work is
+  // done on the thread calling TableBuilder::Add().  Worth raising for
+  // memtable flushes and compactions of large tables, whose speed is
+  // otherwise bounded by one core rather than by the disk.
+  //
+  // Default: 0
+  int table_builder_threads;
+
   // EXPERIMENTAL: If true, append to existing MANIFEST and log files
   // when a database is opened.  This can significantly speed up open.
   //
   // Default: currently false, but may become true later.
   bool reuse_logs;
 
+  // If non-zero, the files of up to this many obsolete logs are kept and
+  // overwritten by new logs instead of new files being created.  A sync
+  // of a recycled log then only flushes data, since the file size does
+  // not change.  Logs are written with recyclable records (see
+  // db/log_format.h), which older versions cannot read.
+  //
+  // Default: 0
+  size_t recycle_log_file_num;
+
+  // If non-zero, disk space for this many bytes is reserved when a new
+  // log file is created (see WritableFile::Allocate()), so that appends
+  // do not allocate blocks.  Typically a little more than
+  // write_buffer_size.
+  //
+  // Default: 0
+  size_t log_preallocate_size;
+
+  // Number of threads that read, verify and decode a log at once when
+  // it is replayed into a memtable on recovery (see db/log_replay.h).
+  // The log is split into pieces at block boundaries; the write batches
+  // are still applied in the order they were written.  With 0, the log
+  // is replayed by the recovering thread alone.
+  //
+  // Default: 0
+  int wal_recovery_threads;
+
+  // Number of bytes a log::Reader asks the file for at a time when a log
+  // is replayed, rounded up to a multiple of the 32KB log block size.
+  // Multi-megabyte reads let log scans run at the bandwidth of NVMe and
+  // network block devices.  Each reader holds a buffer of this size.
+  //
+  // Default: 1MB
+  size_t log_read_size;
+
+  // If true, new log and table files are written with
+  // Env::NewDirectWritableFile(), bypassing the operating system's cache
+  // where the Env supports it, so that flushes and compactions do not
+  // evict the cached data of hot tables.  Recycled log files are still
+  // written through the cache.
+  //
+  // Default: false
+  bool use_direct_writes;
+
+  // If true, table files are read with Env::NewDirectRandomAccessFile(),
+  // bypassing the operating system's cache where the Env supports it, so
+  // that the block cache is the only cache of table data and memory use
+  // is set by its size.  Size block_cache accordingly.
+  //
+  // Default: false
+  bool use_direct_reads;
+
   // If non-NULL, use the specified filter policy to reduce disk reads.
   // Many applications will benefit from passing the result of
   // NewBloomFilterPolicy() here.
@@ -0,0 +1,42 @@
+// A SliceTransform maps a user key to a shorter key, typically a prefix
+// such as a tenant id.  Memtables built with kHashSkipListRep group
+// entries by the transformed key, so that lookups and scans within one
+// prefix only touch the entries sharing it.
+//
+// Most people will want to use the builtin fixed-length prefix (see
+// NewFixedPrefixTransform() below).
+
+#ifndef STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+#define STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
+
+#include <cstddef>
+
+#include "slice.h"
+
+namespace leveldb {
+
+class SliceTransform {
+public:
+	virtual ~SliceTransform();
+
+	// Return the name of this transform.
+	virtual const char* Name() const = 0;
+
+	// Return the transformed form of "key".  The result must point into
+	// key's data.
+	// REQUIRES: InDomain(key)
+	virtual Slice Transform(const Slice& key) const = 0;
+
+	// Return true if Transform() can be applied to "key".  Keys outside
+	// the domain are grouped by their whole key instead.
+	virtual bool InDomain(const Slice& key) const = 0;
+};
+
+// Return a transform that keeps the first "prefix_len" bytes of a key.
+// Keys shorter than that are outside its domain.  The caller must
+// delete the result when it is no longer needed.
+extern const SliceTransform* NewFixedPrefixTransform(size_t prefix_len);
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_SLICE_TRANSFORM_H_
@@ -43,6 +43,12 @@ public:
 	// call one of the Seek methods on the iterator before using it).
 	Iterator* NewIterator(const ReadOptions&) const;
 
+	// Returns a new iterator over the range tombstones added by
+	// TableBuilder::AddTombstone(), or an empty iterator if there are
+	// none.  The tombstone block is read from the file on every call and
+	// is not put into the block cache.
+	Iterator* NewRangeTombstoneIterator(const ReadOptions&) const;
+
 	// Given a key, return an approximate byte offset in the file where
 	// the data for that key begins (or would begin if the key were
 	// present in the file).  The returned value is in terms of file
@@ -67,6 +73,16 @@ private:
 		void* arg,
 		void (*handle_result)(void* arg, const Slice& k, const Slice& v));
 
+	// Look up keys[0,n-1] as by InternalGet(), calling
+	// (*handle_result)(arg, i, ...) with the entry found for keys[i] and
+	// storing the status of its lookup in statuses[i].  The blocks missing
+	// from the block cache are read with one batched read, so that adjacent
+	// blocks are fetched together.
+	void InternalMultiGet(
+		const ReadOptions&, const Slice* keys, size_t n,
+		Status* statuses, void* arg,
+		void (*handle_result)(void* arg, size_t i, const Slice& k, const Slice& v));
+
 	void ReadMeta(const Footer& footer);
 	void ReadFilter(const Slice& filter_handle_value);
 
@@ -42,6 +42,16 @@ public:
 	// REQUIRES: Finish(), Abandon() have not been called
 	void Add(const Slice& key, const Slice& value);
 
+	// Add a range tombstone to the table: key is the internal key of the
+	// start of the range and value the end user key, as yielded by
+	// MemTable::NewRangeTombstoneIterator().  Tombstones go to a meta
+	// block of their own, apart from the data blocks, and do not count
+	// towards NumEntries().
+	// REQUIRES: key is after any previously added tombstone according to
+	// comparator.
+	// REQUIRES: Finish(), Abandon() have not been called
+	void AddTombstone(const Slice& key, const Slice& value);
+
 	// Advanced operation: flush any buffered key/value pairs to file.
 	// Can be used to ensure that two adjacent entries never live in
 	// the same data block.  Most clients should not need to use this method.
@@ -68,13 +78,25 @@ public:
 
 	// Size of the file generated so far.  If invoked after a successful
 	// Finish() call, returns the size of the final generated file.
+	// With options.table_builder_threads > 0 the blocks still queued for
+	// compression or writing are not counted.
 	uint64_t FileSize() const;
 
 private:
+	struct BlockWork;
+
 	bool ok() const { return status().ok(); }
 	void WriteBlock(BlockBuilder* block, BlockHandle* handle);
 	void WriteRawBlock(const Slice& data, CompressionType, BlockHandle* handle);
 
+	// Parallel mode (options.table_builder_threads > 0)
+	void QueueBlock();
+	void StopThreads();
+	void CompressBlocks();
+	void WriteBlocks();
+	static void BGCompress(void* builder);
+	static void BGWrite(void* builder);
+
 	struct Rep;
 	Rep* rep_;
 
@@ -0,0 +1,88 @@
+// A WriteBufferManager keeps one memory budget for the memtables of any
+// number of DB instances.  Every memtable created with
+// Options::write_buffer_manager pointing at the manager reserves its
+// arena memory from it as it grows, and releases the reservation when it
+// is destroyed.  Once the memtables together reach the budget,
+// ShouldFlush() returns true so that the caller can flush a memtable
+// early instead of waiting for its own write_buffer_size.
+//
+// If a block Cache is given, the reserved memory is also charged
+// against the cache's capacity through dummy entries, so that memtables
+// and cached blocks share one limit: as memtables grow, blocks are
+// evicted.
+//
+// All methods are thread-safe.
+
+#ifndef STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+#define STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
+
+#include <stddef.h>
+#include <atomic>
+
+namespace leveldb {
+
+class Cache;
+
+class WriteBufferManager {
+public:
+	// Size of each dummy entry charged to the cache.  Reservations are
+	// rounded up to a multiple of it.
+	static const size_t kDummyEntrySize = 256 << 10;
+
+	// buffer_size is the budget of all the memtables together, zero for
+	// no budget (memory is still counted).  If cache is non-NULL, the
+	// reserved memory is charged to it; the cache must outlive the manager.
+	explicit WriteBufferManager(size_t buffer_size, Cache* cache = NULL);
+
+	// REQUIRES: no memtable using this manager is still alive.
+	~WriteBufferManager();
+
+	// Whether a budget was set.
+	bool enabled() const { return buffer_size_ > 0; }
+
+	// The budget passed to the constructor.
+	size_t buffer_size() const { return buffer_size_; }
+
+	// Memory reserved by all memtables so far.
+	size_t memory_usage() const {
+		return memory_used_.load(std::memory_order_relaxed);
+	}
+
+	// Memory currently charged to the cache, a multiple of kDummyEntrySize
+	// at least as large as memory_usage(), or zero without a cache.
+	size_t cache_charge() const;
+
+	// Returns true once the memtables have reached the budget.  The
+	// caller should then flush (and release) one of them.
+	//
+	// Nothing in this tree calls it yet: MemTable only reserves memory.
+	// The DB write path is expected to check it before each write and
+	// schedule a memtable switch, the same way it checks its own
+	// write_buffer_size.
+	bool ShouldFlush() const {
+		return enabled() && memory_usage() >= buffer_size_;
+	}
+
+	// Account for mem more bytes of memtable memory.  Called by MemTable.
+	void ReserveMem(size_t mem);
+
+	// Release mem bytes reserved earlier.  Called by MemTable.
+	void FreeMem(size_t mem);
+
+private:
+	struct CacheRep;
+
+	const size_t buffer_size_;
+	std::atomic<size_t> memory_used_;
+	CacheRep* const cache_rep_;  // NULL if no cache was given
+
+	void UpdateCacheCharge();
+
+	// No copying allowed
+	WriteBufferManager(const WriteBufferManager&);
+	void operator=(const WriteBufferManager&);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_INCLUDE_WRITE_BUFFER_MANAGER_H_
@@ -30,6 +30,7 @@
 #endif  // HAVE_SNAPPY
 
 #include <cassert>
+#include <chrono>
 #include <condition_variable>  // NOLINT
 #include <cstddef>
 #include <cstdint>
@@ -77,6 +78,15 @@ class CondVar {
     cv_.wait(lock);
     lock.release();
   }
+  // Same as Wait(), but gives up after timeout_micros.  Returns true if
+  // the wait timed out.
+  bool TimedWait(uint64_t timeout_micros) {
+    std::unique_lock<std::mutex> lock(mu_->mu_, std::adopt_lock);
+    const std::cv_status status =
+        cv_.wait_for(lock, std::chrono::microseconds(timeout_micros));
+    lock.release();
+    return status == std::cv_status::timeout;
+  }
   void Signal() { cv_.notify_one(); }
   void SignalAll() { cv_.notify_all(); }
 
@@ -147,6 +157,17 @@ inline uint32_t AcceleratedCRC32C(uint32_t crc, const char* buf, size_t size) {
 #endif  // HAVE_CRC32C
 }
 
+// Hint that the cache line holding addr is about to be read.  A no-op
+// where the compiler offers no prefetch builtin.
+inline void PrefetchForRead(const void* addr) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(addr, 0, 3);
+#else
+  // Silence compiler warnings about unused arguments.
+  (void)addr;
+#endif
+}
+
 }  // namespace port
 }  // namespace leveldb
 
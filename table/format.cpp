@@ -1,5 +1,8 @@
 ﻿#include "format.h"
 
+#include <vector>
+
+#include "aligned_buffer_pool.h"
 #include "env.h"
 #include "coding.h"
 #include "port.h"
@@ -60,24 +63,106 @@ Status Footer::DecodeFrom(Slice* input) {
 	return result;
 }
 
-Status ReadBlock(RandomAccessFile* file,
-	const ReadOptions& options,
-	const BlockHandle& handle,
+// Check the crc of the type and the contents of the block read into
+// data[0,n+kBlockTrailerSize-1]
+static Status CheckBlockTrailer(const ReadOptions& options, const char* data,
+	size_t n) {
+	if (options.verify_checksums) {
+		const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
+		const uint32_t actual = crc32c::Value(data, n + 1);
+		if (actual != crc) {
+			return Status::Corruption("block checksum mismatch");
+		}
+	}
+	return Status::OK();
+}
+
+// Uncompress the snappy-compressed block contents data[0,n-1] into a new
+// heap buffer
+static Status UncompressBlock(const char* data, size_t n,
 	BlockContents* result) {
-	result->data = Slice();
-	result->cacheable = false;
-	result->heap_allocated = false;
+	size_t ulength = 0;
+	if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
+		return Status::Corruption("corrupted compressed block contents");
+	}
+	char* ubuf = new char[ulength];
+	if (!port::Snappy_Uncompress(data, n, ubuf)) {
+		delete[] ubuf;
+		return Status::Corruption("corrupted compressed block contents");
+	}
+	result->data = Slice(ubuf, ulength);
+	result->heap_allocated = true;
+	result->cacheable = true;
+	return Status::OK();
+}
 
-	// Read the block contents as well as the type/crc footer.
-	// See table_builder.cc for the code that built this structure.
-	size_t n = static_cast<size_t>(handle.size());
-	char* buf = new char[n + kBlockTrailerSize];
-	Slice contents;
-	Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+// The range of the file read for a block into a buffer of "pool": the
+// block and its trailer, widened to the pool's alignment so that a direct
+// I/O file reads it from the device without staging it in a buffer of its
+// own.  The block starts "*skip" bytes into the range.
+static void AlignedBlockRange(const AlignedBufferPool* pool,
+	const BlockHandle& handle, uint64_t* offset, size_t* size, size_t* skip) {
+	const uint64_t mask = pool->alignment() - 1;
+	*offset = handle.offset() & ~mask;
+	*skip = static_cast<size_t>(handle.offset() - *offset);
+	*size = static_cast<size_t>(
+		(*skip + handle.size() + kBlockTrailerSize + mask) & ~mask);
+}
+
+// Parse the block of "n" bytes read by AlignedBlockRange() into
+// "contents", which points into a buffer of the pool.
+static Status ParseAlignedBlock(const ReadOptions& options,
+	const Slice& contents, size_t skip, size_t n, BlockContents* result) {
+	if (contents.size() < skip + n + kBlockTrailerSize) {
+		return Status::Corruption("truncated block read");
+	}
+	const char* data = contents.data() + skip;
+	Status s = CheckBlockTrailer(options, data, n);
 	if (!s.ok()) {
-		delete[] buf;
 		return s;
 	}
+	switch (data[n]) {
+	case kNoCompression: {
+		// pool中的buffer要归还，block cache需要单独分配的内存
+		char* copy = new char[n];
+		memcpy(copy, data, n);
+		result->data = Slice(copy, n);
+		result->heap_allocated = true;
+		result->cacheable = true;
+		return Status::OK();
+	}
+	case kSnappyCompression:
+		// 直接从pool的buffer解压，不需要中间的拷贝
+		return UncompressBlock(data, n, result);
+	default:
+		return Status::Corruption("bad block type");
+	}
+}
+
+// Read the block into a buffer of "pool"
+static Status ReadAlignedBlock(RandomAccessFile* file, AlignedBufferPool* pool,
+	const ReadOptions& options,
+	const BlockHandle& handle,
+	BlockContents* result) {
+	uint64_t offset;
+	size_t size, skip;
+	AlignedBlockRange(pool, handle, &offset, &size, &skip);
+	size_t capacity;
+	char* buf = pool->Acquire(size, &capacity);
+	Slice contents;
+	Status s = file->Read(offset, size, &contents, buf);
+	if (s.ok()) {
+		s = ParseAlignedBlock(options, contents, skip,
+			static_cast<size_t>(handle.size()), result);
+	}
+	pool->Release(buf, capacity);
+	return s;
+}
+
+// Parse the block of "n" bytes that was read into "contents" from the
+// buffer "buf", which is new[]-allocated and owned by this function.
+static Status ParseBlock(const ReadOptions& options, char* buf,
+	const Slice& contents, size_t n, BlockContents* result) {
 	if (contents.size() != n + kBlockTrailerSize) {
 		delete[] buf;
 		return Status::Corruption("truncated block read");
@@ -85,14 +170,10 @@ Status ReadBlock(RandomAccessFile* file,
 
 	// Check the crc of the type and the block contents
 	const char* data = contents.data();    // Pointer to where Read put the data
-	if (options.verify_checksums) {
-		const uint32_t crc = crc32c::Unmask(DecodeFixed32(data + n + 1));
-		const uint32_t actual = crc32c::Value(data, n + 1);
-		if (actual != crc) {
-			delete[] buf;
-			s = Status::Corruption("block checksum mismatch");
-			return s;
-		}
+	Status s = CheckBlockTrailer(options, data, n);
+	if (!s.ok()) {
+		delete[] buf;
+		return s;
 	}
 
 	switch (data[n]) {
@@ -114,24 +195,10 @@ Status ReadBlock(RandomAccessFile* file,
 
 		// Ok
 		break;
-	case kSnappyCompression: {
-		size_t ulength = 0;
-		if (!port::Snappy_GetUncompressedLength(data, n, &ulength)) {
-			delete[] buf;
-			return Status::Corruption("corrupted compressed block contents");
-		}
-		char* ubuf = new char[ulength];
-		if (!port::Snappy_Uncompress(data, n, buf)) {
-			delete[] buf;
-			delete[] ubuf;
-			return Status::Corruption("corrupted compressed block contents");
-		}
+	case kSnappyCompression:
+		s = UncompressBlock(data, n, result);
 		delete[] buf;
-		result->data = Slice(ubuf, ulength);
-		result->heap_allocated = true;
-		result->cacheable = true;
-		break;
-	}
+		return s;
 	default:
 		delete[] buf;
 		return Status::Corruption("bad block type");
@@ -140,4 +207,81 @@ Status ReadBlock(RandomAccessFile* file,
 	return Status::OK();
 }
 
+Status ReadBlock(RandomAccessFile* file,
+	const ReadOptions& options,
+	const BlockHandle& handle,
+	BlockContents* result) {
+	result->data = Slice();
+	result->cacheable = false;
+	result->heap_allocated = false;
+
+	AlignedBufferPool* pool = file->aligned_buffer_pool();
+	if (pool != NULL) {
+		return ReadAlignedBlock(file, pool, options, handle, result);
+	}
+
+	// Read the block contents as well as the type/crc footer.
+	// See table_builder.cc for the code that built this structure.
+	size_t n = static_cast<size_t>(handle.size());
+	char* buf = new char[n + kBlockTrailerSize];
+	Slice contents;
+	Status s = file->Read(handle.offset(), n + kBlockTrailerSize, &contents, buf);
+	if (!s.ok()) {
+		delete[] buf;
+		return s;
+	}
+	return ParseBlock(options, buf, contents, n, result);
+}
+
+void ReadBlocks(RandomAccessFile* file,
+	const ReadOptions& options,
+	const BlockHandle* handles,
+	size_t n,
+	BlockContents* results,
+	Status* statuses) {
+	// 所有block一次交给MultiRead()，由文件合并相邻的读取
+	AlignedBufferPool* pool = file->aligned_buffer_pool();
+	std::vector<ReadRequest> reqs(n);
+	std::vector<size_t> skips(n, 0);
+	std::vector<size_t> capacities(n, 0);
+	for (size_t i = 0; i < n; i++) {
+		results[i].data = Slice();
+		results[i].cacheable = false;
+		results[i].heap_allocated = false;
+		if (pool != NULL) {
+			AlignedBlockRange(pool, handles[i], &reqs[i].offset, &reqs[i].len,
+				&skips[i]);
+			reqs[i].scratch = pool->Acquire(reqs[i].len, &capacities[i]);
+		}
+		else {
+			reqs[i].offset = handles[i].offset();
+			reqs[i].len = static_cast<size_t>(handles[i].size()) + kBlockTrailerSize;
+			reqs[i].scratch = new char[reqs[i].len];
+		}
+	}
+
+	// 整体失败时每个请求的status中也有错误，不需要单独处理
+	file->MultiRead(reqs.data(), n);
+
+	for (size_t i = 0; i < n; i++) {
+		const size_t size = static_cast<size_t>(handles[i].size());
+		if (pool != NULL) {
+			statuses[i] = reqs[i].status;
+			if (statuses[i].ok()) {
+				statuses[i] = ParseAlignedBlock(options, reqs[i].result, skips[i],
+					size, &results[i]);
+			}
+			pool->Release(reqs[i].scratch, capacities[i]);
+		}
+		else if (!reqs[i].status.ok()) {
+			statuses[i] = reqs[i].status;
+			delete[] reqs[i].scratch;
+		}
+		else {
+			statuses[i] = ParseBlock(options, reqs[i].scratch, reqs[i].result, size,
+				&results[i]);
+		}
+	}
+}
+
 }  // namespace leveldb
\ No newline at end of file
@@ -82,6 +82,9 @@ static const uint64_t kTableMagicNumber = 0xdb4775248b80fb57ull;
 // 1-byte type + 32-bit crc
 static const size_t kBlockTrailerSize = 5;
 
+// Key of the range tombstone block in the metaindex block
+static const char kRangeDelBlockName[] = "leveldb.range_del";
+
 struct BlockContents {
 	Slice data;			  // Actual contents of data
 	bool cacheable;		  // True iff data can be cached
@@ -95,6 +98,16 @@ extern Status ReadBlock(RandomAccessFile* file,
 	const BlockHandle& handle,
 	BlockContents* result);
 
+// Read the blocks identified by handles[0,n-1] from "file" with a single
+// RandomAccessFile::MultiRead() call, storing the outcome of each block
+// as ReadBlock() would in results[i] and statuses[i].
+extern void ReadBlocks(RandomAccessFile* file,
+	const ReadOptions& options,
+	const BlockHandle* handles,
+	size_t n,
+	BlockContents* results,
+	Status* statuses);
+
 // Implementation details follow.  Clients should ignore,
 // 把offset和size全部设置为1，全64位都是1
 inline BlockHandle::BlockHandle()
@@ -1,5 +1,8 @@
 ﻿#include "table.h"
 
+#include <map>
+#include <vector>
+
 #include "cache.h"
 #include "comparator.h"
 #include "env.h"
@@ -31,6 +34,9 @@ struct Table::Rep {
 	// 用于存储从footer中解析出的metaindex_handle
 	BlockHandle metaindex_handle;
 	Block* index_block;
+	// 范围删除所在的meta block，没有范围删除时has_range_del为false
+	bool has_range_del;
+	BlockHandle range_del_handle;
 };
 
 Status Table::Open(const Options& options,
@@ -77,6 +83,7 @@ Status Table::Open(const Options& options,
 		rep->cache_id = (options.block_cache ? options.block_cache->NewId() : 0);
 		rep->filter_data = NULL;
 		rep->filter = NULL;
+		rep->has_range_del = false;
 		*table = new Table(rep);
 		(*table)->ReadMeta(footer);
 	}
@@ -88,10 +95,8 @@ Status Table::Open(const Options& options,
 }
 
 void Table::ReadMeta(const Footer& footer) {
-	if (rep_->options.filter_policy == NULL) {
-		return;  // Do not need any metadata
-	}
-
+	// The metaindex block is read even without a filter policy, since it
+	// may point to range tombstones.
 	// TODO(sanjay): Skip this if footer.metaindex_handle() size indicates
 	// it is an empty block.
 	ReadOptions opt;
@@ -106,11 +111,18 @@ void Table::ReadMeta(const Footer& footer) {
 	Block* meta = new Block(contents);
 
 	Iterator* iter = meta->NewIterator(BytewiseComparator());
-	std::string key = "filter.";
-	key.append(rep_->options.filter_policy->Name());
-	iter->Seek(key);
-	if (iter->Valid() && iter->key() == Slice(key)) {
-		ReadFilter(iter->value());
+	if (rep_->options.filter_policy != NULL) {
+		std::string key = "filter.";
+		key.append(rep_->options.filter_policy->Name());
+		iter->Seek(key);
+		if (iter->Valid() && iter->key() == Slice(key)) {
+			ReadFilter(iter->value());
+		}
+	}
+	iter->Seek(kRangeDelBlockName);
+	if (iter->Valid() && iter->key() == Slice(kRangeDelBlockName)) {
+		Slice v = iter->value();
+		rep_->has_range_del = rep_->range_del_handle.DecodeFrom(&v).ok();
 	}
 	delete iter;
 	delete meta;
@@ -159,6 +171,14 @@ static void ReleaseBlock(void* arg, void* h) {
 	cache->Release(handle);
 }
 
+// block cache的key：table的cache_id加上block的offset
+static Slice BlockCacheKey(uint64_t cache_id, const BlockHandle& handle,
+	char* buf) {
+	EncodeFixed64(buf, cache_id);
+	EncodeFixed64(buf + 8, handle.offset());
+	return Slice(buf, 16);
+}
+
 // Convert an index iterator value (i.e., an encoded BlockHandle)
 // into an iterator over the contents of the corresponding block.
 Iterator* Table::BlockReader(void* arg,
@@ -180,9 +200,8 @@ Iterator* Table::BlockReader(void* arg,
 		BlockContents contents;
 		if (block_cache != NULL) {
 			char cache_key_buffer[16];
-			EncodeFixed64(cache_key_buffer, table->rep_->cache_id);
-			EncodeFixed64(cache_key_buffer + 8, handle.offset());
-			Slice key(cache_key_buffer, sizeof(cache_key_buffer));
+			Slice key = BlockCacheKey(table->rep_->cache_id, handle,
+				cache_key_buffer);
 			cache_handle = block_cache->Lookup(key);
 			if (cache_handle != NULL) {
 				block = reinterpret_cast<Block*>(block_cache->Value(cache_handle));
@@ -228,6 +247,21 @@ Iterator* Table::NewIterator(const ReadOptions& options) const {
 		&Table::BlockReader, const_cast<Table*>(this), options);
 }
 
+Iterator* Table::NewRangeTombstoneIterator(const ReadOptions& options) const {
+	if (!rep_->has_range_del) {
+		return NewEmptyIterator();
+	}
+	BlockContents contents;
+	Status s = ReadBlock(rep_->file, options, rep_->range_del_handle, &contents);
+	if (!s.ok()) {
+		return NewErrorIterator(s);
+	}
+	Block* block = new Block(contents);
+	Iterator* iter = block->NewIterator(rep_->options.comparator);
+	iter->RegisterCleanup(&DeleteBlock, block, NULL);
+	return iter;
+}
+
 Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 	void* arg,
 	void (*saver)(void*, const Slice&, const Slice&)) {
@@ -261,6 +295,110 @@ Status Table::InternalGet(const ReadOptions& options, const Slice& k,
 	return s;
 }
 
+void Table::InternalMultiGet(const ReadOptions& options, const Slice* keys,
+	size_t n, Status* statuses, void* arg,
+	void (*saver)(void*, size_t, const Slice&, const Slice&)) {
+	// 先找到每个key所在的block，多个key在同一个block中时只读一次
+	const size_t kNoBlock = static_cast<size_t>(-1);
+	std::vector<BlockHandle> handles;
+	std::map<uint64_t, size_t> handle_index;  // Block offset -> handles index
+	std::vector<size_t> key_block(n, kNoBlock);  // Index into handles
+	Iterator* iiter = rep_->index_block->NewIterator(rep_->options.comparator);
+	for (size_t i = 0; i < n; i++) {
+		statuses[i] = Status::OK();
+		iiter->Seek(keys[i]);
+		if (!iiter->Valid()) {
+			statuses[i] = iiter->status();
+			continue;
+		}
+		Slice handle_value = iiter->value();
+		BlockHandle handle;
+		statuses[i] = handle.DecodeFrom(&handle_value);
+		if (!statuses[i].ok()) {
+			continue;
+		}
+		FilterBlockReader* filter = rep_->filter;
+		if (filter != NULL && !filter->KeyMayMatch(handle.offset(), keys[i])) {
+			continue;  // Not found
+		}
+		std::map<uint64_t, size_t>::iterator it = handle_index.find(handle.offset());
+		if (it == handle_index.end()) {
+			it = handle_index.insert(std::make_pair(handle.offset(), handles.size())).first;
+			handles.push_back(handle);
+		}
+		key_block[i] = it->second;
+	}
+	delete iiter;
+
+	// 从block cache中查找，其余的block用一次MultiRead()读取
+	const size_t m = handles.size();
+	Cache* block_cache = rep_->options.block_cache;
+	std::vector<Block*> blocks(m, NULL);
+	std::vector<Cache::Handle*> cache_handles(m, NULL);
+	std::vector<Status> block_statuses(m);
+	std::vector<size_t> misses;
+	std::vector<BlockHandle> miss_handles;
+	char cache_key_buffer[16];
+	for (size_t j = 0; j < m; j++) {
+		if (block_cache != NULL) {
+			cache_handles[j] = block_cache->Lookup(
+				BlockCacheKey(rep_->cache_id, handles[j], cache_key_buffer));
+			if (cache_handles[j] != NULL) {
+				blocks[j] = reinterpret_cast<Block*>(block_cache->Value(cache_handles[j]));
+				continue;
+			}
+		}
+		misses.push_back(j);
+		miss_handles.push_back(handles[j]);
+	}
+	if (!misses.empty()) {
+		std::vector<BlockContents> contents(misses.size());
+		std::vector<Status> read_statuses(misses.size());
+		ReadBlocks(rep_->file, options, miss_handles.data(), misses.size(),
+			contents.data(), read_statuses.data());
+		for (size_t r = 0; r < misses.size(); r++) {
+			const size_t j = misses[r];
+			block_statuses[j] = read_statuses[r];
+			if (!read_statuses[r].ok()) {
+				continue;
+			}
+			blocks[j] = new Block(contents[r]);
+			if (block_cache != NULL && contents[r].cacheable && options.fill_cache) {
+				cache_handles[j] = block_cache->Insert(
+					BlockCacheKey(rep_->cache_id, handles[j], cache_key_buffer),
+					blocks[j], blocks[j]->size(), &DeleteCacheBlock);
+			}
+		}
+	}
+
+	for (size_t i = 0; i < n; i++) {
+		const size_t j = key_block[i];
+		if (j == kNoBlock) {
+			continue;
+		}
+		if (!block_statuses[j].ok()) {
+			statuses[i] = block_statuses[j];
+			continue;
+		}
+		Iterator* block_iter = blocks[j]->NewIterator(rep_->options.comparator);
+		block_iter->Seek(keys[i]);
+		if (block_iter->Valid()) {
+			(*saver)(arg, i, block_iter->key(), block_iter->value());
+		}
+		statuses[i] = block_iter->status();
+		delete block_iter;
+	}
+
+	for (size_t j = 0; j < m; j++) {
+		if (cache_handles[j] != NULL) {
+			block_cache->Release(cache_handles[j]);
+		}
+		else {
+			delete blocks[j];
+		}
+	}
+}
+
 uint64_t Table::ApproximateOffsetOf(const Slice& key) const {
 	Iterator* index_iter = rep_->index_block->NewIterator(rep_->options.comparator);
 	index_iter->Seek(key);
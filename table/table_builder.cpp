@@ -1,6 +1,9 @@
 ﻿#include "table_builder.h"
 
 #include <assert.h>
+#include <atomic>
+#include <deque>
+#include <vector>
 #include "comparator.h"
 #include "env.h"
 #include "filter_policy.h"
@@ -10,15 +13,69 @@
 #include "format.h"
 #include "coding.h"
 #include "crc32c.h"
+#include "mutexlock.h"
 #include "port.h"
+#include "thread_annotations.h"
 
 namespace leveldb {
 
+namespace {
+
+// 并行模式下每个worker线程最多可以积压的block数，限制未写入数据占用的内存
+const size_t kMaxQueuedBlocksPerThread = 4;
+
+// 按type压缩raw，压缩结果存放在*compressed中，返回要写入文件的block内容
+// 如果压缩不可用或者压缩率不足12.5%，返回raw并将*type改为kNoCompression
+Slice CompressBlock(const Slice& raw, CompressionType* type,
+	std::string* compressed) {
+	switch (*type) {
+	case kNoCompression:
+		return raw;
+
+	case kSnappyCompression:
+		if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
+			compressed->size() < raw.size() - (raw.size() / 8u)) {
+			return *compressed;
+		}
+		// Snappy not supported, or compressed less than 12.5%, so just
+		// store uncompressed form
+		*type = kNoCompression;
+		return raw;
+	}
+	return raw;
+}
+
+// trailer为block的类型和覆盖内容及类型的crc
+void EncodeBlockTrailer(const Slice& contents, CompressionType type,
+	char* trailer) {
+	trailer[0] = type;
+	uint32_t crc = crc32c::Value(contents.data(), contents.size());
+	crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
+	EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+}
+
+}  // namespace
+
+// 并行模式下一个已经切分好的data block，由调用线程生成，worker线程压缩并计算crc，
+// 最后由writer线程按顺序写入文件
+struct TableBuilder::BlockWork {
+	std::string raw;  // BlockBuilder::Finish()的结果
+	std::string keys;  // block中的所有key，首尾相接，用于生成filter
+	std::vector<size_t> key_lengths;
+	CompressionType type;  // 压缩前为options.compression，压缩后为实际使用的类型
+	std::string compressed;
+	Slice contents;  // 要写入文件的内容，指向raw或compressed
+	char trailer[kBlockTrailerSize];
+	bool ready;  // 已经压缩完成，可以写入
+};
+
 struct TableBuilder::Rep {
 	Options options;  // data block的选项
 	Options index_block_options;  // index block的选项
 	WritableFile* file;  // sstable文件
-	uint64_t offset;  // 要写入data block在sstable文件中的偏移，初始为0
+	// 要写入data block在sstable文件中的偏移，初始为0
+	// 并行模式下由writer线程更新，FileSize()可能在其他线程读取
+	std::atomic<uint64_t> offset;
 	Status status;  // 当前状态，初始为ok
 	BlockBuilder data_block;  // 当前操作的data block
 	BlockBuilder index_block;  // sstable的index block
@@ -29,6 +86,8 @@ struct TableBuilder::Rep {
 	// 存储的过滤器信息，它会存储(key, 对应的data block在sstable的偏移值)，不一定是
 	// 完全精确的，以快速定位
 	FilterBlockBuilder* filter_block;
+	// 范围删除单独写入一个meta block，在metaindex中的key为kRangeDelBlockName
+	BlockBuilder range_del_block;
 
 	// We do not emit the index entry for a block until we have seen the
 	// first key for the next data block.  This allows us to use shorter
@@ -46,6 +105,23 @@ struct TableBuilder::Rep {
 
 	std::string compressed_output;  // 压缩后的data block，临时存储，写入后即被清空
 
+	// 以下为并行模式(options.table_builder_threads > 0)使用的状态
+	// 调用线程切分data block并放入queue；worker线程按顺序领取并压缩；writer线程
+	// 等待队首block压缩完成后写入文件，同时生成filter。data block的偏移只有在写入时
+	// 才能确定，所以index block推迟到Finish()，用index_keys和block_handles拼出
+	const int num_threads;
+	std::string filter_keys;  // 当前data block的key，调用线程使用
+	std::vector<size_t> filter_key_lengths;
+	std::vector<std::string> index_keys;  // 调用线程使用
+	port::Mutex mu;
+	port::CondVar cv;  // 队列或线程状态发生变化
+	std::deque<BlockWork*> queue GUARDED_BY(mu);  // 按文件中的顺序，尚未写入
+	size_t next_to_compress GUARDED_BY(mu);  // queue中第一个未被领取压缩的block
+	bool closing GUARDED_BY(mu);  // 不会再有新的block加入
+	int running_threads GUARDED_BY(mu);
+	Status bg_status GUARDED_BY(mu);  // 后台线程遇到的第一个错误
+	std::vector<BlockHandle> block_handles;  // writer线程使用，写完后由Finish()读取
+
 	Rep(const Options& opt, WritableFile* f)
 		: options(opt),
 		index_block_options(opt),
@@ -57,7 +133,13 @@ struct TableBuilder::Rep {
 		closed(false),
 		filter_block(opt.filter_policy == NULL ? NULL
 			: new FilterBlockBuilder(opt.filter_policy)),
-		pending_index_entry(false) {
+		range_del_block(&options),
+		pending_index_entry(false),
+		num_threads(opt.table_builder_threads > 0 ? opt.table_builder_threads : 0),
+		cv(&mu),
+		next_to_compress(0),
+		closing(false),
+		running_threads(0) {
 		index_block_options.block_restart_interval = 1;
 	}
 };
@@ -67,6 +149,13 @@ TableBuilder::TableBuilder(const Options& options, WritableFile* file)
 	if (rep_->filter_block != NULL) {
 		rep_->filter_block->StartBlock(0);
 	}
+	if (rep_->num_threads > 0) {
+		rep_->running_threads = rep_->num_threads + 1;
+		for (int i = 0; i < rep_->num_threads; i++) {
+			options.env->StartThread(&TableBuilder::BGCompress, this);
+		}
+		options.env->StartThread(&TableBuilder::BGWrite, this);
+	}
 }
 
 TableBuilder::~TableBuilder() {
@@ -115,14 +204,27 @@ void TableBuilder::Add(const Slice& key, const Slice& value) {
 	if (r->pending_index_entry) {
 		assert(r->data_block.empty());
 		r->options.comparator->FindShortestSeparator(&r->last_key, key);
-		std::string handle_encoding;
-		r->pending_handle.EncodeTo(&handle_encoding);
-		r->index_block.Add(r->last_key, Slice(handle_encoding));
+		if (r->num_threads > 0) {
+			// block的handle在写入后才知道，Finish()时再加入index block
+			r->index_keys.push_back(r->last_key);
+		}
+		else {
+			std::string handle_encoding;
+			r->pending_handle.EncodeTo(&handle_encoding);
+			r->index_block.Add(r->last_key, Slice(handle_encoding));
+		}
 		r->pending_index_entry = false;
 	}
 
 	if (r->filter_block != NULL) {
-		r->filter_block->AddKey(key);
+		if (r->num_threads > 0) {
+			// filter由writer线程在block写入时生成
+			r->filter_keys.append(key.data(), key.size());
+			r->filter_key_lengths.push_back(key.size());
+		}
+		else {
+			r->filter_block->AddKey(key);
+		}
 	}
 
 	r->last_key.assign(key.data(), key.size());
@@ -142,6 +244,13 @@ void TableBuilder::Flush() {
 	if (r->data_block.empty()) return;
 	// 保证pending_index_entry为false，即data block的Add已经完成
 	assert(!r->pending_index_entry);
+	if (r->num_threads > 0) {
+		QueueBlock();
+		if (ok()) {
+			r->pending_index_entry = true;
+		}
+		return;
+	}
 	// 写入data block，并设置其index entry信息
 	WriteBlock(&r->data_block, &r->pending_handle);
 	// 写入成功，则Flush文件，并设置r->pending_index_entry为true，
@@ -166,29 +275,9 @@ void TableBuilder::WriteBlock(BlockBuilder* block, BlockHandle* handle) {
 	// 获得data block的序列化字符串
 	Slice raw = block->Finish();
 
-	Slice block_contents;
-	CompressionType type = r->options.compression;
 	// TODO(postrelease): Support more compression options: zlib?
-	switch (type) {
-	case kNoCompression:
-		block_contents = raw;
-		break;
-
-	case kSnappyCompression: {
-		std::string* compressed = &r->compressed_output;
-		if (port::Snappy_Compress(raw.data(), raw.size(), compressed) &&
-			compressed->size() < raw.size() - (raw.size() / 8u)) {
-			block_contents = *compressed;
-		}
-		else {
-			// Snappy not supported, or compressed less than 12.5%, so just
-			// store uncompressed form
-			block_contents = raw;
-			type = kNoCompression;
-		}
-		break;
-	}
-	}
+	CompressionType type = r->options.compression;
+	Slice block_contents = CompressBlock(raw, &type, &r->compressed_output);
 
 	// 将data内容写入到文件，并充值block成为初始化状态，清空compressed ouput
 	WriteRawBlock(block_contents, type, handle);
@@ -206,10 +295,7 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
 	r->status = r->file->Append(block_contents);
 	if (r->status.ok()) {
 		char trailer[kBlockTrailerSize];
-		trailer[0] = type;
-		uint32_t crc = crc32c::Value(block_contents.data(), block_contents.size());
-		crc = crc32c::Extend(crc, trailer, 1);  // Extend crc to cover block type
-		EncodeFixed32(trailer + 1, crc32c::Mask(crc));
+		EncodeBlockTrailer(block_contents, type, trailer);
 		r->status = r->file->Append(Slice(trailer, kBlockTrailerSize));
 		if (r->status.ok()) {
 			// 写入成功更新offset-下一个data block的写入偏移
@@ -218,10 +304,146 @@ void TableBuilder::WriteRawBlock(const Slice& block_contents,
 	}
 }
 
+void TableBuilder::QueueBlock() {
+	Rep* r = rep_;
+	BlockWork* work = new BlockWork;
+	Slice raw = r->data_block.Finish();
+	work->raw.assign(raw.data(), raw.size());
+	r->data_block.Reset();
+	work->keys.swap(r->filter_keys);
+	work->key_lengths.swap(r->filter_key_lengths);
+	work->type = r->options.compression;
+	work->ready = false;
+
+	MutexLock l(&r->mu);
+	const size_t max_queued = kMaxQueuedBlocksPerThread * r->num_threads;
+	while (r->queue.size() >= max_queued && r->bg_status.ok()) {
+		r->cv.Wait();
+	}
+	if (!r->bg_status.ok()) {
+		r->status = r->bg_status;
+		delete work;
+		return;
+	}
+	r->queue.push_back(work);
+	r->cv.SignalAll();
+}
+
+void TableBuilder::StopThreads() {
+	Rep* r = rep_;
+	MutexLock l(&r->mu);
+	r->closing = true;
+	r->cv.SignalAll();
+	while (r->running_threads > 0) {
+		r->cv.Wait();
+	}
+	assert(r->queue.empty());
+	if (r->status.ok()) {
+		r->status = r->bg_status;
+	}
+}
+
+void TableBuilder::BGCompress(void* builder) {
+	reinterpret_cast<TableBuilder*>(builder)->CompressBlocks();
+}
+
+void TableBuilder::BGWrite(void* builder) {
+	reinterpret_cast<TableBuilder*>(builder)->WriteBlocks();
+}
+
+// worker线程: 按顺序领取block，压缩并计算trailer，多个block可以同时压缩
+void TableBuilder::CompressBlocks() {
+	Rep* r = rep_;
+	MutexLock l(&r->mu);
+	while (true) {
+		if (r->next_to_compress < r->queue.size()) {
+			BlockWork* work = r->queue[r->next_to_compress++];
+			r->mu.Unlock();
+			work->contents = CompressBlock(work->raw, &work->type, &work->compressed);
+			EncodeBlockTrailer(work->contents, work->type, work->trailer);
+			r->mu.Lock();
+			work->ready = true;
+			r->cv.SignalAll();
+		}
+		else if (r->closing) {
+			break;
+		}
+		else {
+			r->cv.Wait();
+		}
+	}
+	r->running_threads--;
+	r->cv.SignalAll();
+}
+
+// writer线程: 按文件顺序写入压缩好的block，记录它们的handle，并生成filter
+// 出错后继续取出剩余的block但不再写入，以便调用线程和worker线程退出
+void TableBuilder::WriteBlocks() {
+	Rep* r = rep_;
+	MutexLock l(&r->mu);
+	while (true) {
+		if (!r->queue.empty() && r->queue.front()->ready) {
+			BlockWork* work = r->queue.front();
+			const bool failed = !r->bg_status.ok();
+			r->mu.Unlock();
+			Status s;
+			BlockHandle handle;
+			if (!failed) {
+				if (r->filter_block != NULL) {
+					const char* key = work->keys.data();
+					for (size_t i = 0; i < work->key_lengths.size(); i++) {
+						r->filter_block->AddKey(Slice(key, work->key_lengths[i]));
+						key += work->key_lengths[i];
+					}
+				}
+				handle.set_offset(r->offset);
+				handle.set_size(work->contents.size());
+				s = r->file->Append(work->contents);
+				if (s.ok()) {
+					s = r->file->Append(Slice(work->trailer, kBlockTrailerSize));
+				}
+				if (s.ok()) {
+					s = r->file->Flush();
+				}
+				if (s.ok()) {
+					r->offset += work->contents.size() + kBlockTrailerSize;
+					r->block_handles.push_back(handle);
+				}
+				if (r->filter_block != NULL) {
+					r->filter_block->StartBlock(r->offset);
+				}
+			}
+			delete work;
+			r->mu.Lock();
+			if (!s.ok() && r->bg_status.ok()) {
+				r->bg_status = s;
+			}
+			r->queue.pop_front();
+			r->next_to_compress--;
+			r->cv.SignalAll();
+		}
+		else if (r->closing && r->queue.empty()) {
+			break;
+		}
+		else {
+			r->cv.Wait();
+		}
+	}
+	r->running_threads--;
+	r->cv.SignalAll();
+}
+
 Status TableBuilder::status() const {
 	return rep_->status;
 }
 
+void TableBuilder::AddTombstone(const Slice& key, const Slice& value) {
+	Rep* r = rep_;
+	assert(!r->closed);
+	if (!ok()) return;
+	r->range_del_block.Add(key, value);
+}
+
 // 将所有已经添加的k/v对持久化到sstable，并关闭sstable文件
 Status TableBuilder::Finish() {
 	Rep* r = rep_;
@@ -229,7 +451,26 @@ Status TableBuilder::Finish() {
 	assert(!r->closed);
 	r->closed = true;
 
+	// 等待所有data block写入，再补上它们的index entry
+	if (r->num_threads > 0) {
+		StopThreads();
+		if (ok()) {
+			if (r->pending_index_entry) {
+				r->options.comparator->FindShortSuccessor(&r->last_key);
+				r->index_keys.push_back(r->last_key);
+				r->pending_index_entry = false;
+			}
+			assert(r->index_keys.size() == r->block_handles.size());
+			for (size_t i = 0; i < r->index_keys.size(); i++) {
+				std::string handle_encoding;
+				r->block_handles[i].EncodeTo(&handle_encoding);
+				r->index_block.Add(r->index_keys[i], Slice(handle_encoding));
+			}
+		}
+	}
+
 	BlockHandle filter_block_handle, metaindex_block_handle, index_block_handle;
+	BlockHandle range_del_block_handle;
 
 	// Write filter block
 	// 这块儿是真是写入数据
@@ -238,6 +479,12 @@ Status TableBuilder::Finish() {
 			&filter_block_handle);
 	}
 
+	// Write range tombstone block
+	const bool has_range_del = !r->range_del_block.empty();
+	if (ok() && has_range_del) {
+		WriteBlock(&r->range_del_block, &range_del_block_handle);
+	}
+
 	// Write metaindex block
 	// 这部分是写入index
 	if (ok()) {
@@ -250,6 +497,12 @@ Status TableBuilder::Finish() {
 			filter_block_handle.EncodeTo(&handle_encoding);
 			meta_index_block.Add(key, handle_encoding);
 		}
+		// metaindex中的key必须有序，"filter."排在kRangeDelBlockName之前
+		if (has_range_del) {
+			std::string handle_encoding;
+			range_del_block_handle.EncodeTo(&handle_encoding);
+			meta_index_block.Add(kRangeDelBlockName, handle_encoding);
+		}
 
 		// TODO(postrelease): Add stats and other meta blocks
 		WriteBlock(&meta_index_block, &metaindex_block_handle);
@@ -286,6 +539,9 @@ void TableBuilder::Abandon() {
 	Rep* r = rep_;
 	assert(!r->closed);
 	r->closed = true;
+	if (r->num_threads > 0) {
+		StopThreads();
+	}
 }
 
 uint64_t TableBuilder::NumEntries() const {
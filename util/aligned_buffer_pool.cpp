@@ -0,0 +1,86 @@
+#include "aligned_buffer_pool.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#include "mutexlock.h"
+
+namespace leveldb {
+
+AlignedBufferPool::AlignedBufferPool(size_t alignment, size_t max_pooled_bytes)
+	: alignment_(alignment),
+	max_pooled_bytes_(max_pooled_bytes),
+	pooled_bytes_(0) {
+	assert(alignment >= sizeof(void*) && (alignment & (alignment - 1)) == 0);
+}
+
+AlignedBufferPool::~AlignedBufferPool() {
+	for (int i = 0; i < kNumClasses; i++) {
+		for (size_t j = 0; j < free_[i].size(); j++) {
+			DeleteBuffer(free_[i][j]);
+		}
+	}
+}
+
+char* AlignedBufferPool::NewBuffer(size_t alignment, size_t capacity) {
+	// 多分配alignment字节用于对齐，对齐后的地址之前保存原始的地址
+	char* raw = new char[capacity + alignment];
+	const uintptr_t addr = reinterpret_cast<uintptr_t>(raw) + sizeof(void*);
+	char* buf = reinterpret_cast<char*>((addr + alignment - 1) & ~(alignment - 1));
+	std::memcpy(buf - sizeof(void*), &raw, sizeof(void*));
+	return buf;
+}
+
+void AlignedBufferPool::DeleteBuffer(char* buf) {
+	char* raw;
+	std::memcpy(&raw, buf - sizeof(void*), sizeof(void*));
+	delete[] raw;
+}
+
+char* AlignedBufferPool::Acquire(size_t size, size_t* capacity) {
+	int cls = 0;
+	while (cls < kNumClasses && (alignment_ << cls) < size) {
+		cls++;
+	}
+	if (cls == kNumClasses) {
+		// 超出最大的容量，不放入pool
+		*capacity = (size + alignment_ - 1) & ~(alignment_ - 1);
+		return NewBuffer(alignment_, *capacity);
+	}
+
+	*capacity = alignment_ << cls;
+	{
+		MutexLock l(&mu_);
+		if (!free_[cls].empty()) {
+			char* buf = free_[cls].back();
+			free_[cls].pop_back();
+			pooled_bytes_ -= *capacity;
+			return buf;
+		}
+	}
+	return NewBuffer(alignment_, *capacity);
+}
+
+void AlignedBufferPool::Release(char* buf, size_t capacity) {
+	int cls = 0;
+	while (cls < kNumClasses && (alignment_ << cls) != capacity) {
+		cls++;
+	}
+	if (cls < kNumClasses) {
+		MutexLock l(&mu_);
+		if (pooled_bytes_ + capacity <= max_pooled_bytes_) {
+			free_[cls].push_back(buf);
+			pooled_bytes_ += capacity;
+			return;
+		}
+	}
+	DeleteBuffer(buf);
+}
+
+size_t AlignedBufferPool::pooled_bytes() {
+	MutexLock l(&mu_);
+	return pooled_bytes_;
+}
+
+}  // namespace leveldb
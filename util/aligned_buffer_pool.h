@@ -0,0 +1,59 @@
+#ifndef STORAGE_LEVELDB_UTIL_ALIGNED_BUFFER_POOL_H_
+#define STORAGE_LEVELDB_UTIL_ALIGNED_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <vector>
+
+#include "port.h"
+#include "thread_annotations.h"
+
+namespace leveldb {
+
+// Buffers aligned for direct I/O, whose reads need buffers, offsets and
+// sizes that are multiples of the device's logical block size.  Buffers
+// come in capacities of alignment() times a power of two, and released
+// ones are kept for reuse up to a bound, so that the memory spent on
+// reads stays fixed instead of growing with the page cache.
+//
+// Thread-safe.
+class AlignedBufferPool {
+public:
+	// "alignment" must be a power of two of at least sizeof(void*).  At
+	// most "max_pooled_bytes" of released buffers are kept.
+	AlignedBufferPool(size_t alignment, size_t max_pooled_bytes);
+	~AlignedBufferPool();
+
+	AlignedBufferPool(const AlignedBufferPool&) = delete;
+	AlignedBufferPool& operator=(const AlignedBufferPool&) = delete;
+
+	size_t alignment() const { return alignment_; }
+
+	// Return a buffer of at least "size" bytes aligned to alignment(), and
+	// store its capacity in *capacity.
+	char* Acquire(size_t size, size_t* capacity);
+
+	// Give back a buffer returned by Acquire() with "capacity".
+	void Release(char* buf, size_t capacity);
+
+	// Bytes held by released buffers.
+	size_t pooled_bytes();
+
+private:
+	// Buffers larger than alignment_ << (kNumClasses - 1) are not pooled
+	enum { kNumClasses = 16 };
+
+	static char* NewBuffer(size_t alignment, size_t capacity);
+	static void DeleteBuffer(char* buf);
+
+	const size_t alignment_;
+	const size_t max_pooled_bytes_;
+
+	port::Mutex mu_;
+	// free_[i] holds released buffers of alignment_ << i bytes
+	std::vector<char*> free_[kNumClasses] GUARDED_BY(mu_);
+	size_t pooled_bytes_ GUARDED_BY(mu_);
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_ALIGNED_BUFFER_POOL_H_
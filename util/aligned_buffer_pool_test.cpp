@@ -0,0 +1,48 @@
+#include "aligned_buffer_pool.h"
+
+#include <cstdint>
+
+#include "testharness.h"
+
+namespace leveldb {
+
+class AlignedBufferPoolTest { };
+
+TEST(AlignedBufferPoolTest, AlignmentAndCapacity) {
+  AlignedBufferPool pool(4096, 1 << 20);
+  const size_t sizes[] = {0, 1, 4096, 4097, 100000, 1 << 30};
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    size_t capacity;
+    char* buf = pool.Acquire(sizes[i], &capacity);
+    ASSERT_EQ(0, reinterpret_cast<uintptr_t>(buf) % 4096);
+    ASSERT_EQ(0, capacity % 4096);
+    ASSERT_GE(capacity, sizes[i]);
+    buf[0] = 'a';
+    buf[capacity - 1] = 'b';
+    pool.Release(buf, capacity);
+  }
+}
+
+TEST(AlignedBufferPoolTest, ReuseUpToBound) {
+  AlignedBufferPool pool(512, 4096);
+  size_t capacity;
+  char* a = pool.Acquire(1000, &capacity);
+  ASSERT_EQ(1024, capacity);
+  pool.Release(a, capacity);
+  ASSERT_EQ(1024, pool.pooled_bytes());
+
+  // A buffer of the same capacity is handed out again
+  char* b = pool.Acquire(600, &capacity);
+  ASSERT_TRUE(a == b);
+  ASSERT_EQ(0, pool.pooled_bytes());
+
+  // Released buffers beyond the bound are freed
+  char* c = pool.Acquire(4096, &capacity);
+  char* d = pool.Acquire(1, &capacity);
+  pool.Release(c, 4096);
+  pool.Release(d, 512);
+  pool.Release(b, 1024);
+  ASSERT_EQ(4096, pool.pooled_bytes());
+}
+
+}  // namespace leveldb
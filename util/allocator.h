@@ -0,0 +1,30 @@
+#ifndef STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
+#define STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
+
+#include <cstddef>
+
+namespace leveldb {
+
+// Abstract interface for handing out memory that lives until the
+// allocator itself is destroyed.  SkipList and MemTable allocate
+// through this interface so that the same code can run on top of the
+// single-threaded Arena or on an allocator that supports concurrent
+// callers.
+class Allocator {
+public:
+	virtual ~Allocator() { }
+
+	// Return a pointer to a newly allocated memory block of "bytes" bytes
+	virtual char* Allocate(size_t bytes) = 0;
+
+	// Allocate memory with the normal alignment guarantees provided by malloc
+	virtual char* AllocateAligned(size_t bytes) = 0;
+
+	// Return an estimate of the total memory usage of data allocated so far,
+	// including allocated but not yet used memory
+	virtual size_t MemoryUsage() const = 0;
+};
+
+} // close namespace leveldb
+
+#endif // !STORAGE_LEVELDB_UTIL_ALLOCATOR_H_
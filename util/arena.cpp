@@ -1,27 +1,52 @@
 #include "arena.h"
 
+#if defined(LEVELDB_PLATFORM_POSIX)
+#include <sys/mman.h>
+#endif
+
 namespace leveldb {
 
-static const int kBlockSize{ 4096 };
+// Round block_size up to a whole number of huge pages
+size_t Arena::BlockSize(size_t block_size, size_t huge_page_size) {
+	if (huge_page_size == 0) {
+		return block_size;
+	}
+	return ((block_size + huge_page_size - 1) / huge_page_size) * huge_page_size;
+}
 
-Arena::Arena() : alloc_ptr_(nullptr), alloc_bytes_remaining_(0), blocks_memory_(0) {
+Arena::Arena(size_t block_size, size_t huge_page_size)
+	: block_size_(BlockSize(block_size, huge_page_size)),
+	huge_page_size_(huge_page_size), alloc_ptr_(nullptr),
+	alloc_bytes_remaining_(0), blocks_memory_(0) {
+	assert(block_size_ > 0);
 }
 
 Arena::~Arena() {
 	for (auto i = 0; i < blocks_.size(); ++i) {
 		delete[] blocks_[i];
 	}
+#if defined(LEVELDB_PLATFORM_POSIX)
+	for (auto i = 0; i < mmap_blocks_.size(); ++i) {
+		munmap(mmap_blocks_[i].addr, mmap_blocks_[i].length);
+	}
+#endif
 }
 
 char* Arena::AllocateFallback(size_t bytes) {
-	if (bytes > kBlockSize / 4) {
+	if (bytes > block_size_ / 4) {
 		auto result = AllocateNewBlock(bytes);
 		return result;
 	}
 
-	// bytes < 1 / 4 (1024 KB), allocate a new block(4096)
-	alloc_ptr_ = AllocateNewBlock(kBlockSize);
-	alloc_bytes_remaining_ = kBlockSize;
+	// bytes < 1 / 4 of a block, allocate a new block
+	alloc_ptr_ = nullptr;
+	if (huge_page_size_ > 0) {
+		alloc_ptr_ = AllocateHugePageBlock(block_size_);
+	}
+	if (alloc_ptr_ == nullptr) {
+		alloc_ptr_ = AllocateNewBlock(block_size_);
+	}
+	alloc_bytes_remaining_ = block_size_;
 
 	auto result = alloc_ptr_;
 	alloc_ptr_ += bytes;
@@ -36,6 +61,52 @@ char* Arena::AllocateNewBlock(size_t blocks_bytes) {
 	return result;
 }
 
+char* Arena::AllocateHugePageBlock(size_t block_bytes) {
+#if defined(LEVELDB_PLATFORM_POSIX)
+	void* addr = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+	// Only succeeds if the administrator reserved huge pages
+	// (vm.nr_hugepages) of the default size
+	addr = mmap(nullptr, block_bytes, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+	if (addr == MAP_FAILED) {
+		// Ask for transparent huge pages instead.  The kernel only backs
+		// huge-page-aligned ranges with them, so over-map by one page and
+		// trim both ends to an aligned block.
+		const size_t padded = block_bytes + huge_page_size_;
+		void* raw = mmap(nullptr, padded, PROT_READ | PROT_WRITE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (raw == MAP_FAILED) {
+			return nullptr;
+		}
+		const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+		const uintptr_t aligned = ((begin + huge_page_size_ - 1) / huge_page_size_) * huge_page_size_;
+		const size_t head = aligned - begin;
+		const size_t tail = padded - head - block_bytes;
+		if (head > 0) {
+			munmap(raw, head);
+		}
+		if (tail > 0) {
+			munmap(reinterpret_cast<char*>(aligned) + block_bytes, tail);
+		}
+		addr = reinterpret_cast<void*>(aligned);
+#if defined(MADV_HUGEPAGE)
+		madvise(addr, block_bytes, MADV_HUGEPAGE);
+#endif
+	}
+	MmapBlock block;
+	block.addr = addr;
+	block.length = block_bytes;
+	mmap_blocks_.push_back(block);
+	blocks_memory_ += block_bytes;
+	return reinterpret_cast<char*>(addr);
+#else
+	(void)block_bytes;
+	return nullptr;
+#endif
+}
+
 char* Arena::AllocateAligned(size_t bytes) {
 	const int align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
 	assert((align & (align - 1)) == 0);
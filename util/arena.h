@@ -3,25 +3,41 @@
 
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <vector>
 
+#include "allocator.h"
+
 namespace leveldb {
 
-class Arena {
+class Arena : public Allocator {
 public:
-	Arena();
-	~Arena();
+	// Small requests are carved out of blocks of "block_size" bytes.
+	static const size_t kDefaultBlockSize = 4096;
+
+	// If "huge_page_size" is non-zero, block_size is rounded up to a
+	// multiple of it and blocks are mmap()ed so they can be backed by huge
+	// pages: explicitly reserved ones (MAP_HUGETLB) when available,
+	// otherwise transparent huge pages requested with madvise().  Falls back
+	// to the heap on platforms without mmap().
+	explicit Arena(size_t block_size = kDefaultBlockSize,
+		size_t huge_page_size = 0);
+	~Arena() override;
+
+	// Size of the blocks of an Arena(block_size, huge_page_size)
+	static size_t BlockSize(size_t block_size, size_t huge_page_size);
 
 	// Return a pointer to a newly allocated memory block of "bytes bytes
-	char* Allocate(size_t bytes);
+	char* Allocate(size_t bytes) override;
 
 	// Allocate memory with the normal alignment guarantees provided by malloc
-	char* AllocateAligned(size_t bytes);
+	char* AllocateAligned(size_t bytes) override;
 
 	// Return an estimate of the total memory usage of data allocated by arena,
 	// including allocated but not yest used memory
-	size_t MemoryUsage() const {
-		return blocks_memory_ + blocks_.capacity() * sizeof(char*);
+	size_t MemoryUsage() const override {
+		return blocks_memory_ + blocks_.capacity() * sizeof(char*) +
+			mmap_blocks_.capacity() * sizeof(MmapBlock);
 	}
 
 	// Avoid copy
@@ -29,6 +45,12 @@ public:
 	Arena& operator=(const Arena&) = delete;
 
 private:
+	// Size of the blocks requested from the heap
+	const size_t block_size_;
+
+	// Non-zero if regular blocks should be backed by huge pages
+	const size_t huge_page_size_;
+
 	// Allocate state
 	char* alloc_ptr_;
 	size_t alloc_bytes_remaining_;
@@ -36,11 +58,20 @@ private:
 	// Array of allocated memory blocks
 	std::vector<char*> blocks_;
 
+	// Blocks obtained from mmap(), released with munmap()
+	struct MmapBlock {
+		void* addr;
+		size_t length;
+	};
+	std::vector<MmapBlock> mmap_blocks_;
+
 	// Memory allocated so far in bytes
 	size_t blocks_memory_;
 
 	char* AllocateFallback(size_t bytes);
 	char* AllocateNewBlock(size_t block_bytes);
+	// Returns nullptr if the platform cannot map the block
+	char* AllocateHugePageBlock(size_t block_bytes);
 };
 
 inline char* Arena::Allocate(size_t bytes) {
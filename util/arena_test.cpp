@@ -4,6 +4,8 @@
 
 #include "arena.h"
 
+#include <cstring>
+
 #include "random.h"
 #include "testharness.h"
 
@@ -61,4 +63,35 @@ TEST(ArenaTest, Simple) {
   }
 }
 
+TEST(ArenaTest, CustomBlockSize) {
+  Arena arena(64 << 10);
+  // Requests over a quarter of a block get a block of their own
+  arena.Allocate(20 << 10);
+  ASSERT_GE(arena.MemoryUsage(), 20 << 10);
+  ASSERT_LT(arena.MemoryUsage(), 64 << 10);
+  arena.Allocate(10);
+  ASSERT_GE(arena.MemoryUsage(), (64 << 10) + (20 << 10));
+  ASSERT_LT(arena.MemoryUsage(), 2 * (64 << 10));
+}
+
+TEST(ArenaTest, HugePageBlocks) {
+  // Works whether or not the system has huge pages to hand out
+  const size_t kHugePageSize = 2 << 20;
+  Arena arena(4096, kHugePageSize);
+  std::vector<char*> allocated;
+  for (int i = 0; i < 1000; i++) {
+    char* r = (i % 2 == 0) ? arena.Allocate(1000) : arena.AllocateAligned(1000);
+    memset(r, i % 256, 1000);
+    allocated.push_back(r);
+  }
+  // Blocks are rounded up to the huge page size
+  ASSERT_GE(arena.MemoryUsage(), kHugePageSize);
+  ASSERT_LT(arena.MemoryUsage(), 2 * kHugePageSize);
+  for (size_t i = 0; i < allocated.size(); i++) {
+    for (int b = 0; b < 1000; b++) {
+      ASSERT_EQ(int(allocated[i][b]) & 0xff, i % 256);
+    }
+  }
+}
+
 }  // namespace leveldb
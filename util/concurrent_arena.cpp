@@ -0,0 +1,99 @@
+#include "concurrent_arena.h"
+
+#include <cstdint>
+#include <new>
+#include <thread>
+
+#include "mutexlock.h"
+
+namespace leveldb {
+
+namespace {
+
+// Shard index of the calling thread, assigned round-robin on first use.
+// A thread uses the same index for every ConcurrentArena, masked down to
+// that arena's shard count.
+std::atomic<int> g_next_shard_index(0);
+thread_local int tls_shard_index = -1;
+
+int ShardCount() {
+	unsigned int cores = std::thread::hardware_concurrency();
+	int count = 1;
+	while (count < static_cast<int>(cores) && count < 256) {
+		count <<= 1;
+	}
+	return count;
+}
+
+}  // namespace
+
+ConcurrentArena::ConcurrentArena(size_t block_size, size_t huge_page_size)
+	: shard_block_size_(Arena::BlockSize(block_size, huge_page_size) / 8),
+	shards_memory_(nullptr),
+	shards_(nullptr),
+	shard_mask_(ShardCount() - 1),
+	arena_(block_size, huge_page_size),
+	memory_usage_(0) {
+	assert(shard_block_size_ > 0);
+	// C++11的new[]不保证alignas超过默认对齐的类型，自己对齐到cache line
+	const int count = shard_mask_ + 1;
+	shards_memory_ = new char[count * sizeof(Shard) + kCacheLineSize - 1];
+	const uintptr_t mod =
+		reinterpret_cast<uintptr_t>(shards_memory_) & (kCacheLineSize - 1);
+	shards_ = reinterpret_cast<Shard*>(
+		shards_memory_ + (mod == 0 ? 0 : kCacheLineSize - mod));
+	for (int i = 0; i < count; i++) {
+		new (&shards_[i]) Shard();
+	}
+}
+
+ConcurrentArena::~ConcurrentArena() {
+	for (int i = 0; i <= shard_mask_; i++) {
+		shards_[i].~Shard();
+	}
+	delete[] shards_memory_;
+}
+
+ConcurrentArena::Shard* ConcurrentArena::ThisShard() {
+	if (tls_shard_index < 0) {
+		tls_shard_index = g_next_shard_index.fetch_add(1, std::memory_order_relaxed);
+	}
+	return &shards_[tls_shard_index & shard_mask_];
+}
+
+char* ConcurrentArena::ArenaAllocateAligned(size_t bytes) {
+	MutexLock l(&arena_mu_);
+	char* result = arena_.AllocateAligned(bytes);
+	memory_usage_.store(arena_.MemoryUsage(), std::memory_order_relaxed);
+	return result;
+}
+
+char* ConcurrentArena::AllocateImpl(size_t bytes, bool aligned) {
+	assert(bytes > 0);
+	// Requests that would use up a large part of a slab go directly to
+	// the arena, just like Arena hands large requests their own block.
+	if (bytes > shard_block_size_ / 4) {
+		return ArenaAllocateAligned(bytes);
+	}
+
+	Shard* s = ThisShard();
+	MutexLock l(&s->mu);
+	size_t slop = 0;
+	if (aligned) {
+		const size_t align = (sizeof(void*) > 8) ? sizeof(void*) : 8;
+		size_t current_mod = reinterpret_cast<uintptr_t>(s->free_begin) & (align - 1);
+		slop = (current_mod == 0 ? 0 : align - current_mod);
+	}
+	if (bytes + slop > s->free_bytes) {
+		// The leftover of the old slab is wasted, at most a quarter of a slab
+		s->free_begin = ArenaAllocateAligned(shard_block_size_);
+		s->free_bytes = shard_block_size_;
+		slop = 0;
+	}
+	char* result = s->free_begin + slop;
+	s->free_begin += bytes + slop;
+	s->free_bytes -= bytes + slop;
+	return result;
+}
+
+}  // namespace leveldb
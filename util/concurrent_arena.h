@@ -0,0 +1,85 @@
+#ifndef STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
+#define STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
+
+#include <atomic>
+#include <cstddef>
+
+#include "allocator.h"
+#include "arena.h"
+#include "port.h"
+#include "thread_annotations.h"
+
+namespace leveldb {
+
+// ConcurrentArena wraps an Arena so that it can be used by several
+// threads at once.  Every thread is bound to one of a fixed number of
+// shards (one per hardware thread).  Each shard owns a small slab that
+// is refilled from the underlying Arena, so in the common case an
+// allocation only takes that shard's lock, which is uncontended unless
+// there are more writers than cores.  Large requests go straight to the
+// Arena.
+class ConcurrentArena : public Allocator {
+public:
+	// Same as Arena: small requests are carved out of blocks of
+	// "block_size" bytes, backed by huge pages if "huge_page_size" is
+	// non-zero.  Shard slabs are an eighth of a block, after block_size is
+	// rounded up to huge pages, so that they divide the blocks evenly.
+	explicit ConcurrentArena(size_t block_size = kDefaultBlockSize,
+		size_t huge_page_size = 0);
+	~ConcurrentArena() override;
+
+	static const size_t kDefaultBlockSize = 64 << 10;
+
+	char* Allocate(size_t bytes) override {
+		return AllocateImpl(bytes, false);
+	}
+
+	char* AllocateAligned(size_t bytes) override {
+		return AllocateImpl(bytes, true);
+	}
+
+	// Safe to call at any time, including while other threads allocate.
+	size_t MemoryUsage() const override {
+		return memory_usage_.load(std::memory_order_relaxed);
+	}
+
+	// Avoid copy
+	ConcurrentArena(const ConcurrentArena&) = delete;
+	ConcurrentArena& operator=(const ConcurrentArena&) = delete;
+
+private:
+	enum { kCacheLineSize = 64 };
+
+	// Padded to a cache line so that shards used by different cores do
+	// not share one.
+	struct alignas(kCacheLineSize) Shard {
+		Shard() : free_begin(nullptr), free_bytes(0) { }
+
+		port::Mutex mu;
+		char* free_begin GUARDED_BY(mu);
+		size_t free_bytes GUARDED_BY(mu);
+	};
+
+	char* AllocateImpl(size_t bytes, bool aligned);
+
+	// Returns the shard the calling thread allocates from.
+	Shard* ThisShard();
+
+	// Allocate from arena_ under arena_mu_ and refresh memory_usage_.
+	char* ArenaAllocateAligned(size_t bytes);
+
+	const size_t shard_block_size_;
+	char* shards_memory_;  // Holds shards_, which are aligned within it
+	Shard* shards_;
+	int shard_mask_;  // Number of shards minus one, a power of two minus one
+
+	port::Mutex arena_mu_;
+	Arena arena_ GUARDED_BY(arena_mu_);
+
+	// arena_.MemoryUsage() as of the last refill, readable without a lock.
+	std::atomic<size_t> memory_usage_;
+};
+
+}  // namespace leveldb
+
+#endif  // STORAGE_LEVELDB_UTIL_CONCURRENT_ARENA_H_
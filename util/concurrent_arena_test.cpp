@@ -0,0 +1,121 @@
+#include "concurrent_arena.h"
+
+#include <cstring>
+#include <vector>
+
+#include "env.h"
+#include "port.h"
+#include "random.h"
+#include "testharness.h"
+
+namespace leveldb {
+
+class ConcurrentArenaTest { };
+
+TEST(ConcurrentArenaTest, EmptyConcurrentArena) {
+	ConcurrentArena arena;
+	ASSERT_EQ(0, arena.MemoryUsage());
+}
+
+TEST(ConcurrentArenaTest, SimpleConcurrentArena) {
+	std::vector<std::pair<size_t, char*> > allocated;
+	ConcurrentArena arena(4096);
+	const int N = 100000;
+	size_t bytes = 0;
+	Random rnd(301);
+	for (int i = 0; i < N; i++) {
+		size_t s = rnd.OneIn(4000) ? rnd.Uniform(6000) :
+			(rnd.OneIn(10) ? rnd.Uniform(100) : rnd.Uniform(20));
+		if (s == 0) {
+			s = 1;
+		}
+		char* r;
+		if (rnd.OneIn(10)) {
+			r = arena.AllocateAligned(s);
+			ASSERT_EQ(0, reinterpret_cast<uintptr_t>(r) & 7);
+		}
+		else {
+			r = arena.Allocate(s);
+		}
+		for (size_t b = 0; b < s; b++) {
+			r[b] = i % 256;
+		}
+		bytes += s;
+		allocated.push_back(std::make_pair(s, r));
+		ASSERT_GE(arena.MemoryUsage(), bytes);
+	}
+	for (size_t i = 0; i < allocated.size(); i++) {
+		size_t num_bytes = allocated[i].first;
+		const char* p = allocated[i].second;
+		for (size_t b = 0; b < num_bytes; b++) {
+			ASSERT_EQ(int(p[b]) & 0xff, i % 256);
+		}
+	}
+}
+
+namespace {
+
+struct ArenaThreadState {
+	ConcurrentArena* arena;
+	int id;
+	std::vector<std::pair<size_t, char*> > allocated;
+
+	port::Mutex* mu;
+	port::CondVar* cv;
+	int* done;
+};
+
+void AllocateFromThread(void* arg) {
+	ArenaThreadState* state = reinterpret_cast<ArenaThreadState*>(arg);
+	Random rnd(301 + state->id);
+	for (int i = 0; i < 20000; i++) {
+		size_t s = rnd.OneIn(100) ? 1 + rnd.Uniform(5000) : 1 + rnd.Uniform(150);
+		char* r = rnd.OneIn(2) ? state->arena->Allocate(s)
+			: state->arena->AllocateAligned(s);
+		memset(r, state->id, s);
+		state->allocated.push_back(std::make_pair(s, r));
+	}
+	state->mu->Lock();
+	(*state->done)++;
+	state->cv->Signal();
+	state->mu->Unlock();
+}
+
+}  // namespace
+
+TEST(ConcurrentArenaTest, ConcurrentArenaMultipleThreads) {
+	const int kThreads = 4;
+	ConcurrentArena arena;
+	port::Mutex mu;
+	port::CondVar cv(&mu);
+	int done = 0;
+	ArenaThreadState states[kThreads];
+	for (int i = 0; i < kThreads; i++) {
+		states[i].arena = &arena;
+		states[i].id = i + 1;
+		states[i].mu = &mu;
+		states[i].cv = &cv;
+		states[i].done = &done;
+		Env::Default()->StartThread(AllocateFromThread, &states[i]);
+	}
+	mu.Lock();
+	while (done < kThreads) {
+		cv.Wait();
+	}
+	mu.Unlock();
+
+	// No allocation may overlap with one handed to another thread
+	size_t bytes = 0;
+	for (int i = 0; i < kThreads; i++) {
+		for (size_t j = 0; j < states[i].allocated.size(); j++) {
+			const char* p = states[i].allocated[j].second;
+			for (size_t b = 0; b < states[i].allocated[j].first; b++) {
+				ASSERT_EQ(states[i].id, p[b]);
+			}
+			bytes += states[i].allocated[j].first;
+		}
+	}
+	ASSERT_GE(arena.MemoryUsage(), bytes);
+}
+
+}  // namespace leveldb
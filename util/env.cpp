@@ -9,15 +9,56 @@ Status Env::NewAppendableFile(const std::string& fname, WritableFile** result) {
   return Status::NotSupported("NewAppendableFile", fname);
 }
 
+Status Env::NewDirectRandomAccessFile(const std::string& fname,
+	RandomAccessFile** result) {
+	return NewRandomAccessFile(fname, result);
+}
+
+Status Env::NewDirectWritableFile(const std::string& fname,
+	WritableFile** result) {
+	return NewWritableFile(fname, result);
+}
+
+Status Env::ReuseWritableFile(const std::string& fname,
+	const std::string& old_fname,
+	WritableFile** result) {
+	Status s = RenameFile(old_fname, fname);
+	if (!s.ok()) {
+		*result = NULL;
+		return s;
+	}
+	return NewWritableFile(fname, result);
+}
+
 SequentialFile::~SequentialFile() {
 }
 
 RandomAccessFile::~RandomAccessFile() {
 }
 
+Status RandomAccessFile::MultiRead(ReadRequest* reqs, size_t n) const {
+	for (size_t i = 0; i < n; i++) {
+		reqs[i].status = Read(reqs[i].offset, reqs[i].len, &reqs[i].result,
+			reqs[i].scratch);
+	}
+	return Status::OK();
+}
+
 WritableFile::~WritableFile() {
 }
 
+Status WritableFile::AppendV(const Slice* data, size_t n) {
+	Status s;
+	for (size_t i = 0; s.ok() && i < n; i++) {
+		s = Append(data[i]);
+	}
+	return s;
+}
+
+Status WritableFile::Allocate(uint64_t offset, uint64_t len) {
+	return Status::OK();
+}
+
 Logger::~Logger() {
 }
 
@@ -6,8 +6,10 @@
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <atomic>
 #include <cerrno>
 #include <cstddef>
@@ -16,13 +18,16 @@
 #include <cstdlib>
 #include <cstring>
 #include <limits>
+#include <memory>
 #include <queue>
 #include <set>
 #include <string>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 
+#include "aligned_buffer_pool.h"
 #include "env.h"
 #include "slice.h"
 #include "status.h"
@@ -31,6 +36,11 @@
 #include "env_posix_test_helper.h"
 #include "posix_logger.h"
 
+#if HAVE_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif  // HAVE_IO_URING
+
 namespace leveldb {
 
 	namespace {
@@ -53,6 +63,31 @@ namespace leveldb {
 
 		constexpr const size_t kWritableFileBufferSize = 65536;
 
+		// O_DIRECT writes must start at offsets and have sizes that are
+		// multiples of the logical block size of the device, at most 4096 on
+		// common devices, and come from buffers aligned the same way.
+		constexpr const size_t kDirectIOAlignment = 4096;
+
+		// Direct writes wait for the device, so they are batched in larger
+		// buffers than the cached ones.
+		constexpr const size_t kDirectWritableFileBufferSize = 1 << 20;
+
+		// Bytes of released buffers kept by the pool that direct reads are
+		// staged in
+		constexpr const size_t kDirectReadPoolBytes = 8 << 20;
+
+		// Number of pieces passed to one writev() or preadv() call, within the
+		// usual IOV_MAX of 1024
+		constexpr const int kMaxIovecs = 64;
+
+		// MultiRead() merges the requests with at most this many bytes between
+		// them into one read, which is cheaper than another system call and
+		// another trip to the device.
+		constexpr const size_t kMultiReadCoalesceGap = 16 << 10;
+
+		// Largest range read by one merged read
+		constexpr const size_t kMultiReadMaxCoalescedBytes = 1 << 20;
+
 		Status PosixError(const std::string& context, int error_number) {
 			if (error_number == ENOENT) {
 				return Status::NotFound(context, std::strerror(error_number));
@@ -62,6 +97,35 @@ namespace leveldb {
 			}
 		}
 
+		// Ensures that all the caches associated with the given file descriptor's
+		// data are flushed all the way to durable media, and can withstand power
+		// failures.
+		//
+		// The path argument is only used to populate the description string in the
+		// returned Status if an error occurs.
+		Status SyncFd(int fd, const std::string& fd_path) {
+#if HAVE_FULLFSYNC
+			// On macOS and iOS, fsync() doesn't guarantee durability past power
+			// failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
+			// filesystems don't support fcntl(F_FULLFSYNC), and require a fallback to
+			// fsync().
+			if (::fcntl(fd, F_FULLFSYNC) == 0) {
+				return Status::OK();
+			}
+#endif  // HAVE_FULLFSYNC
+
+#if HAVE_FDATASYNC
+			bool sync_success = ::fdatasync(fd) == 0;
+#else
+			bool sync_success = ::fsync(fd) == 0;
+#endif  // HAVE_FDATASYNC
+
+			if (sync_success) {
+				return Status::OK();
+			}
+			return PosixError(fd_path, errno);
+		}
+
 		// Helper class to limit resource usage to avoid exhaustion.
 		// Currently used to limit read-only file descriptors and mmap file usage
 		// so that we do not run out of file descriptors or virtual memory, or run into
@@ -98,6 +162,319 @@ namespace leveldb {
 			std::atomic<int> acquires_allowed_;
 		};
 
+		// One read of a batch passed to PreadBatch(), scattered over iov[0,iovcnt-1]
+		// as by preadv()
+		struct PosixRead {
+			const struct iovec* iov;
+			int iovcnt;
+			uint64_t offset;
+			ssize_t result;  // Set to the bytes read, or -errno
+		};
+
+#if HAVE_IO_URING && defined(__NR_io_uring_setup)
+		// Cleared by EnvPosixTestHelper::SetIoUringEnabled(false), and for good
+		// when io_uring turns out to be unavailable (old kernels, seccomp).
+		std::atomic<bool> g_io_uring_enabled(true);
+
+		// An io_uring instance, set up with the raw system calls so that liburing
+		// is not required.  Read() submits a whole batch of reads with a single
+		// io_uring_enter() call (per kEntries reads) and waits for all of them.
+		//
+		// Instances are not thread-safe; every thread uses its own, see
+		// ThreadLocal().
+		class IoUring {
+		public:
+			// Size of the submission queue
+			static constexpr unsigned kEntries = 64;
+
+			// The calling thread's instance, or nullptr if io_uring is disabled.
+			static IoUring* ThreadLocal() {
+				if (!g_io_uring_enabled.load(std::memory_order_relaxed)) {
+					return nullptr;
+				}
+				static thread_local std::unique_ptr<IoUring> ring;
+				if (ring == nullptr) {
+					ring.reset(new IoUring);
+					if (!ring->ok()) {
+						ring.reset();
+						g_io_uring_enabled.store(false, std::memory_order_relaxed);
+					}
+				}
+				return ring.get();
+			}
+
+			IoUring()
+				: ring_fd_(-1),
+				sq_ptr_(MAP_FAILED),
+				cq_ptr_(MAP_FAILED),
+				sqes_ptr_(MAP_FAILED),
+				sq_size_(0),
+				cq_size_(0),
+				sq_entries_(0) {
+				struct io_uring_params params;
+				std::memset(&params, 0, sizeof(params));
+				ring_fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, kEntries, &params));
+				if (ring_fd_ < 0) {
+					return;
+				}
+				sq_entries_ = params.sq_entries;
+				sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+				cq_size_ = params.cq_off.cqes +
+					params.cq_entries * sizeof(struct io_uring_cqe);
+				const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+				if (single_mmap) {
+					sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+				}
+
+				sq_ptr_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE,
+					MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQ_RING);
+				if (sq_ptr_ == MAP_FAILED) {
+					return;
+				}
+				if (single_mmap) {
+					cq_ptr_ = sq_ptr_;
+				}
+				else {
+					cq_ptr_ = ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+						MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_CQ_RING);
+					if (cq_ptr_ == MAP_FAILED) {
+						return;
+					}
+				}
+				sqes_ptr_ = ::mmap(nullptr, sq_entries_ * sizeof(struct io_uring_sqe),
+					PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+					IORING_OFF_SQES);
+				if (sqes_ptr_ == MAP_FAILED) {
+					return;
+				}
+
+				char* sq = static_cast<char*>(sq_ptr_);
+				sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+				sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+				sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+				sqes_ = static_cast<struct io_uring_sqe*>(sqes_ptr_);
+				char* cq = static_cast<char*>(cq_ptr_);
+				cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+				cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+				cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+				cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+			}
+
+			~IoUring() {
+				if (sqes_ptr_ != MAP_FAILED) {
+					::munmap(sqes_ptr_, sq_entries_ * sizeof(struct io_uring_sqe));
+				}
+				if (cq_ptr_ != MAP_FAILED && cq_ptr_ != sq_ptr_) {
+					::munmap(cq_ptr_, cq_size_);
+				}
+				if (sq_ptr_ != MAP_FAILED) {
+					::munmap(sq_ptr_, sq_size_);
+				}
+				if (ring_fd_ >= 0) {
+					::close(ring_fd_);
+				}
+			}
+
+			IoUring(const IoUring&) = delete;
+			IoUring& operator=(const IoUring&) = delete;
+
+			bool ok() const { return sqes_ptr_ != MAP_FAILED; }
+
+			// Perform reads[0,n-1] on fd and store their results.  If
+			// io_uring_enter() fails, the reads submitted so far are still waited
+			// for, so that none is left in flight, and the others get -EAGAIN for
+			// the caller to perform them itself.
+			void Read(int fd, PosixRead* reads, size_t n) {
+				size_t done = 0;
+				while (done < n) {
+					const unsigned count =
+						static_cast<unsigned>(std::min<size_t>(n - done, sq_entries_));
+					// 只有这个线程生产submission，tail不需要同步地读取
+					unsigned tail = *sq_tail_;
+					for (unsigned i = 0; i < count; i++) {
+						const PosixRead& read = reads[done + i];
+						const unsigned index = tail & sq_mask_;
+						struct io_uring_sqe* sqe = &sqes_[index];
+						std::memset(sqe, 0, sizeof(*sqe));
+						sqe->opcode = IORING_OP_READV;
+						sqe->fd = fd;
+						sqe->addr = reinterpret_cast<uint64_t>(read.iov);
+						sqe->len = static_cast<unsigned>(read.iovcnt);
+						sqe->off = read.offset;
+						sqe->user_data = done + i;
+						sq_array_[index] = index;
+						tail++;
+					}
+					__atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+
+					// 提交这一批请求，等待并收割全部的完成事件
+					unsigned submitted = 0;
+					unsigned completed = 0;
+					unsigned expected = count;
+					bool failed = false;
+					while (completed < expected) {
+						const long ret = ::syscall(__NR_io_uring_enter, ring_fd_,
+							failed ? 0 : count - submitted, expected - completed,
+							IORING_ENTER_GETEVENTS, nullptr, 0);
+						if (ret < 0) {
+							if (errno == EINTR || errno == EAGAIN || errno == EBUSY || failed) {
+								// 已经提交的请求可能还在写入调用者的buffer，
+								// 全部完成之前不能返回
+								continue;  // Retry
+							}
+							g_io_uring_enabled.store(false, std::memory_order_relaxed);
+							// 撤回还没有提交的请求，交给调用者用pread()完成
+							failed = true;
+							expected = submitted;
+							tail -= count - submitted;
+							__atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+							for (unsigned i = submitted; i < count; i++) {
+								reads[done + i].result = -EAGAIN;
+							}
+							continue;
+						}
+						if (!failed) {
+							submitted += static_cast<unsigned>(ret);
+						}
+
+						unsigned head = *cq_head_;
+						const unsigned cq_tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+						for (; head != cq_tail; head++) {
+							const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+							reads[cqe.user_data].result = cqe.res;
+							completed++;
+						}
+						__atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+					}
+					done += count;
+					if (failed) {
+						for (; done < n; done++) {
+							reads[done].result = -EAGAIN;
+						}
+					}
+				}
+			}
+
+		private:
+			int ring_fd_;
+			void* sq_ptr_;
+			void* cq_ptr_;
+			void* sqes_ptr_;
+			size_t sq_size_;
+			size_t cq_size_;
+			unsigned sq_entries_;
+
+			// Pointers into the rings shared with the kernel
+			unsigned* sq_tail_;
+			unsigned sq_mask_;
+			unsigned* sq_array_;
+			struct io_uring_sqe* sqes_;
+			unsigned* cq_head_;
+			unsigned* cq_tail_;
+			unsigned cq_mask_;
+			struct io_uring_cqe* cqes_;
+		};
+#endif  // HAVE_IO_URING && defined(__NR_io_uring_setup)
+
+		// Finish "read" with pread()/preadv(), given that its first "done" bytes
+		// were read already: read until all of iov is filled or the end of the
+		// file.  A file opened with O_DIRECT can only continue at multiples of
+		// "alignment", so a read that ends elsewhere is taken to have reached
+		// the end of the file.  Returns the total bytes read, or -errno.
+		ssize_t PreadRemaining(int fd, const PosixRead& read, size_t done,
+			size_t alignment) {
+			struct iovec iov[kMaxIovecs];
+			assert(read.iovcnt <= kMaxIovecs);
+			std::copy(read.iov, read.iov + read.iovcnt, iov);
+			int first = 0;
+			size_t total = done;
+			while (total % alignment == 0) {
+				// 跳过已经读入的部分
+				while (first < read.iovcnt && done >= iov[first].iov_len) {
+					done -= iov[first].iov_len;
+					first++;
+				}
+				if (first == read.iovcnt) {
+					return static_cast<ssize_t>(total);
+				}
+				iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + done;
+				iov[first].iov_len -= done;
+
+				const off_t offset = static_cast<off_t>(read.offset + total);
+				ssize_t read_size;
+#if HAVE_PREADV
+				read_size = (first + 1 == read.iovcnt) ?
+					::pread(fd, iov[first].iov_base, iov[first].iov_len, offset) :
+					::preadv(fd, iov + first, read.iovcnt - first, offset);
+#else
+				assert(first + 1 == read.iovcnt);
+				read_size = ::pread(fd, iov[first].iov_base, iov[first].iov_len, offset);
+#endif  // HAVE_PREADV
+				if (read_size < 0) {
+					if (errno == EINTR) {
+						done = 0;
+						continue;  // Retry
+					}
+					return -errno;
+				}
+				if (read_size == 0) {
+					return static_cast<ssize_t>(total);  // End of the file
+				}
+				total += read_size;
+				done = read_size;
+			}
+			return static_cast<ssize_t>(total);
+		}
+
+		// Perform reads[0,n-1] on fd: all in flight at once with io_uring where
+		// the kernel supports it, otherwise one pread() after another.
+		// "alignment" is as for PreadRemaining().
+		void PreadBatch(int fd, PosixRead* reads, size_t n, size_t alignment) {
+			bool submitted = false;
+#if HAVE_IO_URING && defined(__NR_io_uring_setup)
+			if (n > 1) {
+				IoUring* ring = IoUring::ThreadLocal();
+				if (ring != nullptr) {
+					ring->Read(fd, reads, n);
+					submitted = true;
+				}
+			}
+#endif  // HAVE_IO_URING && defined(__NR_io_uring_setup)
+			for (size_t i = 0; i < n; i++) {
+				PosixRead* read = &reads[i];
+				size_t done = 0;
+				if (submitted) {
+					if (read->result == -EAGAIN || read->result == -EINTR) {
+						// io_uring的请求被中断或者没有提交时用pread()重试
+					}
+					else if (read->result <= 0) {
+						continue;
+					}
+					else {
+						size_t size = 0;
+						for (int j = 0; j < read->iovcnt; j++) {
+							size += read->iov[j].iov_len;
+						}
+						if (static_cast<size_t>(read->result) == size) {
+							continue;
+						}
+						// 读到的数据不完整，继续读剩下的部分，直到文件结束
+						done = static_cast<size_t>(read->result);
+					}
+				}
+				read->result = PreadRemaining(fd, *read, done, alignment);
+			}
+		}
+
+		// Store "status" in all of reqs[0,n-1] and return it
+		Status FailRequests(ReadRequest* reqs, size_t n, const Status& status) {
+			for (size_t i = 0; i < n; i++) {
+				reqs[i].result = Slice(reqs[i].scratch, 0);
+				reqs[i].status = status;
+			}
+			return status;
+		}
+
 		// Implements sequential read access in a file using read().
 		//
 		// Instances of this class are thread-friendly but not thread-safe, as required
@@ -192,6 +569,97 @@ namespace leveldb {
 				return status;
 			}
 
+			Status MultiRead(ReadRequest* reqs, size_t n) const override {
+				int fd = fd_;
+				if (!has_permanent_fd_) {
+					fd = ::open(filename_.c_str(), O_RDONLY | kOpenBaseFlags);
+					if (fd < 0) {
+						return FailRequests(reqs, n, PosixError(filename_, errno));
+					}
+				}
+
+				// 按offset排序，相邻或者距离很近的请求合并为一次preadv()，
+				// 请求之间的数据读入gap_buffer后丢弃
+				std::vector<size_t> order(n);
+				for (size_t i = 0; i < n; i++) {
+					order[i] = i;
+				}
+				std::sort(order.begin(), order.end(), [reqs](size_t a, size_t b) {
+					return reqs[a].offset < reqs[b].offset;
+				});
+				std::unique_ptr<char[]> gap_buffer;
+				std::vector<struct iovec> iovecs(2 * n);
+				std::vector<PosixRead> reads;
+				std::vector<size_t> first_request;  // Into order, for each read
+				uint64_t end = 0;  // End of the range of reads.back()
+				for (size_t k = 0; k < n; k++) {
+					const ReadRequest& req = reqs[order[k]];
+					PosixRead* read = reads.empty() ? nullptr : &reads.back();
+					bool merge = false;
+#if HAVE_PREADV
+					// 重叠的请求不能读入同一个iovec序列
+					merge = (read != nullptr && req.offset >= end &&
+						req.offset - end <= kMultiReadCoalesceGap &&
+						req.offset + req.len - read->offset <= kMultiReadMaxCoalescedBytes &&
+						read->iovcnt + 2 <= kMaxIovecs);
+#endif  // HAVE_PREADV
+					struct iovec* iov = &iovecs[k * 2];
+					if (merge) {
+						if (req.offset > end) {
+							if (gap_buffer == nullptr) {
+								gap_buffer.reset(new char[kMultiReadCoalesceGap]);
+							}
+							iov->iov_base = gap_buffer.get();
+							iov->iov_len = static_cast<size_t>(req.offset - end);
+						}
+						else {
+							// 和前一个请求相邻，gap的长度为0
+							iov->iov_base = nullptr;
+							iov->iov_len = 0;
+						}
+						read->iovcnt++;
+					}
+					else {
+						reads.push_back(PosixRead());
+						first_request.push_back(k);
+						read = &reads.back();
+						read->iov = iov + 1;
+						read->iovcnt = 0;
+						read->offset = req.offset;
+					}
+					iov[1].iov_base = req.scratch;
+					iov[1].iov_len = req.len;
+					read->iovcnt++;
+					end = req.offset + req.len;
+				}
+				PreadBatch(fd, reads.data(), reads.size(), 1);
+
+				// 把每次读取的结果分给其中的请求
+				for (size_t r = 0; r < reads.size(); r++) {
+					const size_t last = (r + 1 < reads.size()) ? first_request[r + 1] : n;
+					for (size_t k = first_request[r]; k < last; k++) {
+						ReadRequest* req = &reqs[order[k]];
+						if (reads[r].result < 0) {
+							req->result = Slice(req->scratch, 0);
+							req->status = PosixError(filename_, static_cast<int>(-reads[r].result));
+							continue;
+						}
+						const uint64_t read_end = reads[r].offset + reads[r].result;
+						const size_t size = (read_end > req->offset) ?
+							static_cast<size_t>(std::min<uint64_t>(read_end - req->offset, req->len)) : 0;
+						req->result = Slice(req->scratch, size);
+						req->status = Status::OK();
+					}
+				}
+
+				if (!has_permanent_fd_) {
+					// Close the temporary file descriptor opened earlier.
+					assert(fd != fd_);
+					::close(fd);
+				}
+				return Status::OK();
+			}
+
 		private:
 			const bool has_permanent_fd_;  // If false, the file is opened on every read.
 			const int fd_;                 // -1 if has_permanent_fd_ is false.
@@ -199,6 +667,174 @@ namespace leveldb {
 			const std::string filename_;
 		};
 
+#if HAVE_O_DIRECT
+		// Implements random read access in a file opened with O_DIRECT, using
+		// pread().  Reads whose offset, size and scratch are aligned to
+		// kDirectIOAlignment go straight into scratch; the others read the
+		// aligned range around them into a buffer of |buffer_pool| and copy the
+		// requested part out.
+		//
+		// Instances of this class are thread-safe, as required by the
+		// RandomAccessFile API.
+		class PosixDirectRandomAccessFile final : public RandomAccessFile {
+		public:
+			// The new instance takes ownership of |fd|. |fd_limiter| and
+			// |buffer_pool| must outlive this instance.
+			PosixDirectRandomAccessFile(std::string filename, int fd,
+				Limiter* fd_limiter, AlignedBufferPool* buffer_pool)
+				: has_permanent_fd_(fd_limiter->Acquire()),
+				fd_(has_permanent_fd_ ? fd : -1),
+				fd_limiter_(fd_limiter),
+				buffer_pool_(buffer_pool),
+				filename_(std::move(filename)) {
+				if (!has_permanent_fd_) {
+					assert(fd_ == -1);
+					::close(fd);  // The file will be opened on every read.
+				}
+			}
+
+			~PosixDirectRandomAccessFile() override {
+				if (has_permanent_fd_) {
+					assert(fd_ != -1);
+					::close(fd_);
+					fd_limiter_->Release();
+				}
+			}
+
+			Status Read(uint64_t offset, size_t n, Slice* result,
+				char* scratch) const override {
+				int fd = fd_;
+				if (!has_permanent_fd_) {
+					fd = ::open(filename_.c_str(), O_RDONLY | O_DIRECT | kOpenBaseFlags);
+					if (fd < 0) {
+						return PosixError(filename_, errno);
+					}
+				}
+
+				assert(fd != -1);
+
+				Status status;
+				const uintptr_t mask = kDirectIOAlignment - 1;
+				if (((offset | n | reinterpret_cast<uintptr_t>(scratch)) & mask) == 0) {
+					ssize_t read_size = Pread(fd, scratch, n, offset);
+					*result = Slice(scratch, (read_size < 0) ? 0 : read_size);
+					if (read_size < 0) {
+						status = PosixError(filename_, errno);
+					}
+				}
+				else {
+					// 读取包含请求范围的对齐区间，再拷贝出需要的部分
+					const uint64_t start = offset & ~static_cast<uint64_t>(mask);
+					const size_t skip = static_cast<size_t>(offset - start);
+					const size_t size = (skip + n + mask) & ~mask;
+					size_t capacity;
+					char* buf = buffer_pool_->Acquire(size, &capacity);
+					ssize_t read_size = Pread(fd, buf, size, start);
+					size_t copy_size = 0;
+					if (read_size < 0) {
+						status = PosixError(filename_, errno);
+					}
+					else if (static_cast<size_t>(read_size) > skip) {
+						copy_size = std::min(static_cast<size_t>(read_size) - skip, n);
+						std::memcpy(scratch, buf + skip, copy_size);
+					}
+					buffer_pool_->Release(buf, capacity);
+					*result = Slice(scratch, copy_size);
+				}
+				if (!has_permanent_fd_) {
+					// Close the temporary file descriptor opened earlier.
+					assert(fd != fd_);
+					::close(fd);
+				}
+				return status;
+			}
+
+			AlignedBufferPool* aligned_buffer_pool() const override {
+				return buffer_pool_;
+			}
+
+			Status MultiRead(ReadRequest* reqs, size_t n) const override {
+				int fd = fd_;
+				if (!has_permanent_fd_) {
+					fd = ::open(filename_.c_str(), O_RDONLY | O_DIRECT | kOpenBaseFlags);
+					if (fd < 0) {
+						return FailRequests(reqs, n, PosixError(filename_, errno));
+					}
+				}
+
+				// Unaligned requests read their aligned range into a buffer of the
+				// pool, as in Read()
+				const uint64_t mask = kDirectIOAlignment - 1;
+				std::vector<struct iovec> iovecs(n);
+				std::vector<PosixRead> reads(n);
+				std::vector<size_t> capacities(n, 0);
+				for (size_t i = 0; i < n; i++) {
+					const ReadRequest& req = reqs[i];
+					if (((req.offset | req.len |
+						reinterpret_cast<uintptr_t>(req.scratch)) & mask) == 0) {
+						iovecs[i].iov_base = req.scratch;
+						iovecs[i].iov_len = req.len;
+						reads[i].offset = req.offset;
+					}
+					else {
+						reads[i].offset = req.offset & ~mask;
+						iovecs[i].iov_len = static_cast<size_t>(
+							(req.offset + req.len + mask) & ~mask) - reads[i].offset;
+						iovecs[i].iov_base = buffer_pool_->Acquire(iovecs[i].iov_len,
+							&capacities[i]);
+					}
+					reads[i].iov = &iovecs[i];
+					reads[i].iovcnt = 1;
+				}
+				PreadBatch(fd, reads.data(), n, kDirectIOAlignment);
+				for (size_t i = 0; i < n; i++) {
+					ReadRequest* req = &reqs[i];
+					if (reads[i].result < 0) {
+						req->result = Slice(req->scratch, 0);
+						req->status = PosixError(filename_, static_cast<int>(-reads[i].result));
+					}
+					else {
+						size_t size = static_cast<size_t>(reads[i].result);
+						if (capacities[i] > 0) {
+							const size_t skip = static_cast<size_t>(req->offset - reads[i].offset);
+							size = (size > skip) ? std::min(size - skip, req->len) : 0;
+							std::memcpy(req->scratch,
+								static_cast<char*>(iovecs[i].iov_base) + skip, size);
+						}
+						req->result = Slice(req->scratch, size);
+						req->status = Status::OK();
+					}
+					if (capacities[i] > 0) {
+						buffer_pool_->Release(static_cast<char*>(iovecs[i].iov_base),
+							capacities[i]);
+					}
+				}
+
+				if (!has_permanent_fd_) {
+					// Close the temporary file descriptor opened earlier.
+					assert(fd != fd_);
+					::close(fd);
+				}
+				return Status::OK();
+			}
+
+		private:
+			static ssize_t Pread(int fd, char* buf, size_t n, uint64_t offset) {
+				ssize_t read_size;
+				do {
+					read_size = ::pread(fd, buf, n, static_cast<off_t>(offset));
+				} while (read_size < 0 && errno == EINTR);
+				return read_size;
+			}
+
+			const bool has_permanent_fd_;  // If false, the file is opened on every read.
+			const int fd_;                 // -1 if has_permanent_fd_ is false.
+			Limiter* const fd_limiter_;
+			AlignedBufferPool* const buffer_pool_;
+			const std::string filename_;
+		};
+#endif  // HAVE_O_DIRECT
+
 		// Implements random read access in a file using mmap().
 		//
 		// Instances of this class are thread-safe, as required by the RandomAccessFile
@@ -288,6 +924,48 @@ namespace leveldb {
 				return WriteUnbuffered(write_data, write_size);
 			}
 
+			// Pieces that fit in the buffer are copied there.  Otherwise the
+			// buffered data and all the pieces go out with writev(), so a large
+			// gathered write costs one system call rather than one per piece.
+			Status AppendV(const Slice* data, size_t n) override {
+				size_t total = 0;
+				for (size_t i = 0; i < n; i++) {
+					total += data[i].size();
+				}
+				if (total <= kWritableFileBufferSize - pos_) {
+					for (size_t i = 0; i < n; i++) {
+						std::memcpy(buf_ + pos_, data[i].data(), data[i].size());
+						pos_ += data[i].size();
+					}
+					return Status::OK();
+				}
+
+				struct iovec iov[kMaxIovecs];
+				int iovcnt = 0;
+				if (pos_ > 0) {
+					iov[iovcnt].iov_base = buf_;
+					iov[iovcnt].iov_len = pos_;
+					iovcnt++;
+				}
+				pos_ = 0;
+				for (size_t i = 0; i < n; i++) {
+					if (data[i].empty()) {
+						continue;
+					}
+					if (iovcnt == kMaxIovecs) {
+						Status status = WriteVUnbuffered(iov, iovcnt);
+						if (!status.ok()) {
+							return status;
+						}
+						iovcnt = 0;
+					}
+					iov[iovcnt].iov_base = const_cast<char*>(data[i].data());
+					iov[iovcnt].iov_len = data[i].size();
+					iovcnt++;
+				}
+				return WriteVUnbuffered(iov, iovcnt);
+			}
+
 			Status Close() override {
 				Status status = FlushBuffer();
 				const int close_result = ::close(fd_);
@@ -300,6 +978,16 @@ namespace leveldb {
 
 			Status Flush() override { return FlushBuffer(); }
 
+			Status Allocate(uint64_t offset, uint64_t len) override {
+#if HAVE_FALLOCATE
+				if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+					static_cast<off_t>(len)) != 0 && errno != EOPNOTSUPP) {
+					return PosixError(filename_, errno);
+				}
+#endif  // HAVE_FALLOCATE
+				return Status::OK();
+			}
+
 			Status Sync() override {
 				// Ensure new files referred to by the manifest are in the filesystem.
 				//
@@ -341,6 +1029,31 @@ namespace leveldb {
 				return Status::OK();
 			}
 
+			// Consumes iov[0,iovcnt-1], which may be modified
+			Status WriteVUnbuffered(struct iovec* iov, int iovcnt) {
+				while (iovcnt > 0) {
+					ssize_t write_result = ::writev(fd_, iov, iovcnt);
+					if (write_result < 0) {
+						if (errno == EINTR) {
+							continue;  // Retry
+						}
+						return PosixError(filename_, errno);
+					}
+					// Skip what was written, resuming a partial write
+					size_t written = static_cast<size_t>(write_result);
+					while (iovcnt > 0 && written >= iov->iov_len) {
+						written -= iov->iov_len;
+						iov++;
+						iovcnt--;
+					}
+					if (iovcnt > 0) {
+						iov->iov_base = static_cast<char*>(iov->iov_base) + written;
+						iov->iov_len -= written;
+					}
+				}
+				return Status::OK();
+			}
+
 			Status SyncDirIfManifest() {
 				Status status;
 				if (!is_manifest_) {
@@ -358,35 +1071,6 @@ namespace leveldb {
 				return status;
 			}
 
-			// Ensures that all the caches associated with the given file descriptor's
-			// data are flushed all the way to durable media, and can withstand power
-			// failures.
-			//
-			// The path argument is only used to populate the description string in the
-			// returned Status if an error occurs.
-			static Status SyncFd(int fd, const std::string& fd_path) {
-#if HAVE_FULLFSYNC
-				// On macOS and iOS, fsync() doesn't guarantee durability past power
-				// failures. fcntl(F_FULLFSYNC) is required for that purpose. Some
-				// filesystems don't support fcntl(F_FULLFSYNC), and require a fallback to
-				// fsync().
-				if (::fcntl(fd, F_FULLFSYNC) == 0) {
-					return Status::OK();
-				}
-#endif  // HAVE_FULLFSYNC
-
-#if HAVE_FDATASYNC
-				bool sync_success = ::fdatasync(fd) == 0;
-#else
-				bool sync_success = ::fsync(fd) == 0;
-#endif  // HAVE_FDATASYNC
-
-				if (sync_success) {
-					return Status::OK();
-				}
-				return PosixError(fd_path, errno);
-			}
-
 			// Returns the directory name in a path pointing to a file.
 			//
 			// Returns "." if the path does not contain any directory separator.
@@ -434,6 +1118,140 @@ namespace leveldb {
 			const std::string dirname_;  // The directory of filename_.
 		};
 
+#if HAVE_O_DIRECT
+		// Writes a file opened with O_DIRECT, bypassing the page cache.  Data is
+		// collected in an aligned buffer and written in whole blocks: Flush()
+		// writes the last partial block padded with zeros, and the next write
+		// rewrites that block with the data appended since.  Close() truncates
+		// the padding away.
+		class PosixDirectWritableFile final : public WritableFile {
+		public:
+			// Takes ownership of "buf", kDirectWritableFileBufferSize bytes
+			// aligned to kDirectIOAlignment and allocated with posix_memalign().
+			PosixDirectWritableFile(std::string filename, int fd, char* buf)
+				: buf_(buf),
+				pos_(0),
+				unwritten_(false),
+				file_offset_(0),
+				fd_(fd),
+				filename_(std::move(filename)) {}
+
+			~PosixDirectWritableFile() override {
+				if (fd_ >= 0) {
+					// Ignoring any potential errors
+					Close();
+				}
+				std::free(buf_);
+			}
+
+			Status Append(const Slice& data) override {
+				const char* write_data = data.data();
+				size_t write_size = data.size();
+				while (write_size > 0) {
+					// 数据都要经过对齐的buffer，写满了就写入文件
+					const size_t copy_size =
+						std::min(write_size, kDirectWritableFileBufferSize - pos_);
+					std::memcpy(buf_ + pos_, write_data, copy_size);
+					write_data += copy_size;
+					write_size -= copy_size;
+					pos_ += copy_size;
+					unwritten_ = true;
+					if (pos_ == kDirectWritableFileBufferSize) {
+						Status status = WriteBuffer();
+						if (!status.ok()) {
+							return status;
+						}
+					}
+				}
+				return Status::OK();
+			}
+
+			Status Close() override {
+				Status status = WriteBuffer();
+				// 去掉最后一个block的填充
+				if (status.ok() &&
+					::ftruncate(fd_, static_cast<off_t>(file_offset_ + pos_)) != 0) {
+					status = PosixError(filename_, errno);
+				}
+				const int close_result = ::close(fd_);
+				if (close_result < 0 && status.ok()) {
+					status = PosixError(filename_, errno);
+				}
+				fd_ = -1;
+				return status;
+			}
+
+			Status Flush() override { return WriteBuffer(); }
+
+			Status Allocate(uint64_t offset, uint64_t len) override {
+#if HAVE_FALLOCATE
+				if (::fallocate(fd_, FALLOC_FL_KEEP_SIZE, static_cast<off_t>(offset),
+					static_cast<off_t>(len)) != 0 && errno != EOPNOTSUPP) {
+					return PosixError(filename_, errno);
+				}
+#endif  // HAVE_FALLOCATE
+				return Status::OK();
+			}
+
+			Status Sync() override {
+				// The data is on the device once written, but the file size and the
+				// device's own cache still need a sync.
+				Status status = WriteBuffer();
+				if (!status.ok()) {
+					return status;
+				}
+				return SyncFd(fd_, filename_);
+			}
+
+		private:
+			// Write buf_[0, pos_ - 1] padded to whole blocks at file_offset_, then
+			// keep only the last partial block in buf_.
+			Status WriteBuffer() {
+				if (!unwritten_) {
+					return Status::OK();
+				}
+				const size_t size =
+					(pos_ + kDirectIOAlignment - 1) & ~(kDirectIOAlignment - 1);
+				std::memset(buf_ + pos_, 0, size - pos_);
+				const char* data = buf_;
+				size_t left = size;
+				uint64_t offset = file_offset_;
+				while (left > 0) {
+					ssize_t write_result =
+						::pwrite(fd_, data, left, static_cast<off_t>(offset));
+					if (write_result < 0) {
+						if (errno == EINTR) {
+							continue;  // Retry
+						}
+						return PosixError(filename_, errno);
+					}
+					data += write_result;
+					left -= write_result;
+					offset += write_result;
+				}
+				unwritten_ = false;
+
+				const size_t full = pos_ & ~(kDirectIOAlignment - 1);
+				if (full > 0) {
+					std::memmove(buf_, buf_ + full, pos_ - full);
+					file_offset_ += full;
+					pos_ -= full;
+				}
+				return Status::OK();
+			}
+
+			// buf_[0, pos_ - 1] holds the data from file_offset_ on, which is
+			// written to fd_ up to the last partial block unless unwritten_.
+			char* const buf_;
+			size_t pos_;
+			bool unwritten_;
+			uint64_t file_offset_;  // Multiple of kDirectIOAlignment
+			int fd_;
+
+			const std::string filename_;
+		};
+#endif  // HAVE_O_DIRECT
+
 		int LockOrUnlock(int fd, bool lock) {
 			errno = 0;
 			struct ::flock file_lock_info;
@@ -503,6 +1321,10 @@ namespace leveldb {
 					return PosixError(filename, errno);
 				}
 
+#if HAVE_POSIX_FADVISE
+				// 告诉内核这个文件会被顺序读取，内核会加大预读的窗口
+				::posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif  // HAVE_POSIX_FADVISE
 				*result = new PosixSequentialFile(filename, fd);
 				return Status::OK();
 			}
@@ -541,6 +1363,27 @@ namespace leveldb {
 				return status;
 			}
 
+			Status NewDirectRandomAccessFile(const std::string& filename,
+				RandomAccessFile** result) override {
+#if HAVE_O_DIRECT
+				*result = nullptr;
+				int fd = ::open(filename.c_str(), O_RDONLY | O_DIRECT | kOpenBaseFlags);
+				if (fd < 0 && errno == EINVAL) {
+					// 文件系统(如tmpfs)不支持O_DIRECT，退回到经过page cache的读取
+					return NewRandomAccessFile(filename, result);
+				}
+				if (fd < 0) {
+					return PosixError(filename, errno);
+				}
+
+				*result = new PosixDirectRandomAccessFile(filename, fd, &fd_limiter_,
+					&direct_read_pool_);
+				return Status::OK();
+#else
+				return NewRandomAccessFile(filename, result);
+#endif  // HAVE_O_DIRECT
+			}
+
 			Status NewWritableFile(const std::string& filename,
 				WritableFile** result) override {
 				int fd = ::open(filename.c_str(),
@@ -554,6 +1397,53 @@ namespace leveldb {
 				return Status::OK();
 			}
 
+			Status NewDirectWritableFile(const std::string& filename,
+				WritableFile** result) override {
+#if HAVE_O_DIRECT
+				int fd = ::open(filename.c_str(),
+					O_TRUNC | O_WRONLY | O_CREAT | O_DIRECT | kOpenBaseFlags, 0644);
+				if (fd < 0 && errno == EINVAL) {
+					// 文件系统(如tmpfs)不支持O_DIRECT，退回到经过page cache的写入
+					return NewWritableFile(filename, result);
+				}
+				if (fd < 0) {
+					*result = nullptr;
+					return PosixError(filename, errno);
+				}
+
+				void* buf;
+				if (::posix_memalign(&buf, kDirectIOAlignment,
+					kDirectWritableFileBufferSize) != 0) {
+					::close(fd);
+					*result = nullptr;
+					return Status::IOError(filename, "cannot allocate aligned buffer");
+				}
+				*result = new PosixDirectWritableFile(filename, fd,
+					static_cast<char*>(buf));
+				return Status::OK();
+#else
+				return NewWritableFile(filename, result);
+#endif  // HAVE_O_DIRECT
+			}
+
+			Status ReuseWritableFile(const std::string& filename,
+				const std::string& old_filename,
+				WritableFile** result) override {
+				if (std::rename(old_filename.c_str(), filename.c_str()) != 0) {
+					*result = nullptr;
+					return PosixError(old_filename, errno);
+				}
+				// No O_TRUNC: the old contents are overwritten in place
+				int fd = ::open(filename.c_str(), O_WRONLY | kOpenBaseFlags, 0644);
+				if (fd < 0) {
+					*result = nullptr;
+					return PosixError(filename, errno);
+				}
+
+				*result = new PosixWritableFile(filename, fd);
+				return Status::OK();
+			}
+
 			Status NewAppendableFile(const std::string& filename,
 				WritableFile** result) override {
 				int fd = ::open(filename.c_str(),
@@ -748,6 +1638,7 @@ namespace leveldb {
 			PosixLockTable locks_;  // Thread-safe.
 			Limiter mmap_limiter_;  // Thread-safe.
 			Limiter fd_limiter_;    // Thread-safe.
+			AlignedBufferPool direct_read_pool_;  // Thread-safe.
 		};
 
 		// Return the maximum number of concurrent mmaps.
@@ -779,7 +1670,8 @@ namespace leveldb {
 		: background_work_cv_(&background_work_mutex_),
 		started_background_thread_(false),
 		mmap_limiter_(MaxMmaps()),
-		fd_limiter_(MaxOpenFiles()) {}
+		fd_limiter_(MaxOpenFiles()),
+		direct_read_pool_(kDirectIOAlignment, kDirectReadPoolBytes) {}
 
 	void PosixEnv::Schedule(
 		void (*background_work_function)(void* background_work_arg),
@@ -888,6 +1780,14 @@ namespace leveldb {
 		g_mmap_limit = limit;
 	}
 
+	void EnvPosixTestHelper::SetIoUringEnabled(bool enabled) {
+#if HAVE_IO_URING && defined(__NR_io_uring_setup)
+		g_io_uring_enabled.store(enabled, std::memory_order_relaxed);
+#else
+		(void)enabled;
+#endif  // HAVE_IO_URING && defined(__NR_io_uring_setup)
+	}
+
 	Env* Env::Default() {
 		static PosixDefaultEnv env_container;
 		return env_container.env();
@@ -2,6 +2,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -9,6 +10,7 @@
 #include <unordered_set>
 #include <vector>
 
+#include "aligned_buffer_pool.h"
 #include "env.h"
 #include "port.h"
 #include "env_posix_test_helper.h"
@@ -171,6 +173,10 @@ class EnvPosixTest {
     EnvPosixTestHelper::SetReadOnlyMMapLimit(mmap_limit);
   }
 
+  static void SetIoUringEnabled(bool enabled) {
+    EnvPosixTestHelper::SetIoUringEnabled(enabled);
+  }
+
   EnvPosixTest() : env_(Env::Default()) {}
 
   Env* env_;
@@ -207,6 +213,180 @@ TEST(EnvPosixTest, TestOpenOnRead) {
   ASSERT_OK(env_->DeleteFile(test_file));
 }
 
+TEST(EnvPosixTest, TestAppendV) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/append_v.txt";
+
+  // Small gathers land in the write buffer, large ones go out with
+  // writev() together with what was buffered, more pieces than fit in
+  // one call included.
+  std::string expected;
+  std::vector<std::string> strings;
+  for (int i = 0; i < 200; i++) {
+    strings.push_back(std::string(i % 7 == 0 ? 0 : 1 + (i * 37) % 3000,
+                                  static_cast<char>('a' + i % 26)));
+  }
+  strings.push_back(std::string(200000, 'z'));
+  WritableFile* file;
+  ASSERT_OK(env_->NewWritableFile(test_file, &file));
+  for (size_t count = 1; count <= strings.size(); count *= 3) {
+    std::vector<Slice> pieces;
+    for (size_t i = 0; i < count; i++) {
+      const std::string& piece = strings[strings.size() - count + i];
+      pieces.push_back(piece);
+      expected += piece;
+    }
+    ASSERT_OK(file->AppendV(pieces.data(), pieces.size()));
+    ASSERT_OK(file->Append("."));
+    expected += ".";
+  }
+  ASSERT_OK(file->Close());
+  delete file;
+
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, test_file, &contents));
+  ASSERT_EQ(expected.size(), contents.size());
+  ASSERT_TRUE(expected == contents);
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, TestDirectWritableFile) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_writable.txt";
+
+  // Flushes in the middle of blocks are padded on disk and rewritten by
+  // the next flush; writes larger than the buffer span several of them.
+  std::string expected;
+  WritableFile* file;
+  ASSERT_OK(env_->NewDirectWritableFile(test_file, &file));
+  for (int i = 0; i < 50; i++) {
+    std::string piece(1 + (i * 7919) % 10000, static_cast<char>('a' + i % 26));
+    ASSERT_OK(file->Append(piece));
+    expected += piece;
+    if (i % 3 == 0) {
+      ASSERT_OK(file->Flush());
+      std::string contents;
+      ASSERT_OK(ReadFileToString(env_, test_file, &contents));
+      ASSERT_LE(expected.size(), contents.size());
+      ASSERT_TRUE(Slice(contents.data(), expected.size()) == Slice(expected));
+    }
+  }
+  std::string big(3 << 20, 'z');
+  ASSERT_OK(file->Append(big));
+  expected += big;
+  ASSERT_OK(file->Append("tail"));
+  expected += "tail";
+  ASSERT_OK(file->Sync());
+  ASSERT_OK(file->Close());
+  delete file;
+
+  std::string contents;
+  ASSERT_OK(ReadFileToString(env_, test_file, &contents));
+  ASSERT_EQ(expected.size(), contents.size());
+  ASSERT_TRUE(expected == contents);
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, TestDirectRandomAccessFile) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/direct_random_access.txt";
+
+  std::string data;
+  for (int i = 0; i < 100000; i++) {
+    data.push_back(static_cast<char>(i * 131));
+  }
+  ASSERT_OK(WriteStringToFile(env_, data, test_file));
+
+  RandomAccessFile* file;
+  ASSERT_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+  std::string scratch(data.size() + 8192, '\0');
+  Slice result;
+  // Unaligned reads, including ones past the end of the file
+  const uint64_t offsets[] = {0, 1, 4095, 4096, 12345, 99990};
+  const size_t sizes[] = {1, 100, 4096, 10000};
+  for (size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+    for (size_t j = 0; j < sizeof(sizes) / sizeof(sizes[0]); j++) {
+      ASSERT_OK(file->Read(offsets[i], sizes[j], &result, &scratch[1]));
+      ASSERT_EQ(data.substr(offsets[i], sizes[j]), result.ToString());
+    }
+  }
+
+  // Aligned reads into a buffer of the file's pool
+  AlignedBufferPool* pool = file->aligned_buffer_pool();
+  if (pool != nullptr) {
+    size_t capacity;
+    char* buf = pool->Acquire(8192, &capacity);
+    ASSERT_GE(capacity, 8192);
+    ASSERT_OK(file->Read(4096, 8192, &result, buf));
+    ASSERT_EQ(data.substr(4096, 8192), result.ToString());
+    pool->Release(buf, capacity);
+  }
+  delete file;
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
+TEST(EnvPosixTest, TestMultiRead) {
+  std::string test_dir;
+  ASSERT_OK(env_->GetTestDirectory(&test_dir));
+  std::string test_file = test_dir + "/multi_read.txt";
+
+  std::string data;
+  for (int i = 0; i < 200000; i++) {
+    data.push_back(static_cast<char>(i * 257 + i / 7));
+  }
+  ASSERT_OK(WriteStringToFile(env_, data, test_file));
+
+  // Batches larger than the io_uring queue, with aligned and unaligned
+  // requests and ones past the end of the file, with and without io_uring
+  for (int direct = 0; direct < 2; direct++) {
+    for (int uring = 1; uring >= 0; uring--) {
+      SetIoUringEnabled(uring != 0);
+      RandomAccessFile* file;
+      if (direct) {
+        ASSERT_OK(env_->NewDirectRandomAccessFile(test_file, &file));
+      } else {
+        ASSERT_OK(env_->NewRandomAccessFile(test_file, &file));
+      }
+      AlignedBufferPool* pool = file->aligned_buffer_pool();
+      const size_t kNumRequests = 100;
+      std::vector<ReadRequest> reqs(kNumRequests);
+      std::vector<size_t> capacities(kNumRequests, 0);
+      std::string scratch(kNumRequests * 9000, '\0');
+      for (size_t i = 0; i < kNumRequests; i++) {
+        ReadRequest& req = reqs[i];
+        if (i % 3 == 0) {
+          req.offset = (i * 7919 % 48) * 4096;
+          req.len = 4096 * (1 + i % 2);
+        } else {
+          req.offset = i * 1999 % (data.size() + 1000);
+          req.len = 1 + i * 97 % 8000;
+        }
+        if (i % 3 == 0 && pool != nullptr) {
+          req.scratch = pool->Acquire(req.len, &capacities[i]);
+        } else {
+          req.scratch = &scratch[i * 9000 + 1];
+        }
+      }
+      ASSERT_OK(file->MultiRead(reqs.data(), reqs.size()));
+      for (size_t i = 0; i < kNumRequests; i++) {
+        ASSERT_OK(reqs[i].status);
+        ASSERT_EQ(data.substr(std::min<size_t>(reqs[i].offset, data.size()),
+                              reqs[i].len),
+                  reqs[i].result.ToString());
+        if (capacities[i] > 0) {
+          pool->Release(reqs[i].scratch, capacities[i]);
+        }
+      }
+      delete file;
+    }
+  }
+  SetIoUringEnabled(true);
+  ASSERT_OK(env_->DeleteFile(test_file));
+}
+
 #if HAVE_O_CLOEXEC
 
 TEST(EnvPosixTest, TestCloseOnExecSequentialFile) {
@@ -17,6 +17,10 @@ namespace leveldb {
 		// Set the maximum number of read-only files that will be mapped via mmap.
 		// Must be called before creating an Env.
 		static void SetReadOnlyMMapLimit(int limit);
+
+		// Enable or disable io_uring for RandomAccessFile::MultiRead(), to
+		// test the pread() fallback.  May be called at any time.
+		static void SetIoUringEnabled(bool enabled);
 	};
 
 }  // namespace leveldb
@@ -0,0 +1,109 @@
+#include "merge_operator.h"
+
+#include "coding.h"
+
+namespace leveldb {
+
+MergeOperator::~MergeOperator() { }
+
+namespace {
+
+class UInt64AddOperator : public MergeOperator {
+public:
+	virtual const char* Name() const {
+		return "leveldb.UInt64AddOperator";
+	}
+
+	virtual bool FullMerge(const Slice& /*key*/,
+		const Slice* existing_value,
+		const std::vector<Slice>& operands,
+		std::string* new_value) const {
+		uint64_t sum = 0;
+		if (existing_value != NULL && !Decode(*existing_value, &sum)) {
+			return false;
+		}
+		for (size_t i = 0; i < operands.size(); i++) {
+			uint64_t n;
+			if (!Decode(operands[i], &n)) {
+				return false;
+			}
+			sum += n;
+		}
+		new_value->clear();
+		PutFixed64(new_value, sum);
+		return true;
+	}
+
+	virtual bool PartialMerge(const Slice& /*key*/,
+		const Slice& left_operand,
+		const Slice& right_operand,
+		std::string* new_value) const {
+		uint64_t left, right;
+		if (!Decode(left_operand, &left) || !Decode(right_operand, &right)) {
+			return false;
+		}
+		new_value->clear();
+		PutFixed64(new_value, left + right);
+		return true;
+	}
+
+private:
+	static bool Decode(const Slice& s, uint64_t* n) {
+		if (s.size() != sizeof(uint64_t)) {
+			return false;
+		}
+		*n = DecodeFixed64(s.data());
+		return true;
+	}
+};
+
+class StringAppendOperator : public MergeOperator {
+public:
+	explicit StringAppendOperator(char delim) : delim_(delim) { }
+
+	virtual const char* Name() const {
+		return "leveldb.StringAppendOperator";
+	}
+
+	virtual bool FullMerge(const Slice& /*key*/,
+		const Slice* existing_value,
+		const std::vector<Slice>& operands,
+		std::string* new_value) const {
+		new_value->clear();
+		if (existing_value != NULL) {
+			new_value->assign(existing_value->data(), existing_value->size());
+		}
+		for (size_t i = 0; i < operands.size(); i++) {
+			if (i > 0 || existing_value != NULL) {
+				new_value->push_back(delim_);
+			}
+			new_value->append(operands[i].data(), operands[i].size());
+		}
+		return true;
+	}
+
+	virtual bool PartialMerge(const Slice& /*key*/,
+		const Slice& left_operand,
+		const Slice& right_operand,
+		std::string* new_value) const {
+		new_value->assign(left_operand.data(), left_operand.size());
+		new_value->push_back(delim_);
+		new_value->append(right_operand.data(), right_operand.size());
+		return true;
+	}
+
+private:
+	const char delim_;
+};
+
+}  // namespace
+
+const MergeOperator* NewUInt64AddOperator() {
+	return new UInt64AddOperator;
+}
+
+const MergeOperator* NewStringAppendOperator(char delim) {
+	return new StringAppendOperator(delim);
+}
+
+}  // namespace leveldb
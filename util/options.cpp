@@ -17,13 +17,28 @@ Options::Options()
       env(Env::Default()),
       info_log(NULL),
       write_buffer_size(4<<20),
+      allow_concurrent_memtable_write(false),
+      arena_block_size(0),
+      memtable_huge_page_size(0),
+      memtable_rep(kSkipListRep),
+      memtable_hash_bucket_count(0),
+      prefix_extractor(NULL),
+      merge_operator(NULL),
+      write_buffer_manager(NULL),
       max_open_files(1000),
       block_cache(NULL),
       block_size(4096),
       block_restart_interval(16),
       max_file_size(2<<20),
       compression(kSnappyCompression),
+      table_builder_threads(0),
       reuse_logs(false),
+      recycle_log_file_num(0),
+      log_preallocate_size(0),
+      wal_recovery_threads(0),
+      log_read_size(1 << 20),
+      use_direct_writes(false),
+      use_direct_reads(false),
       filter_policy(NULL) {
 }
 
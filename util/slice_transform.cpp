@@ -0,0 +1,34 @@
+#include "slice_transform.h"
+
+namespace leveldb {
+
+SliceTransform::~SliceTransform() { }
+
+namespace {
+
+class FixedPrefixTransform : public SliceTransform {
+public:
+	explicit FixedPrefixTransform(size_t prefix_len) : prefix_len_(prefix_len) { }
+
+	virtual const char* Name() const { return "leveldb.FixedPrefix"; }
+
+	virtual Slice Transform(const Slice& key) const {
+		assert(InDomain(key));
+		return Slice(key.data(), prefix_len_);
+	}
+
+	virtual bool InDomain(const Slice& key) const {
+		return key.size() >= prefix_len_;
+	}
+
+private:
+	const size_t prefix_len_;
+};
+
+}  // namespace
+
+const SliceTransform* NewFixedPrefixTransform(size_t prefix_len) {
+	return new FixedPrefixTransform(prefix_len);
+}
+
+}  // namespace leveldb
@@ -0,0 +1,99 @@
+#include "write_buffer_manager.h"
+
+#include <string>
+#include <vector>
+#include "cache.h"
+#include "coding.h"
+#include "mutexlock.h"
+#include "port.h"
+#include "thread_annotations.h"
+
+namespace leveldb {
+
+// 在cache中插入的占位entry，每个占用kDummyEntrySize的容量，没有实际内容
+struct WriteBufferManager::CacheRep {
+	explicit CacheRep(Cache* c) : cache(c), next_dummy(0) {
+		PutFixed64(&key_prefix, cache->NewId());
+	}
+
+	Cache* const cache;
+	port::Mutex mu;  // 保证cache的占用按顺序更新
+	std::string key_prefix;  // 本manager在cache中独有的key前缀
+	uint64_t next_dummy GUARDED_BY(mu);  // 下一个占位entry的编号
+	std::vector<std::string> dummy_keys GUARDED_BY(mu);
+	std::vector<Cache::Handle*> dummy_handles GUARDED_BY(mu);
+
+	void ReleaseLastDummy() EXCLUSIVE_LOCKS_REQUIRED(mu) {
+		cache->Release(dummy_handles.back());
+		cache->Erase(dummy_keys.back());
+		dummy_handles.pop_back();
+		dummy_keys.pop_back();
+	}
+};
+
+static void DeleteDummyEntry(const Slice& /*key*/, void* /*value*/) {
+	// Nothing to free
+}
+
+WriteBufferManager::WriteBufferManager(size_t buffer_size, Cache* cache)
+	: buffer_size_(buffer_size),
+	memory_used_(0),
+	cache_rep_(cache == NULL ? NULL : new CacheRep(cache)) {
+}
+
+WriteBufferManager::~WriteBufferManager() {
+	assert(memory_usage() == 0);
+	if (cache_rep_ != NULL) {
+		{
+			MutexLock l(&cache_rep_->mu);
+			while (!cache_rep_->dummy_handles.empty()) {
+				cache_rep_->ReleaseLastDummy();
+			}
+		}
+		delete cache_rep_;
+	}
+}
+
+size_t WriteBufferManager::cache_charge() const {
+	if (cache_rep_ == NULL) {
+		return 0;
+	}
+	MutexLock l(&cache_rep_->mu);
+	return cache_rep_->dummy_handles.size() * kDummyEntrySize;
+}
+
+void WriteBufferManager::ReserveMem(size_t mem) {
+	memory_used_.fetch_add(mem, std::memory_order_relaxed);
+	if (cache_rep_ != NULL) {
+		UpdateCacheCharge();
+	}
+}
+
+void WriteBufferManager::FreeMem(size_t mem) {
+	assert(memory_usage() >= mem);
+	memory_used_.fetch_sub(mem, std::memory_order_relaxed);
+	if (cache_rep_ != NULL) {
+		UpdateCacheCharge();
+	}
+}
+
+// 让cache中的占用跟上memory_used_：不足时插入占位entry，超出一个以上时删除，
+// 留出一个entry的余量，避免在边界附近反复插入删除
+void WriteBufferManager::UpdateCacheCharge() {
+	CacheRep* r = cache_rep_;
+	MutexLock l(&r->mu);
+	const size_t used = memory_usage();
+	while (r->dummy_handles.size() * kDummyEntrySize < used) {
+		std::string key = r->key_prefix;
+		PutFixed64(&key, r->next_dummy++);
+		r->dummy_handles.push_back(
+			r->cache->Insert(key, NULL, kDummyEntrySize, &DeleteDummyEntry));
+		r->dummy_keys.push_back(key);
+	}
+	while (!r->dummy_handles.empty() &&
+		r->dummy_handles.size() * kDummyEntrySize >= used + 2 * kDummyEntrySize) {
+		r->ReleaseLastDummy();
+	}
+}
+
+}  // namespace leveldb
@@ -0,0 +1,79 @@
+#include "write_buffer_manager.h"
+
+#include "cache.h"
+#include "coding.h"
+#include "testharness.h"
+
+namespace leveldb {
+
+class WriteBufferManagerTest {};
+
+TEST(WriteBufferManagerTest, Budget) {
+	WriteBufferManager manager(1000);
+	ASSERT_TRUE(manager.enabled());
+	ASSERT_TRUE(!manager.ShouldFlush());
+	manager.ReserveMem(600);
+	ASSERT_TRUE(!manager.ShouldFlush());
+	manager.ReserveMem(400);
+	ASSERT_EQ(1000, manager.memory_usage());
+	ASSERT_TRUE(manager.ShouldFlush());
+	manager.FreeMem(600);
+	ASSERT_TRUE(!manager.ShouldFlush());
+	ASSERT_EQ(0, manager.cache_charge());
+	manager.FreeMem(400);
+
+	// Without a budget memory is counted, but never triggers a flush
+	WriteBufferManager unlimited(0);
+	ASSERT_TRUE(!unlimited.enabled());
+	unlimited.ReserveMem(1 << 30);
+	ASSERT_TRUE(!unlimited.ShouldFlush());
+	unlimited.FreeMem(1 << 30);
+}
+
+static void DeleteValue(const Slice& key, void* value) {
+	delete reinterpret_cast<int*>(value);
+}
+
+TEST(WriteBufferManagerTest, ChargeCache) {
+	const size_t kDummy = WriteBufferManager::kDummyEntrySize;
+	Cache* cache = NewLRUCache(8 * kDummy);
+	{
+		WriteBufferManager manager(0, cache);
+		manager.ReserveMem(1);
+		ASSERT_EQ(kDummy, manager.cache_charge());
+		manager.ReserveMem(kDummy);
+		ASSERT_EQ(2 * kDummy, manager.cache_charge());
+
+		// One spare entry is kept while memory goes down
+		manager.FreeMem(kDummy);
+		ASSERT_EQ(2 * kDummy, manager.cache_charge());
+		manager.ReserveMem(5 * kDummy);
+		ASSERT_EQ(6 * kDummy, manager.cache_charge());
+		manager.FreeMem(4 * kDummy);
+		ASSERT_EQ(kDummy + 1, manager.memory_usage());
+		ASSERT_EQ(3 * kDummy, manager.cache_charge());
+
+		// Blocks are evicted to make room for the memtables
+		char key[8];
+		for (int i = 0; i < 8; i++) {
+			EncodeFixed64(key, i);
+			cache->Release(cache->Insert(Slice(key, 8), new int(i), kDummy / 2,
+				&DeleteValue));
+		}
+		manager.ReserveMem(6 * kDummy);
+		int cached = 0;
+		for (int i = 0; i < 8; i++) {
+			EncodeFixed64(key, i);
+			Cache::Handle* h = cache->Lookup(Slice(key, 8));
+			if (h != NULL) {
+				cached++;
+				cache->Release(h);
+			}
+		}
+		ASSERT_LT(cached, 8);
+		manager.FreeMem(manager.memory_usage());
+	}
+	delete cache;
+}
+
+}  // namespace leveldb